@@ -53,27 +53,29 @@ void setup() {
     auto test = Do {
         // マクロを登録したキーが一回押されたとき、"single pressed."とPCに入力する。
         // When the key on which the macro is registered is pressed once, "single pressed." is input to the PC.
+        // typeText()はKeyboard.println()と異なり、入力中もキーの読み取りを止めません。
+        // Unlike Keyboard.println(), typeText() keeps the keys scanned while the text is being typed.
         if (key.hasOccurred(Key::Event::SINGLE)) {
-            Keyboard.println("single pressed.");
+            typeText("single pressed.\n");
         // マクロを登録したキーがダブルクリックされたとき、"double clicked."とPCに入力する。
         // When a key with a registered macro is double-clicked, the PC will display "double clicked".
         } else if (key.hasOccurred(Key::Event::DOUBLE)) {
-            Keyboard.println("double clicked.");
+            typeText("double clicked.\n");
         // マクロを登録したキーが長押しされたとき"long pressed."とPCに入力し、2秒後に"2 seconds have passed.", その1秒後に"3 seconds have passed."と入力する。
         // When a key with a registered macro is pressed and held for a long time, the PC will enter "long pressed."",
         // followed by "2 seconds have passed." two seconds later and "3 seconds have passed." one second later.
         } else if (key.hasOccurred(Key::Event::LONG)) {
-            Keyboard.println("long pressed.");
+            typeText("long pressed.\n");
             macroDelay(2000, After {
-                Keyboard.println("2 seconds have passed.");
+                typeText("2 seconds have passed.\n");
 
                 macroDelay(1000, After {
-                    Keyboard.println("3 seconds have passed.");
+                    typeText("3 seconds have passed.\n");
                 });
                 // 注意: After{}ブロックの外に書かれた内容は遅延しません。
                 // Note: Content written outside of an After{} block is not delayed.
 
-                // Keyboard.print("Will be printed soon.")
+                // typeText("Will be printed soon.");
             });
         }
     };
@@ -84,9 +86,9 @@ void setup() {
         // マクロを登録したキーが離されたときに"Hello, world!"とPCに入力し、4番目のキーが押されていれば"The fourth key is pressed."とPCに入力する。
         // When the key on which the macro is registered is released, "Hello, world!"" is input to the PC, and if the fourth key is pressed, "The fourth key is pressed".
         if (key.hasOccurred(Key::Event::FALLING_EDGE)) {
-            Keyboard.println("Hello, world!");
+            typeText("Hello, world!\n");
             if (macroPad.KEYS[3].hasOccurred(Key::Event::PRESSED)) {
-                Keyboard.println("The fourth key is pressed.");
+                typeText("The fourth key is pressed.\n");
             }
         }
     };
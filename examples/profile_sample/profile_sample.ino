@@ -25,25 +25,25 @@ void setup() {
 
     auto test = Do {
         if (key.hasOccurred(Key::Event::SINGLE)) {
-            Keyboard.println("single pressed.");
+            typeText("single pressed.\n");
         } else if (key.hasOccurred(Key::Event::DOUBLE)) {
-            Keyboard.println("double clicked.");
+            typeText("double clicked.\n");
         } else if (key.hasOccurred(Key::Event::LONG)) {
-            Keyboard.println("long pressed.");
+            typeText("long pressed.\n");
             macroDelay(2000, After {
-                Keyboard.println("2 seconds have passed.");
+                typeText("2 seconds have passed.\n");
 
                 macroDelay(1000, After {
-                    Keyboard.println("3 seconds have passed.");
+                    typeText("3 seconds have passed.\n");
                 });
             });
         }
     };
     auto greet = Do {
         if (key.hasOccurred(Key::Event::FALLING_EDGE)) {
-            Keyboard.println("Hello, world!");
+            typeText("Hello, world!\n");
             if (macroPad.KEYS[3].hasOccurred(Key::Event::PRESSED)) {
-                Keyboard.println("The fourth key is pressed.");
+                typeText("The fourth key is pressed.\n");
             }
         }
     };
@@ -1,6 +1,10 @@
 // シリアル出力のみを行うサンプル
 // Sample for serial output only.
 
+// 処理時間の統計を記録し、5秒ごとにバイナリで出力する(extras/stats_decoder.pyで表示できる)
+// Records timing statistics and dumps them every 5 seconds; view them with extras/stats_decoder.py.
+#define MMZ_STATS 1
+
 #include <KeyReader/Matrix.h>
 #include <MacroPad.h>
 
@@ -70,4 +74,10 @@ void setup() {
 
 void loop() {
     macroPad.update();
+
+    static uint32_t lastDump = 0;
+    if (millis() - lastDump >= 5000) {
+        lastDump = millis();
+        macroPad.dumpStats(Serial);
+    }
 }
\ No newline at end of file
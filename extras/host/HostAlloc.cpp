@@ -0,0 +1,22 @@
+#include <stdlib.h>
+#include <new>
+
+#include "HostHarness.h"
+
+// ヒープの確保を数える(ベンチマークとテストが動的メモリ確保のないことを確認する)
+// Counts heap allocations, so benchmarks and tests can check that a path never allocates.
+
+static size_t g_allocations = 0;
+
+size_t Host::allocations() { return g_allocations; }
+
+void* operator new(size_t size) {
+    g_allocations++;
+    if (void* pointer = malloc(size ? size : 1)) { return pointer; }
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete[](void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { free(pointer); }
@@ -0,0 +1,174 @@
+#ifndef MMZ_HOST_HARNESS_H
+#define MMZ_HOST_HARNESS_H
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// PC上のテストとベンチマークの共通部分 Shared pieces of the host tests and benchmarks.
+
+namespace Host {
+    // operator newが呼ばれた回数(HostAlloc.cpp) Number of calls to operator new so far (see HostAlloc.cpp).
+    size_t allocations();
+
+    // キーの押下と解放の列 A key press or release at a point in time
+    struct TraceEvent {
+        uint32_t time; //トレースの開始からの時間(us) Time since the start of the trace in us
+        uint16_t key;
+        bool pressed;
+    };
+    using Trace = std::vector<TraceEvent>;
+
+    // ランダムなキーをランダムな長さで押すトレース(seedが同じなら同じトレース)
+    // Random keys pressed for random lengths, tapsPerSecond on average; the same seed gives the same trace.
+    inline Trace syntheticTrace(const uint16_t numOfKeys, const uint32_t duration, const uint32_t tapsPerSecond, const uint32_t seed) {
+        std::mt19937 random(seed);
+        std::vector<uint32_t> releaseAt(numOfKeys, 0);
+        std::vector<bool> held(numOfKeys, false);
+        Trace trace;
+
+        const uint32_t gap = 1000000 / tapsPerSecond;
+        for (uint32_t time = 0; time < duration; time += 1 + random() % (2 * gap)) {
+            const uint16_t key = random() % numOfKeys;
+            if (held[key]) { continue; }
+            held[key] = true;
+            releaseAt[key] = time + 30000 + random() % 300000;
+            trace.push_back({ time, key, true });
+
+            for (uint16_t other = 0; other < numOfKeys; other++) {
+                if (held[other] && (releaseAt[other] <= time)) {
+                    held[other] = false;
+                    trace.push_back({ releaseAt[other], other, false });
+                }
+            }
+        }
+        for (uint16_t key = 0; key < numOfKeys; key++) {
+            if (held[key]) { trace.push_back({ releaseAt[key], key, false }); }
+        }
+
+        std::stable_sort(trace.begin(), trace.end(), [](const TraceEvent& a, const TraceEvent& b) { return a.time < b.time; });
+        return trace;
+    }
+
+    // "時間(ms) キー d|u"の行からなるファイルを読み込む キーはnumOfKeysで割った余り
+    // Loads a trace file of "<ms> <key> d|u" lines ('#' starts a comment); keys wrap around numOfKeys.
+    inline Trace loadTrace(const char* path, const uint16_t numOfKeys) {
+        Trace trace;
+        FILE* file = fopen(path, "r");
+        if (file == nullptr) { return trace; }
+
+        char line[128];
+        while (fgets(line, sizeof(line), file) != nullptr) {
+            unsigned ms, key;
+            char action;
+            if ((line[0] == '#') || (sscanf(line, "%u %u %c", &ms, &key, &action) != 3)) { continue; }
+            trace.push_back({ ms * 1000, static_cast<uint16_t>(key % numOfKeys), action == 'd' });
+        }
+        fclose(file);
+        return trace;
+    }
+
+    // トレースを再生する キーの状態はsetKey(key, pressed)で反映し、scanPeriodごとにscan()を呼ぶ
+    // Plays the trace back: setKey(key, pressed) applies each event when it is due, and scan() runs every
+    // scanPeriod us of virtual time, until tail us after the last event.
+    template<typename SET_KEY, typename SCAN>
+    inline uint32_t play(const Trace& trace, const uint32_t scanPeriod, const uint32_t tail, SET_KEY&& setKey, SCAN&& scan) {
+        const uint32_t start = clock;
+        const uint32_t end = (trace.empty() ? 0 : trace.back().time) + tail;
+        size_t next = 0;
+        uint32_t scans = 0;
+
+        for (uint32_t time = 0; time <= end; time += scanPeriod) {
+            clock = start + time;
+            while ((next < trace.size()) && (trace[next].time <= time)) {
+                setKey(trace[next].key, trace[next].pressed);
+                next++;
+            }
+            scan();
+            scans++;
+        }
+        return scans;
+    }
+
+    // 直接接続: キーiはピンi(押すとLOW) Direct wiring: key i is pin i, LOW while pressed.
+    inline void setDirectKey(const uint16_t key, const bool pressed) { levels[key] = pressed ? LOW : HIGH; }
+
+    // マトリクス: 行のピンをLOWにすると、押されたキーの列のピンがLOWになる
+    // Matrix wiring: a column pin reads LOW while a pressed key connects it to a row pin driven LOW.
+    // Key (row, col) is index row * COLS + col, like Matrix.
+    template<uint8_t ROWS, uint8_t COLS>
+    class MatrixWiring {
+    public:
+        static void attach(const uint8_t (&rowPins)[ROWS], const uint8_t (&colPins)[COLS]) {
+            for (uint8_t i = 0; i < ROWS; i++) { rowPins_[i] = rowPins[i]; }
+            for (uint8_t i = 0; i < COLS; i++) { colPins_[i] = colPins[i]; }
+            for (bool& key : pressed_) { key = false; }
+            readHook = read;
+        }
+        static void setKey(const uint16_t key, const bool pressed) { pressed_[key] = pressed; }
+
+    private:
+        static int read(const uint8_t pin) {
+            for (uint8_t col = 0; col < COLS; col++) {
+                if (colPins_[col] != pin) { continue; }
+                for (uint8_t row = 0; row < ROWS; row++) {
+                    if ((levels[rowPins_[row]] == LOW) && pressed_[row * COLS + col]) { return LOW; }
+                }
+                return HIGH;
+            }
+            return levels[pin];
+        }
+
+        inline static uint8_t rowPins_[ROWS] = {};
+        inline static uint8_t colPins_[COLS] = {};
+        inline static bool pressed_[ROWS * COLS] = {};
+    };
+
+    // ピン0~31をまとめて読み書きするポート(PortMatrix、PortDirect、PioModel用)
+    // A port over mock pins 0-31 for PortMatrix, PortDirect and PioModel. Every access goes through
+    // digitalRead()/digitalWrite(), so it sees the same wiring as the digitalRead readers.
+    struct PinPort {
+        static uint32_t read() {
+            reads++;
+            uint32_t value = 0;
+            for (uint8_t pin = 0; pin < 32; pin++) {
+                if (digitalRead(pin)) { value |= (1UL << pin); }
+            }
+            return value;
+        }
+        static void set(const uint32_t mask) { writes++; write(mask, HIGH); }
+        static void clear(const uint32_t mask) { writes++; write(mask, LOW); }
+        static void setOutputs(const uint32_t mask) { setModes(mask, OUTPUT); }
+        static void setPullUps(const uint32_t mask) { setModes(mask, INPUT_PULLUP); }
+
+        inline static uint32_t reads = 0;  //read()の呼び出し回数 Number of port reads so far
+        inline static uint32_t writes = 0; //set()とclear()の呼び出し回数 Number of port writes so far
+
+    private:
+        static void write(const uint32_t mask, const uint8_t level) {
+            for (uint8_t pin = 0; pin < 32; pin++) {
+                if (mask & (1UL << pin)) { digitalWrite(pin, level); }
+            }
+        }
+        static void setModes(const uint32_t mask, const uint8_t mode) {
+            for (uint8_t pin = 0; pin < 32; pin++) {
+                if (mask & (1UL << pin)) { pinMode(pin, mode); }
+            }
+        }
+    };
+}
+
+// 失敗した場合はメッセージを表示して終了コードを1にする Prints the failed condition and makes the test exit with 1.
+inline int g_hostFailures = 0;
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            g_hostFailures++; \
+        } \
+    } while (0)
+
+#endif
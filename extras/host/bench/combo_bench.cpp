@@ -0,0 +1,61 @@
+#define MMZ_MAX_COMBOS 320
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include <chrono>
+#include <memory>
+#include <string.h>
+
+#include "HostHarness.h"
+
+// コンボのベンチマーク 64キーで0、32、320個のコンボを登録し、トレースを再生したときの一回のスキャンの時間を測る
+// Benchmark of combos: plays a synthetic trace through a 64-key pad with 0, 32 and 320 two-key combos
+// registered and reports the time per scan, the combos that fired and the presses replayed.
+//     combo_bench [--quick]
+
+static constexpr uint16_t N = 64;
+static constexpr uint32_t SCAN_PERIOD = 250; //スキャンの間隔(us) Virtual time between scans
+
+static void run(const uint16_t combos, const Host::Trace& trace) {
+    static uint8_t pins[N];
+    for (uint16_t i = 0; i < N; i++) { pins[i] = i; }
+    Host::reset();
+
+    auto reader = std::make_unique<Direct<N>>(pins);
+    auto pad = std::make_unique<MacroPad<N, 1, 1, SerialEngine<N>, Direct<N>>>(*reader);
+    static Keymap<N> keys;
+    for (uint16_t i = 0; i < N; i++) { keys[i] = pressTo('a' + i % 26); }
+    static ProfiledLayers<N, 1, 1> keymap = {{{{ keys }}}};
+    pad->attach(keymap);
+
+    //隣り合うキー、次に1つおきのキー... の組 Pairs of neighbouring keys, then of keys two apart, and so on
+    for (uint16_t i = 0; i < combos; i++) {
+        const uint16_t key = i % N;
+        CHECK(pad->COMBOS.add({ key, static_cast<uint16_t>((key + 1 + i / N) % N) }, pressTo('!')));
+    }
+
+    Keyboard.clear();
+    Keyboard.log.reserve(trace.size() * 2 + 16);
+
+    const size_t allocations = Host::allocations();
+    const auto start = std::chrono::steady_clock::now();
+    const uint32_t scans = Host::play(trace, SCAN_PERIOD, 100000, Host::setDirectKey, [&pad]() { pad->update(); });
+    const auto end = std::chrono::steady_clock::now();
+
+    const ComboStats& stats = pad->COMBOS.getStats();
+    printf("%6u  %9.1f  %6zu  %6u  %8u  %10u\n", combos, std::chrono::duration<double, std::nano>(end - start).count() / scans,
+           Host::allocations() - allocations, stats.fired, stats.replayed, stats.maxLatency);
+}
+
+int main(int argc, char** argv) {
+    const bool quick = (argc > 1) && (strcmp(argv[1], "--quick") == 0);
+    const Host::Trace trace = Host::syntheticTrace(N, quick ? 1000000 : 20000000, 20, 9);
+
+    printf("combos    ns/scan  allocs   fired  replayed  max us held\n");
+    run(0, trace);
+    run(32, trace);
+    run(320, trace);
+    return g_hostFailures ? 1 : 0;
+}
@@ -0,0 +1,91 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include <memory>
+#include <string.h>
+
+#include "HostHarness.h"
+
+// チャタリング除去の方法ごとの遅延 チャタリングのあるキー入力と短いノイズを再生し、
+// 押してから(離してから)レポートまでの時間と、ノイズで送られたレポートの数を測る
+// Latency of each debounce mode: plays taps that bounce for 1.5 ms on key 0 and 0.4 ms noise pulses
+// on key 1, and reports the time from the first physical edge to the HID report and the number of
+// reports caused by noise. The debounce time is 5 ms and a scan runs every 250 us of virtual time.
+//     debounce_bench [--quick]
+
+static constexpr uint32_t SCAN_PERIOD = 250;
+static constexpr uint32_t TAP_PERIOD = 100000;
+static constexpr uint32_t HOLD_TIME = 40000;
+static constexpr uint32_t FIRST_TAP = 10000; //起動直後のデバウンス時間を避ける Clear of the debounce time after start-up
+
+static Host::Trace bouncyTrace(const uint32_t taps) {
+    Host::Trace trace;
+    for (uint32_t i = 0; i < taps; i++) {
+        const uint32_t t = FIRST_TAP + i * TAP_PERIOD;
+        //押したときと離したときのチャタリング Bounces after the press and after the release
+        for (const uint32_t bounce : { 0, 700, 1500 }) { trace.push_back({ t + bounce, 0, true }); }
+        for (const uint32_t bounce : { 300, 1100 }) { trace.push_back({ t + bounce, 0, false }); }
+        for (const uint32_t bounce : { 0, 800 }) { trace.push_back({ t + HOLD_TIME + bounce, 0, false }); }
+        trace.push_back({ t + HOLD_TIME + 300, 0, true });
+        trace.push_back({ t + 70000, 1, true });
+        trace.push_back({ t + 70400, 1, false });
+    }
+    std::stable_sort(trace.begin(), trace.end(), [](const Host::TraceEvent& a, const Host::TraceEvent& b) { return a.time < b.time; });
+    return trace;
+}
+
+template<typename DEBOUNCE>
+static void run(const char* name, const Host::Trace& trace, const uint32_t taps) {
+    static uint8_t pins[2] = { 0, 1 };
+    Host::reset();
+
+    Direct<2> reader(pins);
+    auto pad = std::make_unique<MacroPad<2, 1, 1, SerialEngine<2, TimingTable, DEBOUNCE>>>(reader);
+    ProfiledLayers<2, 1, 1> keymap = {{{{ pressTo('a'), pressTo('n') }}}};
+    pad->init(keymap);
+    Key::init(500, 100, 200, 5);
+
+    Keyboard.clear();
+    const uint32_t start = Host::clock;
+    Host::play(trace, SCAN_PERIOD, 100000, Host::setDirectKey, [&pad]() { pad->update(); });
+
+    uint32_t presses = 0, releases = 0, noise = 0;
+    uint64_t pressSum = 0, releaseSum = 0;
+    uint32_t pressMax = 0, releaseMax = 0;
+    for (const HostKeyboard::Entry& entry : Keyboard.log) {
+        if (entry.code != 'a') {
+            noise++;
+            continue;
+        }
+        const uint32_t time = entry.time - start - FIRST_TAP;
+        if (entry.pressed) {
+            const uint32_t latency = time - presses * TAP_PERIOD;
+            pressSum += latency;
+            if (latency > pressMax) { pressMax = latency; }
+            presses++;
+        } else {
+            const uint32_t latency = time - releases * TAP_PERIOD - HOLD_TIME;
+            releaseSum += latency;
+            if (latency > releaseMax) { releaseMax = latency; }
+            releases++;
+        }
+    }
+    CHECK((presses == taps) && (releases == taps));
+
+    printf("%-44s  %8.0f  %8u  %10.0f  %10u  %5u\n", name, presses ? static_cast<double>(pressSum) / presses : 0.0, pressMax,
+           releases ? static_cast<double>(releaseSum) / releases : 0.0, releaseMax, noise);
+}
+
+int main(int argc, char** argv) {
+    const bool quick = (argc > 1) && (strcmp(argv[1], "--quick") == 0);
+    const uint32_t taps = quick ? 20 : 500;
+    const Host::Trace trace = bouncyTrace(taps);
+
+    printf("mode                                          press us  max us  release us  max us  noise\n");
+    run<EagerDebounce<>>("EagerDebounce<>", trace, taps);
+    run<DeferredDebounce<>>("DeferredDebounce<>", trace, taps);
+    run<AsymmetricDebounce<EagerDebounce<>, DeferredDebounce<>>>("AsymmetricDebounce<Eager, Deferred>", trace, taps);
+    return g_hostFailures ? 1 : 0;
+}
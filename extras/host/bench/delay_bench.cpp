@@ -0,0 +1,66 @@
+#define MMZ_MACRO_DELAY_CAPACITY 8192
+#include <Delay.h>
+
+#include <chrono>
+#include <string.h>
+#include <vector>
+
+#include "HostHarness.h"
+
+// MacroDelayのベンチマーク 数千のコールバックが待機しているときの予約、実行、取り消しの時間を測る
+// Benchmark of MacroDelay with thousands of callbacks pending: the time to schedule one, to run
+// invoke() once per ms while they come due, and to cancel one.
+//     delay_bench [--quick]
+
+static uint32_t g_calls = 0;
+
+static double elapsed(const std::chrono::steady_clock::time_point start, const uint32_t count) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+static void run(const uint16_t pending, const uint32_t seed) {
+    std::mt19937 random(seed);
+    std::vector<DelayHandle> handles(pending);
+    Host::reset();
+    g_calls = 0;
+
+    const size_t allocations = Host::allocations();
+    auto start = std::chrono::steady_clock::now();
+    for (uint16_t i = 0; i < pending; i++) { handles[i] = macroDelay(1 + random() % 10000, []() { g_calls++; }); }
+    const double perSchedule = elapsed(start, pending);
+    CHECK(MacroDelay::getNumOfPending() == pending);
+
+    //半分を取り消す Cancel every other callback.
+    start = std::chrono::steady_clock::now();
+    for (uint16_t i = 0; i < pending; i += 2) { MacroDelay::cancel(handles[i]); }
+    const double perCancel = elapsed(start, (pending + 1) / 2);
+
+    uint32_t updates = 0;
+    start = std::chrono::steady_clock::now();
+    while (MacroDelay::getNumOfPending() > 0) {
+        Host::advance(1000);
+        MacroDelay::invoke();
+        updates++;
+    }
+    const double perUpdate = elapsed(start, updates);
+    CHECK(g_calls == pending / 2U);
+
+    printf("%7u  %10.1f  %8.1f  %10.1f  %6zu  %7u\n", pending, perSchedule, perCancel, perUpdate,
+           Host::allocations() - allocations, MacroDelay::getDroppedCount());
+}
+
+int main(int argc, char** argv) {
+    const bool quick = (argc > 1) && (strcmp(argv[1], "--quick") == 0);
+
+    printf("pending  ns/delay()  ns/cancel  ns/invoke()  allocs  dropped\n");
+    run(32, 1);
+    run(1000, 2);
+    if (!quick) { run(4000, 3); }
+    run(MacroDelay::CAPACITY, 4);
+
+    //満杯の場合は失敗し、数える When every slot is in use, delay() fails and the drop is counted.
+    for (uint16_t i = 0; i < MacroDelay::CAPACITY; i++) { macroDelay(1, []() {}); }
+    CHECK(!macroDelay(1, []() {}).isValid());
+    CHECK(MacroDelay::getDroppedCount() == 1);
+    return g_hostFailures ? 1 : 0;
+}
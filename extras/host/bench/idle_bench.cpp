@@ -0,0 +1,97 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/InterruptDirect.h>
+
+#include <string.h>
+
+#include "HostHarness.h"
+
+// idle()のベンチマーク InterruptDirect<N, InjectedEdgeSource>にトレースのエッジを与え、250usごとに
+// スキャンする場合とidle()で眠る場合の、1秒あたりのupdate()と起床の回数、エッジからマクロの実行までの時間を比べる
+// Benchmark of idle(): injects the edges of a trace into InterruptDirect<N, InjectedEdgeSource> and
+// compares polling every 250 us with sleeping in idle() between updates. Time is virtual: a sleep
+// lasts until its timeout or the next edge of the trace. Reports update() calls and wakeups per
+// second of trace, and the time from an injected edge to the RISING_EDGE/FALLING_EDGE macro,
+// which should be the same in both modes.
+//     idle_bench [--quick] [trace file]
+
+static constexpr uint16_t N = 12;
+static constexpr uint32_t SCAN_PERIOD = 250; //スキャンの間隔(us) Virtual time between scans when polling
+
+static uint32_t g_edgeAt[N];   //最後にエッジを与えた時刻 When the last edge of each key was injected
+static uint64_t g_latencySum = 0;
+static uint32_t g_latencyMax = 0, g_dispatched = 0;
+
+static void run(const char* traceName, const Host::Trace& trace, const bool sleep) {
+    static uint8_t pins[N];
+    for (uint16_t i = 0; i < N; i++) { pins[i] = i; }
+    Host::reset();
+    g_latencySum = 0;
+    g_latencyMax = 0;
+    g_dispatched = 0;
+
+    InterruptDirect<N, InjectedEdgeSource> reader(pins);
+    MacroPad<N, 1, 1, SerialEngine<N>, InterruptDirect<N, InjectedEdgeSource>> pad(reader);
+    const Macro edge([](const Key& key) {
+        const uint32_t latency = micros() - g_edgeAt[key.getIndex()];
+        g_latencySum += latency;
+        if (latency > g_latencyMax) { g_latencyMax = latency; }
+        g_dispatched++;
+    }, Key::mask(Key::Event::RISING_EDGE, Key::Event::FALLING_EDGE));
+    Keymap<N> keys;
+    for (uint16_t i = 0; i < N; i++) { keys[i] = edge; }
+    ProfiledLayers<N, 1, 1> keymap = {{{{ keys }}}};
+    pad.init(keymap);
+
+    const uint32_t end = (trace.empty() ? 0 : trace.back().time) + 1000000;
+    uint32_t updates = 0;
+    size_t next = 0;
+    while (micros() < end) {
+        while ((next < trace.size()) && (trace[next].time <= micros())) {
+            Host::setDirectKey(trace[next].key, trace[next].pressed);
+            g_edgeAt[trace[next].key] = micros();
+            InjectedEdgeSource::inject(1UL << trace[next].key);
+            next++;
+        }
+
+        pad.update();
+        updates++;
+
+        uint32_t step = SCAN_PERIOD;
+        if (sleep) {
+            const uint32_t wakeups = pad.getIdleStats().wakeups;
+            pad.idle();
+            if (pad.getIdleStats().wakeups != wakeups) { step = InjectedEdgeSource::getLastTimeout(); }
+        }
+        //次のエッジで起きる An edge ends the sleep.
+        if ((next < trace.size()) && (trace[next].time - micros() < step)) { step = trace[next].time - micros(); }
+        if (step == 0) { step = 1; }
+        Host::advance(step);
+    }
+
+    const double seconds = end / 1e6;
+    printf("%-9s  %-8s  %10.1f  %10.1f  %6u  %8u  %8u\n", traceName, sleep ? "idle()" : "polling",
+           updates / seconds, pad.getIdleStats().wakeups / seconds, g_dispatched,
+           g_dispatched ? static_cast<uint32_t>(g_latencySum / g_dispatched) : 0, g_latencyMax);
+}
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    const char* path = MMZ_HOST_TRACE_DIR "/typing.trace";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) { quick = true; }
+        else { path = argv[i]; }
+    }
+    const Host::Trace synthetic = Host::syntheticTrace(N, quick ? 2000000 : 60000000, 5, 14);
+    const Host::Trace recorded = Host::loadTrace(path, N);
+
+    printf("trace      mode       updates/s  wakeups/s   edges   mean us    max us\n");
+    run("synthetic", synthetic, false);
+    run("synthetic", synthetic, true);
+    if (!recorded.empty()) {
+        run("recorded", recorded, false);
+        run("recorded", recorded, true);
+    }
+    return 0;
+}
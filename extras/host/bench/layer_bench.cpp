@@ -0,0 +1,74 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include <chrono>
+#include <memory>
+#include <string.h>
+
+#include "HostHarness.h"
+
+// レイヤーとプロファイルの切り替えのベンチマーク 8レイヤー、4プロファイルのキーマップでLAYERS.set()と
+// PROFILES.set()の時間を測り、ヒープを確保しないことを確認する
+// Benchmark of layer and profile switches: LAYERS.set() and PROFILES.set() on 8 layers and 4 profiles
+// of Macro and of Action keymaps, checking that no switch allocates.
+//     layer_bench [--quick]
+
+static constexpr uint8_t LAYERS = 8;
+static constexpr uint8_t PROFILES = 4;
+
+template<typename F>
+static void measure(const uint16_t keys, const char* keymap, const char* operation, const uint32_t calls, F&& call) {
+    const size_t allocations = Host::allocations();
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < calls; i++) { call(i); }
+    const auto end = std::chrono::steady_clock::now();
+
+    const size_t allocated = Host::allocations() - allocations;
+    CHECK(allocated == 0);
+    printf("%4u  %-7s  %-15s  %9.1f  %6zu\n", keys, keymap, operation,
+           std::chrono::duration<double, std::nano>(end - start).count() / calls, allocated);
+}
+
+template<uint16_t N>
+static void run(const uint32_t calls) {
+    static uint8_t pins[N];
+    for (uint16_t i = 0; i < N; i++) { pins[i] = i; }
+    Host::reset();
+
+    Direct<N> reader(pins);
+    auto pad = std::make_unique<MacroPad<N, LAYERS, PROFILES>>(reader);
+
+    //上のレイヤーはキーの半分を透過する Upper layers let every other key through.
+    auto macros = std::make_unique<ProfiledLayers<N, LAYERS, PROFILES>>();
+    auto actions = std::make_unique<ActionProfiles<N, LAYERS, PROFILES>>();
+    for (uint8_t profile = 0; profile < PROFILES; profile++) {
+        for (uint8_t layer = 0; layer < LAYERS; layer++) {
+            for (uint16_t key = 0; key < N; key++) {
+                const bool through = (layer > 0) && (key % 2 == 0);
+                const uint8_t code = 'a' + (key + layer + profile) % 26;
+                (*macros)[profile][layer][key] = through ? transparent() : pressTo(code);
+                (*actions)[profile][layer][key] = through ? Action::transparent() : Action::key(code);
+            }
+        }
+    }
+
+    pad->attach(*macros);
+    measure(N, "Macro", "LAYERS.set()", calls, [&pad](const uint32_t i) { pad->LAYERS.set(i % LAYERS); });
+    measure(N, "Macro", "PROFILES.set()", calls, [&pad](const uint32_t i) { pad->PROFILES.set(i % PROFILES); });
+
+    pad->attach(*actions);
+    measure(N, "Action", "LAYERS.set()", calls, [&pad](const uint32_t i) { pad->LAYERS.set(i % LAYERS); });
+    measure(N, "Action", "PROFILES.set()", calls, [&pad](const uint32_t i) { pad->PROFILES.set(i % PROFILES); });
+}
+
+int main(int argc, char** argv) {
+    const bool quick = (argc > 1) && (strcmp(argv[1], "--quick") == 0);
+    const uint32_t calls = quick ? 1000 : 100000;
+
+    printf("keys  keymap   operation          ns/call  allocs\n");
+    run<64>(calls);
+    run<255>(calls);
+    return g_hostFailures ? 1 : 0;
+}
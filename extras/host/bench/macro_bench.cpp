@@ -0,0 +1,48 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+
+#include <chrono>
+#include <string.h>
+
+#include "HostHarness.h"
+
+// マクロの呼び出しのベンチマーク Macroと以前のstd::function<void(Key)>で一回の呼び出しの時間を比べる
+// Benchmark of one macro dispatch: Macro (in place, const Key&) against the former
+// std::function<void(Key)>, which copies the key on every call, and the library's combinators.
+//     macro_bench [--quick]
+
+static volatile uint32_t g_sink = 0;
+
+template<typename F>
+static void run(const char* name, const F& macro, const Key& key, const uint32_t calls) {
+    const size_t allocations = Host::allocations();
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < calls; i++) { macro(key); }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double perCall = std::chrono::duration<double, std::nano>(end - start).count() / calls;
+    printf("%-40s  %7.2f  %6zu\n", name, perCall, Host::allocations() - allocations);
+}
+
+int main(int argc, char** argv) {
+    const bool quick = (argc > 1) && (strcmp(argv[1], "--quick") == 0);
+    const uint32_t calls = quick ? 200000 : 20000000;
+
+    Key key;
+    const uint8_t code = 'a';
+
+    const Macro macro([code](const Key& key) { g_sink = g_sink + code + key.getIndex(); });
+    const LegacyMacro legacy([code](Key key) { g_sink = g_sink + code + key.getIndex(); });
+    const Macro adapted(legacy);
+    const Macro combined = mod(macro, macro);
+
+    printf("macro                                     ns/call  allocs\n");
+    run("Macro (const Key&)", macro, key, calls);
+    run("std::function<void(Key)>", legacy, key, calls);
+    run("Macro holding std::function<void(Key)>", adapted, key, calls);
+    run("mod(Macro, Macro)", combined, key, calls);
+
+    CHECK(static_cast<bool>(combined));
+    return g_hostFailures ? 1 : 0;
+}
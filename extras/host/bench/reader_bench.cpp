@@ -0,0 +1,113 @@
+#include <KeyReader/Direct.h>
+#include <KeyReader/GhostFilter.h>
+#include <KeyReader/Matrix.h>
+#include <KeyReader/PortDirect.h>
+#include <KeyReader/PortMatrix.h>
+
+#include <chrono>
+#include <string.h>
+
+#include "HostHarness.h"
+
+// キーリーダーのベンチマーク digitalRead()で読むリーダーと、ポートで読むリーダーのread()の時間を比べる
+// Benchmark of KeyReader::read(): the digitalRead readers next to the port readers on the same wiring,
+// and GhostFilter over a 16x16 matrix next to the bare reader. The filter is also timed over a reader
+// that does no I/O, which isolates its own cost from the mock pins.
+// The mock port goes through digitalRead() for each of its 32 pins, so the time on the host favours
+// the digitalRead readers; the "I/O" column is what carries over to a board: digitalRead()/digitalWrite()
+// calls for the former, port reads and writes (one SIO register access each on an RP2040) for the latter.
+//     reader_bench [--quick]
+
+template<typename READER>
+static void run(const char* name, const uint16_t keys, READER& reader, const bool port, const uint32_t count) {
+    Host::pinAccesses = 0;
+    Host::PinPort::reads = 0;
+    Host::PinPort::writes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < count; i++) { reader.read(); }
+    const auto end = std::chrono::steady_clock::now();
+
+    const uint32_t accesses = port ? (Host::PinPort::reads + Host::PinPort::writes) : Host::pinAccesses;
+    printf("%-11s  %4u  %8.1f  %6.1f\n", name, keys,
+           std::chrono::duration<double, std::nano>(end - start).count() / count,
+           static_cast<double>(accesses) / count);
+}
+
+template<uint8_t ROWS, uint8_t COLS>
+static void runMatrix(uint8_t (&rowPins)[ROWS], uint8_t (&colPins)[COLS], const uint32_t count) {
+    Host::reset();
+    Host::MatrixWiring<ROWS, COLS>::attach(rowPins, colPins);
+    for (uint16_t key = 0; key < ROWS * COLS; key += 3) { Host::MatrixWiring<ROWS, COLS>::setKey(key, true); }
+
+    Matrix<ROWS, COLS> matrix(rowPins, colPins);
+    PortMatrix<ROWS, COLS, Host::PinPort> port(rowPins, colPins, 0);
+    run("Matrix", ROWS * COLS, matrix, false, count);
+    run("PortMatrix", ROWS * COLS, port, true, count);
+}
+
+// 状態を返すだけのリーダー A reader that does no I/O and only returns the state it was given
+template<uint16_t N>
+class FixedReader : public KeyReader<N> {
+public:
+    ReaderData::Word (&getStateData())[KeyReader<N>::KEYBOARD_SIZE] { return keys_; }
+    void read() {}
+
+private:
+    ReaderData::Word keys_[KeyReader<N>::KEYBOARD_SIZE] = {};
+};
+
+// 長方形をなすキーを押した16x16のマトリクス A 16x16 matrix with rectangles of pressed keys, so the filter has work to do
+static void runGhost(const uint32_t count) {
+    static uint8_t rowPins[16];
+    static uint8_t colPins[16];
+    for (uint8_t i = 0; i < 16; i++) {
+        rowPins[i] = i;
+        colPins[i] = 16 + i;
+    }
+    Host::reset();
+    Host::MatrixWiring<16, 16>::attach(rowPins, colPins);
+    for (uint16_t key = 0; key < 256; key += 5) { Host::MatrixWiring<16, 16>::setKey(key, true); }
+
+    Matrix<16, 16> matrix(rowPins, colPins);
+    GhostFilter<16, 16> filter(matrix);
+    run("Matrix", 256, matrix, false, count);
+    run("GhostFilter", 256, filter, false, count);
+
+    FixedReader<256> fixed;
+    for (uint16_t key = 0; key < 256; key += 5) { ReaderData::setState(fixed.getStateData(), key, true); }
+    GhostFilter<16, 16> fixedFilter(fixed);
+    run("no I/O", 256, fixed, false, count * 10);
+    run("GhostFilter", 256, fixedFilter, false, count * 10);
+}
+
+template<uint16_t N>
+static void runDirect(uint8_t (&pins)[N], const uint32_t count) {
+    Host::reset();
+    for (uint16_t key = 0; key < N; key += 3) { Host::levels[pins[key]] = LOW; }
+
+    Direct<N> direct(pins);
+    PortDirect<N, Host::PinPort> port(pins);
+    run("Direct", N, direct, false, count);
+    run("PortDirect", N, port, true, count);
+}
+
+int main(int argc, char** argv) {
+    const bool quick = (argc > 1) && (strcmp(argv[1], "--quick") == 0);
+    const uint32_t count = quick ? 1000 : 200000;
+
+    static uint8_t rows4[4] = { 0, 1, 2, 3 };
+    static uint8_t cols4[4] = { 4, 5, 6, 7 };
+    static uint8_t rows10[10] = { 0, 1, 2, 4, 5, 6, 13, 14, 30, 31 };
+    static uint8_t cols7[7] = { 3, 7, 8, 9, 17, 18, 25 };
+    static uint8_t sparse[20] = { 0, 1, 2, 3, 5, 6, 8, 10, 11, 12, 13, 14, 16, 20, 21, 23, 22, 26, 29, 31 };
+    static uint8_t all[32];
+    for (uint8_t i = 0; i < 32; i++) { all[i] = i; }
+
+    printf("reader       keys   ns/read     I/O\n");
+    runMatrix(rows4, cols4, count);
+    runMatrix(rows10, cols7, count);
+    runGhost(count / 10);
+    runDirect(sparse, count);
+    runDirect(all, count);
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include <chrono>
+#include <memory>
+#include <string.h>
+#include <type_traits>
+
+#include "HostHarness.h"
+
+// MacroPad::update()のベンチマーク キー数とエンジンごとに、トレースを再生したときの一回のスキャンの時間を測る
+// Benchmark of MacroPad::update(): plays a synthetic and a recorded trace through pads of 12, 64, 128,
+// 255, 512 and 1024 keys with each engine and reports the time per scan, per key and the heap allocations.
+// Each pad runs twice: with the default KeyReader<N> reader type, which update() calls through virtual
+// functions, and with the concrete reader type, which it calls directly ("dispatch" virtual/static).
+// Up to 255 keys the pad reads the mock pins through Direct; larger pads have more keys than the mock
+// has pins, so the trace writes their state directly into a MemoryReader and the scan does no pin reads.
+// The build also makes scan_bench_64 with MMZ_READ_BITS=64 to compare the word widths.
+//     scan_bench [--quick] [trace file]
+
+static constexpr uint32_t SCAN_PERIOD = 250; //スキャンの間隔(us) Virtual time between scans
+
+// トレースが状態を直接書き込むリーダー A reader whose state the trace writes directly; read() does nothing.
+template<uint16_t N>
+class MemoryReader : public KeyReader<N> {
+public:
+    ReaderData::Word (&getStateData())[KeyReader<N>::KEYBOARD_SIZE] { return keys_; }
+    void read() {}
+    void setKey(const uint16_t key, const bool pressed) { ReaderData::setState(keys_, key, pressed); }
+
+private:
+    ReaderData::Word keys_[KeyReader<N>::KEYBOARD_SIZE] = {};
+};
+
+template<uint16_t N>
+using BenchReader = typename std::conditional<(N <= 255), Direct<N>, MemoryReader<N>>::type;
+
+// STATIC: MacroPadに具体的な読み取りクラスの型を渡す Gives MacroPad the concrete reader type instead of KeyReader<N>.
+template<uint16_t N, typename ENGINE, bool STATIC>
+static void run(const char* traceName, const char* engineName, const Host::Trace& trace, const uint8_t repeat) {
+    using Reader = typename std::conditional<STATIC, BenchReader<N>, KeyReader<N>>::type;
+    static uint8_t pins[(N <= 255) ? N : 1];
+    for (uint16_t i = 0; i < sizeof(pins); i++) { pins[i] = i; }
+    Host::reset();
+
+    std::unique_ptr<BenchReader<N>> reader;
+    if constexpr (N <= 255) { reader = std::make_unique<Direct<N>>(pins); }
+    else { reader = std::make_unique<MemoryReader<N>>(); }
+    auto pad = std::make_unique<MacroPad<N, 2, 1, ENGINE, Reader>>(*reader);
+    auto layers = std::make_unique<LayeredKeymap<N, 2>>();
+    for (uint16_t i = 0; i < N; i++) {
+        (*layers)[0][i] = pressTo('a' + i % 26);
+        (*layers)[1][i] = transparent();
+    }
+    ProfiledLayers<N, 2, 1> profiles = { *layers };
+    pad->init(profiles);
+
+    Keyboard.clear();
+    Keyboard.log.reserve(trace.size() * repeat + 16);
+
+    uint32_t scans = 0;
+    const size_t allocations = Host::allocations();
+    const auto start = std::chrono::steady_clock::now();
+    const auto setKey = [&reader](const uint16_t key, const bool pressed) {
+        if constexpr (N <= 255) { Host::setDirectKey(key, pressed); }
+        else { reader->setKey(key, pressed); }
+    };
+    for (uint8_t i = 0; i < repeat; i++) {
+        scans += Host::play(trace, SCAN_PERIOD, 100000, setKey, [&pad]() { pad->update(); });
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double perScan = std::chrono::duration<double, std::nano>(end - start).count() / scans;
+    printf("%4u  %-6s  %-8s  %-9s  %-12s  %9.1f  %7.2f  %6zu  %7zu\n", N, (N <= 255) ? "Direct" : "memory", STATIC ? "static" : "virtual",
+           traceName, engineName, perScan, perScan / N,
+           Host::allocations() - allocations, Keyboard.log.size());
+}
+
+template<uint16_t N, bool STATIC>
+static void runTraces(const Host::Trace& synthetic, const Host::Trace& recorded, const uint8_t repeat) {
+    run<N, SerialEngine<N>, STATIC>("synthetic", "serial", synthetic, repeat);
+    run<N, BitParallelEngine<N>, STATIC>("synthetic", "bit-parallel", synthetic, repeat);
+    if (recorded.empty()) { return; }
+    run<N, SerialEngine<N>, STATIC>("recorded", "serial", recorded, repeat);
+    run<N, BitParallelEngine<N>, STATIC>("recorded", "bit-parallel", recorded, repeat);
+}
+
+template<uint16_t N>
+static void runKeys(const Host::Trace& synthetic, const Host::Trace& recorded, const uint8_t repeat) {
+    runTraces<N, false>(synthetic, recorded, repeat);
+    runTraces<N, true>(synthetic, recorded, repeat);
+}
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    const char* path = MMZ_HOST_TRACE_DIR "/typing.trace";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) { quick = true; }
+        else { path = argv[i]; }
+    }
+    const uint32_t duration = quick ? 1000000 : 20000000;
+    const uint8_t repeat = quick ? 1 : 3;
+
+    printf("keys  reader  dispatch  trace      engine          ns/scan  ns/key  allocs  reports\n");
+    runKeys<12>(Host::syntheticTrace(12, duration, 20, 1), Host::loadTrace(path, 12), repeat);
+    runKeys<64>(Host::syntheticTrace(64, duration, 20, 2), Host::loadTrace(path, 64), repeat);
+    runKeys<128>(Host::syntheticTrace(128, duration, 20, 3), Host::loadTrace(path, 128), repeat);
+    runKeys<255>(Host::syntheticTrace(255, duration, 20, 4), Host::loadTrace(path, 255), repeat);
+    runKeys<512>(Host::syntheticTrace(512, duration, 20, 5), Host::loadTrace(path, 512), repeat);
+    runKeys<1024>(Host::syntheticTrace(1024, duration, 20, 6), Host::loadTrace(path, 1024), repeat);
+    return 0;
+}
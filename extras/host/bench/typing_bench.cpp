@@ -0,0 +1,118 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <string>
+
+#include "HostHarness.h"
+
+// Typingのベンチマーク 10KBの文字列をtypeTo()で入力する場合、Keyboard.print()で入力する場合、何も入力しない場合の
+// update()一回ごとの時間(最小、99パーセンタイル、最大)と、一回のupdate()で送るキー入力の最大数を比べる
+// Benchmark of Typing: a key queues a 10 KB text with typeTo(), types it with Keyboard.print() inside
+// the macro, or does nothing, and the pad is updated every 250 us until the text is out. Reports the
+// time of each update() (min, p99, max), the most presses and releases sent by one update() and the
+// total. On hardware each press or release costs a HID report, so the last columns are what blocks the scan.
+// Every character of the text must be pressed once and released right after, in order.
+//     typing_bench [--quick]
+
+static constexpr uint16_t N = 12;
+static constexpr uint32_t SCAN_PERIOD = 250; //スキャンの間隔(us) Virtual time between scans
+static constexpr uint32_t TEXT_SIZE = 10240;
+
+enum class Mode { IDLE, TYPING, PRINT };
+
+static std::string g_text;
+
+// 単語、数字、記号と改行からなる文字列 A text of words, digits, punctuation and line breaks
+static std::string makeText(const uint32_t size) {
+    static const char* const WORDS[] = { "the", "Quick", "brown", "fox", "jumps", "over", "LAZY", "dogs", "1234", "x_y", "(a+b)", "\"q\"" };
+    static const char* const SEPARATORS[] = { " ", " ", " ", ", ", ". ", "!\n", "\n" };
+    std::mt19937 random(22);
+    std::string text;
+    while (text.size() < size) {
+        text += WORDS[random() % (sizeof(WORDS) / sizeof(WORDS[0]))];
+        text += SEPARATORS[random() % (sizeof(SEPARATORS) / sizeof(SEPARATORS[0]))];
+    }
+    text.resize(size);
+    return text;
+}
+
+// 文字ごとに押して、次に同じキーを離していることを確認する Every character is pressed, then released, in order.
+static bool typedOnce(const std::vector<HostKeyboard::Entry>& log, const std::string& text) {
+    if (log.size() != text.size() * 2) { return false; }
+    for (size_t i = 0; i < text.size(); i++) {
+        const HostKeyboard::Entry& press = log[i * 2];
+        const HostKeyboard::Entry& release = log[i * 2 + 1];
+        if (!press.pressed || release.pressed) { return false; }
+        if ((press.code != static_cast<uint8_t>(text[i])) || (release.code != press.code)) { return false; }
+    }
+    return true;
+}
+
+static void run(const char* name, const Mode mode, const uint16_t rate) {
+    static uint8_t pins[N];
+    for (uint16_t i = 0; i < N; i++) { pins[i] = i; }
+    Host::reset();
+    Typing::reset();
+    Typing::setRate(rate);
+    Keyboard.clear();
+    Keyboard.log.reserve(g_text.size() * 2 + 16);
+
+    Direct<N> reader(pins);
+    MacroPad<N> pad(reader);
+    Macro macro;
+    if (mode == Mode::TYPING) { macro = typeTo(g_text.c_str()); }
+    else if (mode == Mode::PRINT) {
+        macro = Macro([](const Key& key) {
+            if (key.hasOccurred(Key::Event::RISING_EDGE)) { Keyboard.print(g_text.c_str()); }
+        }, Key::mask(Key::Event::RISING_EDGE));
+    } else {
+        macro = Macro([](const Key&) {}, Key::mask(Key::Event::RISING_EDGE));
+    }
+    Keymap<N> keys;
+    keys[0] = macro;
+    ProfiledLayers<N, 1, 1> keymap = {{{{ keys }}}};
+    pad.init(keymap);
+
+    //入力し終わるまで(と余裕の1秒) Long enough to type the whole text, plus one second
+    const uint32_t updates = (g_text.size() * (1000000 / rate) + 1000000) / SCAN_PERIOD;
+    std::vector<uint32_t> times(updates);
+    size_t mostKeys = 0;
+    for (uint32_t i = 0; i < updates; i++) {
+        if (i == 1) { Host::setDirectKey(0, true); }
+        if (i == 200) { Host::setDirectKey(0, false); }
+
+        const size_t before = Keyboard.log.size();
+        const auto start = std::chrono::steady_clock::now();
+        pad.update();
+        times[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        mostKeys = std::max(mostKeys, Keyboard.log.size() - before);
+        Host::advance(SCAN_PERIOD);
+    }
+
+    if (mode == Mode::IDLE) { CHECK(Keyboard.log.empty()); }
+    else { CHECK(typedOnce(Keyboard.log, g_text)); }
+    CHECK(Typing::getTimeUntilNext() == UINT32_MAX);
+
+    std::sort(times.begin(), times.end());
+    printf("%-8s  %8u  %7u  %7u  %10u  %9zu  %7zu\n", name, updates, times.front(), times[updates * 99 / 100], times.back(),
+           mostKeys, Keyboard.log.size());
+}
+
+int main(int argc, char** argv) {
+    const bool quick = (argc > 1) && (strcmp(argv[1], "--quick") == 0);
+    //短い設定では速く入力する A faster rate keeps the quick pass short.
+    const uint16_t rate = quick ? 2000 : MMZ_TYPING_RATE;
+    g_text = makeText(TEXT_SIZE);
+
+    printf("%u bytes at %u characters per second\n", TEXT_SIZE, rate);
+    printf("mode       updates   min ns   p99 ns      max ns  keys/upd.  keys\n");
+    run("none", Mode::IDLE, rate);
+    run("typeTo", Mode::TYPING, rate);
+    run("print", Mode::PRINT, rate);
+    return g_hostFailures ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+#ifndef MMZ_HOST_ARDUINO_H
+#define MMZ_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+// PC上でライブラリをビルドするためのArduino.hの代わり 時計はテストが進め、ピンの状態もテストが決める
+// Stand-in for Arduino.h to build the library on a PC. The clock only moves when the test advances it
+// and the pins read whatever the test scripted, so every run is reproducible.
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 3
+#define FALLING 4
+#define RISING 5
+
+namespace Host {
+    static constexpr uint16_t NUM_OF_PINS = 256;
+
+    //仮想的な時刻(us) Virtual time in us, atomic so the pipeline's scan thread can read it while a test advances it
+    inline std::atomic<uint32_t> clock{0};
+    //同じ時刻の64ビット版 millis()は実機と同じく2^32 msで一周する(micros()と一緒には一周しない)
+    //The same time in 64 bits, so millis() wraps at 2^32 ms like on the board, not together with micros().
+    inline std::atomic<uint64_t> clock64{0};
+    inline uint8_t levels[NUM_OF_PINS] = {};  //ピンの出力またはプルアップの状態 Level written to or pulled up on each pin
+    inline uint8_t modes[NUM_OF_PINS] = {};
+    // 設定した場合、digitalRead()はこの関数を呼ぶ(マトリクスの配線の再現など) Overrides digitalRead(), e.g. to model a matrix.
+    inline int (*readHook)(uint8_t pin) = nullptr;
+    inline uint32_t pinAccesses = 0;          //digitalRead()とdigitalWrite()の回数 Calls to digitalRead() and digitalWrite()
+
+    inline void advance(const uint32_t us) {
+        clock += us;
+        clock64 += us;
+    }
+
+    // 時刻とピンを初期状態に戻す Puts the clock and the pins back to their initial state.
+    inline void reset(const uint32_t time = 0) {
+        clock = time;
+        clock64 = time;
+        memset(levels, HIGH, sizeof(levels));
+        memset(modes, INPUT, sizeof(modes));
+        readHook = nullptr;
+    }
+}
+
+inline uint32_t micros() { return Host::clock; }
+inline uint32_t millis() { return static_cast<uint32_t>(Host::clock64 / 1000); }
+inline void delayMicroseconds(const uint32_t us) { Host::advance(us); }
+inline void delay(const uint32_t ms) { Host::advance(ms * 1000); }
+inline void yield() {}
+
+inline void pinMode(const uint8_t pin, const uint8_t mode) {
+    Host::modes[pin] = mode;
+    if (mode == INPUT_PULLUP) { Host::levels[pin] = HIGH; }
+}
+inline void digitalWrite(const uint8_t pin, const uint8_t level) {
+    Host::pinAccesses++;
+    Host::levels[pin] = level;
+}
+inline int digitalRead(const uint8_t pin) {
+    Host::pinAccesses++;
+    return Host::readHook ? Host::readHook(pin) : Host::levels[pin];
+}
+
+inline int digitalPinToInterrupt(const int pin) { return pin; }
+inline void attachInterrupt(int, void (*)(), int) {}
+inline void attachInterruptParam(int, void (*)(void*), int, void*) {}
+inline void detachInterrupt(int) {}
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+// 書き込まれたバイトを保存する Keeps every byte written, so tests can decode binary dumps.
+class Print {
+public:
+    virtual size_t write(const uint8_t value) {
+        bytes.push_back(value);
+        return 1;
+    }
+    virtual size_t write(const uint8_t* buffer, const size_t size) {
+        for (size_t i = 0; i < size; i++) { write(buffer[i]); }
+        return size;
+    }
+    size_t print(const char* text) { return write(reinterpret_cast<const uint8_t*>(text), strlen(text)); }
+    size_t println(const char* text = "") { return print(text) + write('\n'); }
+
+    virtual ~Print() = default;
+
+    std::vector<uint8_t> bytes;
+};
+
+class HostSerial : public Print {
+public:
+    void begin(unsigned long) {}
+    int available() { return 0; }
+    int read() { return -1; }
+    explicit operator bool() const { return true; }
+};
+
+inline HostSerial Serial;
+
+#endif
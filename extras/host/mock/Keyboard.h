@@ -0,0 +1,75 @@
+#ifndef MMZ_HOST_KEYBOARD_H
+#define MMZ_HOST_KEYBOARD_H
+
+#include <Arduino.h>
+#include <vector>
+
+// 送信されたキー入力を時刻とともに記録するKeyboardライブラリの代わり
+// Stand-in for the Keyboard library that records every press and release with the virtual time.
+
+#define KEY_LEFT_CTRL   0x80
+#define KEY_LEFT_SHIFT  0x81
+#define KEY_LEFT_ALT    0x82
+#define KEY_LEFT_GUI    0x83
+#define KEY_RIGHT_CTRL  0x84
+#define KEY_RIGHT_SHIFT 0x85
+#define KEY_RIGHT_ALT   0x86
+#define KEY_RIGHT_GUI   0x87
+#define KEY_UP_ARROW    0xDA
+#define KEY_DOWN_ARROW  0xD9
+#define KEY_LEFT_ARROW  0xD8
+#define KEY_RIGHT_ARROW 0xD7
+#define KEY_BACKSPACE   0xB2
+#define KEY_TAB         0xB3
+#define KEY_RETURN      0xB0
+#define KEY_ESC         0xB1
+#define KEY_DELETE      0xD4
+#define KEY_F1          0xC2
+
+class HostKeyboard : public Print {
+public:
+    struct Entry {
+        uint32_t time; //micros()
+        uint8_t code;
+        bool pressed;
+    };
+
+    void begin() {}
+    void end() {}
+
+    size_t press(const uint8_t code) { return add(code, true); }
+    size_t release(const uint8_t code) { return add(code, false); }
+    void releaseAll() {}
+
+    // Keyboard.write()/print()と同じく一文字ずつ押して離す Taps each character, like Keyboard.write() and print().
+    size_t write(const uint8_t code) override {
+        add(code, true);
+        return add(code, false);
+    }
+
+    void clear() { log.clear(); }
+
+    // 記録したキー入力のハッシュ(FNV-1a) timeを含めるかを選べる FNV-1a hash of the log, with or without the times.
+    uint64_t hash(const bool withTime = true) const {
+        uint64_t value = 14695981039346656037ULL;
+        auto mix = [&value](const uint8_t byte) { value = (value ^ byte) * 1099511628211ULL; };
+        for (const Entry& entry : log) {
+            if (withTime) { for (uint8_t shift = 0; shift < 32; shift += 8) { mix(entry.time >> shift); } }
+            mix(entry.code);
+            mix(entry.pressed);
+        }
+        return value;
+    }
+
+    std::vector<Entry> log;
+
+private:
+    size_t add(const uint8_t code, const bool pressed) {
+        log.push_back({ micros(), code, pressed });
+        return 1;
+    }
+};
+
+inline HostKeyboard Keyboard;
+
+#endif
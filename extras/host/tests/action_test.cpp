@@ -0,0 +1,108 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include "HostHarness.h"
+
+// constexprのActionProfilesのキーマップを動かし、送信したキーとレイヤー、プロファイルを確認する
+// Drives a constexpr ActionProfiles keymap: MOD_TAP sends its key on a tap and its modifier on a
+// hold, LAYER_HOLD turns its layer on while held and off on release, and PROFILE_BACK switches
+// the profile on release, not on press.
+
+static uint8_t pins[4] = { 0, 1, 2, 3 };
+static Direct<4> reader(pins);
+static MacroPad<4, 2, 2> pad(reader);
+
+static constexpr ActionProfiles<4, 2, 2> KEYMAP = {{
+    {{
+        {{ Action::key('a'), Action::modTap('x', KEY_LEFT_CTRL), Action::layerHold(1), Action::profileTo(1) }},
+        {{ Action::key('1'), Action::transparent(), Action::transparent(), Action::none() }},
+    }},
+    {{
+        {{ Action::key('b'), Action::modTap('y', KEY_LEFT_SHIFT), Action::profileBack(0), Action::none() }},
+        {{ Action::transparent(), Action::transparent(), Action::transparent(), Action::transparent() }},
+    }},
+}};
+
+static void scan(const uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        Host::advance(1000);
+        pad.update();
+    }
+}
+
+static void tap(const uint16_t key) {
+    Host::setDirectKey(key, true);
+    scan(40);
+    Host::setDirectKey(key, false);
+    scan(40);
+}
+
+//送信されたキー(押下は正、解放は負) The sent keys: the code for a press, minus the code for a release
+static std::vector<int> sent() {
+    std::vector<int> keys;
+    for (const HostKeyboard::Entry& entry : Keyboard.log) { keys.push_back(entry.pressed ? entry.code : -entry.code); }
+    Keyboard.clear();
+    return keys;
+}
+
+int main() {
+    Host::reset();
+    pad.attach(KEYMAP);
+    const Timing& timing = TimingTable::get(0);
+
+    tap(0);
+    CHECK(sent() == std::vector<int>({ 'a', -'a' }));
+
+    //MOD_TAP: タップでキー Tapped, it sends its key and no modifier.
+    tap(1);
+    scan(timing.doubleThreshold);
+    CHECK(sent() == std::vector<int>({ 'x', -'x' }));
+
+    //MOD_TAP: ホールドで修飾キー Held, it holds the modifier until release and never sends its key.
+    Host::setDirectKey(1, true);
+    scan(timing.holdThreshold + 20);
+    CHECK(sent() == std::vector<int>({ KEY_LEFT_CTRL }));
+    tap(0);
+    Host::setDirectKey(1, false);
+    scan(timing.doubleThreshold + 20);
+    CHECK(sent() == std::vector<int>({ 'a', -'a', -KEY_LEFT_CTRL }));
+
+    //LAYER_HOLD: 押している間だけレイヤー1 Layer 1 is on only while the key is held.
+    Host::setDirectKey(2, true);
+    scan(20);
+    CHECK((pad.LAYERS.get() == 1) && pad.LAYERS.isActive(1));
+    tap(0);
+    CHECK(sent() == std::vector<int>({ '1', -'1' }));
+    tap(1); //レイヤー1では透過 Transparent on layer 1
+    scan(timing.doubleThreshold);
+    CHECK(sent() == std::vector<int>({ 'x', -'x' }));
+    Host::setDirectKey(2, false);
+    scan(20);
+    CHECK((pad.LAYERS.get() == 0) && !pad.LAYERS.isActive(1));
+    tap(0);
+    CHECK(sent() == std::vector<int>({ 'a', -'a' }));
+
+    //PROFILE_TOは押したとき、PROFILE_BACKは離したとき PROFILE_TO switches on press, PROFILE_BACK on release.
+    Host::setDirectKey(3, true);
+    scan(20);
+    CHECK(pad.PROFILES.get() == 1);
+    Host::setDirectKey(3, false);
+    scan(20);
+    CHECK(pad.PROFILES.get() == 1);
+    tap(0);
+    CHECK(sent() == std::vector<int>({ 'b', -'b' }));
+
+    Host::setDirectKey(2, true);
+    scan(timing.longThreshold + 20);
+    CHECK(pad.PROFILES.get() == 1);
+    Host::setDirectKey(2, false);
+    scan(20);
+    CHECK(pad.PROFILES.get() == 0);
+    CHECK(pad.LAYERS.get() == 0);
+    tap(0);
+    CHECK(sent() == std::vector<int>({ 'a', -'a' }));
+
+    return g_hostFailures ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+#define MMZ_MAX_COMBOS 320
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include "HostHarness.h"
+
+// 300以上のコンボを登録し、候補が256を超えても小さいコンボがすぐに成立しないことを確認する
+// Registers over 300 combos so that more than 256 candidates contain the held keys; the smaller
+// combo must wait for its timeout instead of completing at once. Presses that complete no combo are
+// replayed in the order they happened.
+
+static constexpr uint16_t N = 32;
+static uint8_t pins[N];
+static Direct<N> reader(pins);
+static MacroPad<N> pad(reader);
+
+static void scan(const uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        Host::advance(1000);
+        pad.update();
+    }
+}
+
+static bool sent(const uint8_t code) {
+    for (const HostKeyboard::Entry& entry : Keyboard.log) {
+        if (entry.code == code) { return true; }
+    }
+    return false;
+}
+
+//codeが最初に押された位置 Position of the first press of code in the log, or the log size if none
+static size_t firstPress(const uint8_t code) {
+    for (size_t i = 0; i < Keyboard.log.size(); i++) {
+        if (Keyboard.log[i].pressed && (Keyboard.log[i].code == code)) { return i; }
+    }
+    return Keyboard.log.size();
+}
+
+int main() {
+    for (uint16_t i = 0; i < N; i++) { pins[i] = i; }
+    Host::reset();
+
+    Keymap<N> keys;
+    for (uint16_t i = 0; i < N; i++) { keys[i] = pressTo('a' + i % 26); }
+    ProfiledLayers<N, 1, 1> keymap = {{{{ keys }}}};
+    pad.init(keymap);
+
+    //{0, 1}と、それを含む256個の4キーのコンボ {0, 1} and 256 four-key combos containing it
+    CHECK(pad.COMBOS.add({ 0, 1 }, pressTo('!')));
+    uint16_t supersets = 0;
+    for (uint16_t x = 2; (x < N) && (supersets < 256); x++) {
+        for (uint16_t y = x + 1; (y < N) && (supersets < 256); y++) {
+            CHECK(pad.COMBOS.add({ 0, 1, x, y }, pressTo('?')));
+            supersets++;
+        }
+    }
+    //残りは{0, 1}を含まない The rest do not contain {0, 1}.
+    for (uint16_t x = 2; (x < N) && (pad.COMBOS.getNumOfCombos() < 300); x++) {
+        for (uint16_t y = x + 1; (y < N) && (pad.COMBOS.getNumOfCombos() < 300); y++) { CHECK(pad.COMBOS.add({ x, y }, pressTo('?'))); }
+    }
+    CHECK(pad.COMBOS.getNumOfCombos() == 300);
+
+    Host::setDirectKey(0, true);
+    Host::setDirectKey(1, true);
+    scan(5);
+    CHECK(!sent('!')); //より大きなコンボの候補が残っている Larger combos are still possible.
+
+    scan(200);
+    CHECK(sent('!'));
+    CHECK(!sent('a') && !sent('b') && !sent('?'));
+    CHECK(pad.COMBOS.getStats().fired == 1);
+    CHECK(pad.COMBOS.getStats().maxLatency >= MMZ_COMBO_TIMEOUT * 1000UL);
+
+    Host::setDirectKey(0, false);
+    Host::setDirectKey(1, false);
+    scan(50);
+    Keyboard.clear();
+
+    //{0, 2}はコンボではないが、{0, 1, 2, y}の候補として保留され、押した順に再生される
+    //{0, 2} is no combo, but both presses are held as part of {0, 1, 2, y} and replayed in order.
+    const uint32_t replayed = pad.COMBOS.getStats().replayed;
+    Host::setDirectKey(0, true);
+    scan(5);
+    Host::setDirectKey(2, true);
+    scan(5);
+    CHECK(Keyboard.log.empty());
+    scan(200);
+    CHECK(pad.COMBOS.getStats().replayed == replayed + 2);
+    CHECK(firstPress('a') < firstPress('c'));
+    CHECK(firstPress('c') < Keyboard.log.size());
+    CHECK(!sent('?') && !sent('!'));
+
+    return g_hostFailures ? 1 : 0;
+}
@@ -0,0 +1,211 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Composite.h>
+#include <KeyReader/Expander.h>
+#include <KeyReader/ShiftRegister.h>
+
+#include "HostHarness.h"
+
+// Compositeで12キーのShiftRegister、40キーの読み取りクラス(要素の途中から始まる)、8キーのExpanderをまとめ、
+// それぞれのキーが正しいインデックスに現れることを確認する Expanderの読み取り間隔とバスエラーも確認する
+// Joins a 12-key ShiftRegister, a 40-key reader that starts in the middle of a word and an 8-key
+// Expander with Composite, and checks that every key lands on its index, in the state words and in
+// the Key passed to the macros. Also checks that the Expander only polls every intervalMicros and
+// keeps its state on a bus error, and the word-aligned copy of a reader that starts on a word boundary.
+
+// 74HC165のチェーン LOADがLOWの間は入力を取り込み、LOADがHIGHならCLOCKの立ち上がりごとに1ビットずらす
+// A chain of 74HC165: the inputs are loaded while LOAD is LOW, and with LOAD HIGH every rising edge
+// of CLOCK shifts the next bit to DATA. A pressed button pulls its input LOW.
+struct ShiftChain {
+    static constexpr uint8_t LOAD_PIN = 3, CLOCK_PIN = 4, DATA_PIN = 5;
+    static constexpr uint32_t ALL = 0xFFFFFFFF;
+
+    static uint32_t read() { return (shifted & 1) ? ALL : (ALL & ~(1UL << DATA_PIN)); }
+    static void set(const uint32_t mask) {
+        if (mask & (1UL << LOAD_PIN)) { loading = false; }
+        if ((mask & (1UL << CLOCK_PIN)) && !loading) { shifted = (shifted >> 1) | (1UL << 31); }
+    }
+    static void clear(const uint32_t mask) {
+        if (mask & (1UL << LOAD_PIN)) {
+            loading = true;
+            shifted = ~pressed;
+        }
+    }
+    static void setOutputs(const uint32_t) {}
+    static void setPullUps(const uint32_t) {}
+
+    inline static uint32_t pressed = 0; //押されている入力(ビットnは入力n) Pressed inputs; bit n is input n
+    inline static uint32_t shifted = ALL;
+    inline static bool loading = false;
+};
+
+// 状態を直接書き込む読み取りクラス A reader whose state the test writes directly.
+template<uint16_t N>
+class MemoryReader : public KeyReader<N> {
+public:
+    ReaderData::Word (&getStateData())[KeyReader<N>::KEYBOARD_SIZE] { return keys_; }
+    void read() {}
+    void setKey(const uint16_t key, const bool pressed) { ReaderData::setState(keys_, key, pressed); }
+
+private:
+    ReaderData::Word keys_[KeyReader<N>::KEYBOARD_SIZE] = {};
+};
+
+// バスエラーを起こせるIOエキスパンダ An I/O expander whose transfers can be made to fail.
+struct FakeExpander {
+    bool read(uint32_t& value) {
+        transfers++;
+        if (fail) { return false; }
+        value = pins;
+        return true;
+    }
+
+    uint32_t pins = 0xFFFFFFFF;
+    bool fail = false;
+    uint32_t transfers = 0;
+};
+
+static constexpr uint32_t INTERVAL = 1000;
+
+static ShiftRegister<12, ShiftChain> shift(ShiftChain::LOAD_PIN, ShiftChain::CLOCK_PIN, ShiftChain::DATA_PIN, 0);
+static MemoryReader<40> memory;
+static FakeExpander device;
+static Expander<8, FakeExpander> expander(device, INTERVAL);
+
+using Reader = Composite<ShiftRegister<12, ShiftChain>, MemoryReader<40>, Expander<8, FakeExpander>>;
+static Reader reader(shift, memory, expander);
+static MacroPad<60, 1, 1, SerialEngine<60>, Reader> pad(reader);
+
+static_assert((Reader::NUM_OF_KEYS == 60) && (Reader::getOffset<1>() == 12) && (Reader::getOffset<2>() == 52), "Offsets");
+
+static bool reads(const uint16_t key) { return ReaderData::getBits(reader.getStateData(), key, 1) != 0; }
+
+static void setExpanderKey(const uint8_t pin, const bool pressed) {
+    if (pressed) { device.pins &= ~(1UL << pin); }
+    else { device.pins |= (1UL << pin); }
+}
+
+//キーiを押すか離す Presses or releases key i of the composite reader.
+static void setKey(const uint16_t key, const bool pressed) {
+    if (key < 12) {
+        if (pressed) { ShiftChain::pressed |= (1UL << key); }
+        else { ShiftChain::pressed &= ~(1UL << key); }
+    } else if (key < 52) {
+        memory.setKey(key - 12, pressed);
+    } else {
+        setExpanderKey(key - 52, pressed);
+    }
+}
+
+static void testIndices(std::mt19937& random) {
+    bool expected[60] = {};
+    for (uint16_t round = 0; round < 500; round++) {
+        for (uint16_t key = 0; key < 60; key++) {
+            expected[key] = (round == 1) || ((round > 1) && (random() % 3 == 0));
+            setKey(key, expected[key]);
+        }
+        Host::advance(INTERVAL);
+        reader.read();
+
+        bool same = true;
+        for (uint16_t key = 0; key < 60; key++) { same = same && (reads(key) == expected[key]); }
+        CHECK(same);
+        //最後の要素の残りのビットは0 The bits past the last key stay 0.
+        CHECK((reader.getStateData()[Reader::KEYBOARD_SIZE - 1] & ~ReaderData::validBits<60>(Reader::KEYBOARD_SIZE - 1)) == 0);
+    }
+    for (uint16_t key = 0; key < 60; key++) { setKey(key, false); }
+    Host::advance(INTERVAL);
+    reader.read();
+}
+
+static void testExpander() {
+    const uint32_t transfers = device.transfers;
+    setExpanderKey(3, true);
+    Host::advance(INTERVAL);
+    reader.read();
+    CHECK(reads(55) && (device.transfers == transfers + 1));
+
+    //間隔が過ぎるまでは前の状態のまま Until intervalMicros have passed, the previous state is kept.
+    setExpanderKey(3, false);
+    Host::advance(INTERVAL / 2);
+    reader.read();
+    CHECK(reads(55) && (device.transfers == transfers + 1));
+    Host::advance(INTERVAL / 2 - 1);
+    reader.read();
+    CHECK(reads(55) && (device.transfers == transfers + 1));
+    Host::advance(1);
+    reader.read();
+    CHECK(!reads(55) && (device.transfers == transfers + 2));
+
+    //バスエラーの間も前の状態のまま A failed transfer keeps the previous state and is counted.
+    setExpanderKey(7, true);
+    Host::advance(INTERVAL);
+    reader.read();
+    CHECK(reads(59));
+    device.fail = true;
+    setExpanderKey(7, false);
+    Host::advance(INTERVAL);
+    reader.read();
+    CHECK(reads(59) && (expander.getErrorCount() == 1) && (device.transfers == transfers + 4));
+    device.fail = false;
+    Host::advance(INTERVAL / 2);
+    reader.read();
+    CHECK(reads(59) && (device.transfers == transfers + 4)); //失敗した読み取りも間隔に数える A failed poll also waits out the interval.
+    Host::advance(INTERVAL / 2);
+    reader.read();
+    CHECK(!reads(59) && (expander.getErrorCount() == 1));
+}
+
+static std::vector<uint16_t> g_pressed;
+
+//MacroPadに渡るKeyのインデックス The index of the Key passed to the macros
+static void testKeys() {
+    const Macro log([](const Key& key) { g_pressed.push_back(key.getIndex()); }, Key::mask(Key::Event::RISING_EDGE));
+    Keymap<60> keys;
+    for (uint16_t i = 0; i < 60; i++) { keys[i] = log; }
+    ProfiledLayers<60, 1, 1> keymap = {{{{ keys }}}};
+    pad.init(keymap);
+
+    const uint16_t order[] = { 11, 12, 31, 32, 51, 52, 0, 59 };
+    for (const uint16_t key : order) {
+        setKey(key, true);
+        for (uint8_t i = 0; i < 10; i++) {
+            Host::advance(INTERVAL);
+            pad.update();
+        }
+    }
+    CHECK(g_pressed == std::vector<uint16_t>(std::begin(order), std::end(order)));
+}
+
+//要素の境界から始まる読み取りクラスは要素ごとにコピーされる A reader on a word boundary is copied word by word.
+static void testAligned(std::mt19937& random) {
+    MemoryReader<ReaderData::READ_BITS> first;
+    MemoryReader<12> second;
+    Composite<MemoryReader<ReaderData::READ_BITS>, MemoryReader<12>> aligned(first, second);
+    for (uint16_t round = 0; round < 100; round++) {
+        bool expected[ReaderData::READ_BITS + 12];
+        for (uint16_t key = 0; key < ReaderData::READ_BITS + 12; key++) {
+            expected[key] = (random() % 2 == 0);
+            if (key < ReaderData::READ_BITS) { first.setKey(key, expected[key]); }
+            else { second.setKey(key - ReaderData::READ_BITS, expected[key]); }
+        }
+        aligned.read();
+
+        bool same = true;
+        for (uint16_t key = 0; key < ReaderData::READ_BITS + 12; key++) {
+            same = same && ((ReaderData::getBits(aligned.getStateData(), key, 1) != 0) == expected[key]);
+        }
+        CHECK(same);
+    }
+}
+
+int main() {
+    Host::reset();
+    std::mt19937 random(18);
+    testIndices(random);
+    testExpander();
+    testKeys();
+    testAligned(random);
+    return g_hostFailures ? 1 : 0;
+}
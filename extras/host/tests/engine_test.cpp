@@ -0,0 +1,101 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include <memory>
+#include <vector>
+
+#include "HostHarness.h"
+
+// SerialEngineとBitParallelEngineが同じイベントを同じ時刻に発生させることを確認する
+// Replays the recorded typing trace and a synthetic trace through pads with SerialEngine and with
+// BitParallelEngine, every key bound to a macro that subscribes to all events, and checks that the
+// streams of (index, getOccurred(), micros()) are identical. Every call is hashed and counted, since
+// PRESSED/RELEASED alone run the macros millions of times; the calls with other events are also kept
+// so the first difference can be shown.
+
+struct Record {
+    uint16_t index;
+    uint16_t events;
+    uint32_t time;
+
+    bool operator==(const Record& other) const { return (index == other.index) && (events == other.events) && (time == other.time); }
+};
+
+struct Stream {
+    uint64_t hash = 0xcbf29ce484222325ULL; //FNV-1a
+    uint64_t calls = 0;
+    std::vector<Record> edges; //PRESSED/RELEASED以外を含む呼び出し Calls with events other than the input level
+
+    void add(const Record& record) {
+        for (const uint32_t value : { static_cast<uint32_t>(record.index), static_cast<uint32_t>(record.events), record.time }) {
+            for (uint8_t i = 0; i < 4; i++) {
+                hash ^= (value >> (i * 8)) & 0xFF;
+                hash *= 0x100000001b3ULL;
+            }
+        }
+        calls++;
+        if (record.events & ~Key::mask(Key::Event::PRESSED, Key::Event::RELEASED)) { edges.push_back(record); }
+    }
+};
+
+static Stream* g_stream = nullptr;
+
+template<uint16_t N, typename ENGINE>
+static Stream run(const Host::Trace& trace) {
+    static uint8_t pins[N];
+    for (uint16_t i = 0; i < N; i++) { pins[i] = i; }
+    Host::reset();
+    MacroDelay::reset();
+
+    Stream stream;
+    g_stream = &stream;
+
+    auto reader = std::make_unique<Direct<N>>(pins);
+    auto pad = std::make_unique<MacroPad<N, 1, 1, ENGINE>>(*reader);
+    auto keys = std::make_unique<Keymap<N>>();
+    for (uint16_t i = 0; i < N; i++) {
+        (*keys)[i] = Macro([](const Key& key) { g_stream->add({ key.getIndex(), key.getOccurred(), micros() }); }, Macro::ALL_EVENTS);
+    }
+    ProfiledLayers<N, 1, 1> profiles = {{{ *keys }}};
+    pad->init(profiles);
+
+    Host::play(trace, 250, 1000000, Host::setDirectKey, [&pad]() { pad->update(); });
+    g_stream = nullptr;
+    return stream;
+}
+
+template<uint16_t N>
+static void compare(const Host::Trace& trace) {
+    const Stream serialStream = run<N, SerialEngine<N>>(trace);
+    const Stream parallelStream = run<N, BitParallelEngine<N>>(trace);
+    printf("%3u keys: %llu calls, %zu with edges (serial)  %llu calls, %zu with edges (bit-parallel)\n", N,
+           static_cast<unsigned long long>(serialStream.calls), serialStream.edges.size(),
+           static_cast<unsigned long long>(parallelStream.calls), parallelStream.edges.size());
+
+    CHECK(serialStream.calls == parallelStream.calls);
+    CHECK(serialStream.hash == parallelStream.hash);
+
+    const std::vector<Record>& serial = serialStream.edges;
+    const std::vector<Record>& parallel = parallelStream.edges;
+    CHECK(!serial.empty());
+    CHECK(serial.size() == parallel.size());
+    size_t mismatch = 0;
+    while ((mismatch < serial.size()) && (mismatch < parallel.size()) && (serial[mismatch] == parallel[mismatch])) { mismatch++; }
+    CHECK(mismatch == serial.size());
+    if ((mismatch < serial.size()) && (mismatch < parallel.size())) {
+        printf("first difference at %zu: serial {%u, 0x%03x, %u} bit-parallel {%u, 0x%03x, %u}\n", mismatch,
+               serial[mismatch].index, serial[mismatch].events, serial[mismatch].time,
+               parallel[mismatch].index, parallel[mismatch].events, parallel[mismatch].time);
+    }
+}
+
+int main() {
+    const Host::Trace typing = Host::loadTrace(MMZ_HOST_TRACE_DIR "/typing.trace", 64);
+    CHECK(!typing.empty());
+    compare<64>(typing);
+    compare<12>(Host::syntheticTrace(12, 5000000, 20, 7));
+    compare<100>(Host::syntheticTrace(100, 5000000, 40, 8));
+    return g_hostFailures ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+#define MMZ_EVENT_LOG_SIZE 16
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include "HostHarness.h"
+
+// EventLogに記録されたイベントを取り出し、順序、時刻(micros()のオーバーフローをまたぐ)、あふれた数を確認する
+// Drains the EventLog and checks the records: oldest first, timestamps that stay ordered across the
+// wrap of micros(), and that a full log keeps the oldest events and counts the rest as lost.
+
+static uint8_t pins[2] = { 0, 1 };
+static Direct<2> reader(pins);
+static MacroPad<2> pad(reader);
+
+static void scan(const uint32_t ms, std::vector<EventRecord>* records) {
+    for (uint32_t i = 0; i < ms; i++) {
+        Host::advance(1000);
+        pad.update();
+
+        EventRecord record;
+        while ((records != nullptr) && EventLog::pop(record)) { records->push_back(record); }
+    }
+}
+
+//キー0をタップ、キー1を長押し、キー0をダブルクリック Tap key 0, hold key 1, double-click key 0.
+static void play(std::vector<EventRecord>* records) {
+    Host::setDirectKey(0, true);
+    scan(60, records);
+    Host::setDirectKey(0, false);
+    scan(300, records);
+
+    Host::setDirectKey(1, true);
+    scan(700, records);
+    Host::setDirectKey(1, false);
+    scan(100, records);
+
+    for (uint8_t i = 0; i < 2; i++) {
+        Host::setDirectKey(0, true);
+        scan(40, records);
+        Host::setDirectKey(0, false);
+        scan(40, records);
+    }
+    scan(300, records);
+}
+
+static bool has(const std::vector<EventRecord>& records, const uint16_t index, const Key::Event event) {
+    for (const EventRecord& record : records) {
+        if ((record.index == index) && (record.event == static_cast<uint8_t>(event))) { return true; }
+    }
+    return false;
+}
+
+int main() {
+    //100ms後にmicros()がオーバーフローする micros() wraps 100 ms into the first run.
+    Host::reset(UINT32_MAX - 100000);
+    ProfiledLayers<2, 1, 1> keymap = {{{{ pressTo('a'), pressTo('b') }}}};
+    pad.init(keymap);
+
+    const uint32_t start = micros();
+    std::vector<EventRecord> records;
+    play(&records);
+    CHECK(EventLog::getOverflowCount() == 0);
+    CHECK(records.size() > EventLog::CAPACITY);
+
+    CHECK((records.front().index == 0) && (records.front().event == static_cast<uint8_t>(Key::Event::RISING_EDGE)));
+    CHECK(has(records, 0, Key::Event::SINGLE));
+    CHECK(has(records, 1, Key::Event::HOLD));
+    CHECK(has(records, 1, Key::Event::LONG));
+    CHECK(has(records, 0, Key::Event::DOUBLE));
+    CHECK(!has(records, 0, Key::Event::PRESSED) && !has(records, 0, Key::Event::RELEASED));
+
+    //古い順で、オーバーフローの後も時刻の差は正 Oldest first; differences stay positive across the wrap.
+    bool wrapped = false;
+    for (size_t i = 1; i < records.size(); i++) {
+        CHECK(static_cast<int32_t>(records[i].time - records[i - 1].time) >= 0);
+        if (records[i].time < records[i - 1].time) { wrapped = true; }
+    }
+    CHECK(wrapped);
+    CHECK(records.front().time - start < 60000);
+
+    //取り出さずに同じ操作を繰り返す: 最初のCAPACITY個が残り、残りは失われる
+    //The same again without draining: the first CAPACITY events are kept and the rest are counted as lost.
+    const uint32_t again = micros();
+    play(nullptr);
+    CHECK(EventLog::size() == EventLog::CAPACITY);
+    CHECK(EventLog::getOverflowCount() == records.size() - EventLog::CAPACITY);
+
+    EventRecord kept[EventLog::CAPACITY + 1];
+    CHECK(EventLog::drain(kept, EventLog::CAPACITY + 1) == EventLog::CAPACITY);
+    for (uint16_t i = 0; i < EventLog::CAPACITY; i++) {
+        CHECK((kept[i].index == records[i].index) && (kept[i].event == records[i].event));
+        CHECK(kept[i].time - again == records[i].time - start);
+    }
+    CHECK(EventLog::size() == 0);
+
+    return g_hostFailures ? 1 : 0;
+}
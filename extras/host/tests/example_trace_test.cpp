@@ -0,0 +1,44 @@
+#include <new>
+
+#include "HostHarness.h"
+
+// examples/basic/basic.inoをそのままビルドし、決まったトレースを再生した結果を確認する
+// Builds examples/basic/basic.ino unchanged and plays a fixed trace through its loop(), twice in the
+// same process with the library's static state reset in between, so both runs must give the same log.
+#include "../../../examples/basic/basic.ino"
+
+static uint64_t run(const Host::Trace& trace) {
+    //スケッチのグローバル変数を作り直す Rebuild the sketch's globals as at start-up.
+    using Reader = decltype(matrix);
+    using Pad = decltype(macroPad);
+    macroPad.~Pad();
+    matrix.~Reader();
+    new (&matrix) Reader(rowPins, colPins);
+    new (&macroPad) Pad(matrix);
+
+    Host::reset();
+    MacroDelay::reset();
+    Typing::reset();
+    HidBatch::reset();
+    Stats::reset();
+    Keyboard.clear();
+
+    Host::MatrixWiring<3, 4>::attach(rowPins, colPins);
+    setup();
+    Host::play(trace, 1000, 5000000, Host::MatrixWiring<3, 4>::setKey, []() { loop(); });
+
+    const unsigned long long hash = Keyboard.hash();
+    printf("events=%zu reports=%zu hash=%016llx\n", trace.size(), Keyboard.log.size(), hash);
+
+    //ライブラリの変更で出力が変わった場合は、意図した変更か確認してから値を更新する
+    //When a change to the library alters the output, check that it was intended before updating the value.
+    CHECK(Keyboard.log.size() == 535);
+    CHECK(hash == 0x9e173aa18aa2e9f3ULL);
+    return hash;
+}
+
+int main() {
+    const Host::Trace trace = Host::syntheticTrace(12, 20000000, 8, 12345);
+    CHECK(run(trace) == run(trace));
+    return g_hostFailures ? 1 : 0;
+}
@@ -0,0 +1,83 @@
+#include <KeyReader/GhostFilter.h>
+
+#include "HostHarness.h"
+
+// ダイオードのないマトリクスで長方形の三つの角を押し、四つ目がゴーストとして隠されることを確認する
+// Presses three corners of a rectangle on a matrix without diodes: the fourth corner must be masked,
+// every corner must be ambiguous, keys already pressed must stay pressed and keys outside the
+// rectangle must pass through. Breaking the rectangle reports the held-back press.
+
+// ダイオードのないマトリクス 押したキーでつながった行と列はすべて押されたように読める
+// A matrix without diodes: rows joined through pressed keys read every column of each other.
+template<uint8_t ROWS, uint8_t COLS>
+class DiodelessMatrix : public KeyReader<ROWS * COLS> {
+public:
+    ReaderData::Word (&getStateData())[KeyReader<ROWS * COLS>::KEYBOARD_SIZE] { return keys_; }
+
+    void setKey(const uint8_t row, const uint8_t col, const bool pressed) {
+        if (pressed) { pressed_[row] |= (1UL << col); }
+        else { pressed_[row] &= ~(1UL << col); }
+    }
+
+    void read() {
+        uint32_t rows[ROWS];
+        for (uint8_t row = 0; row < ROWS; row++) { rows[row] = pressed_[row]; }
+
+        //列を共有する行の列をつながらなくなるまで合わせる Merge rows that share a column until nothing changes.
+        for (bool changed = true; changed; ) {
+            changed = false;
+            for (uint8_t a = 0; a < ROWS; a++) {
+                for (uint8_t b = 0; b < ROWS; b++) {
+                    if ((a == b) || !(rows[a] & rows[b]) || ((rows[a] | rows[b]) == rows[a])) { continue; }
+                    rows[a] |= rows[b];
+                    changed = true;
+                }
+            }
+        }
+        for (uint8_t row = 0; row < ROWS; row++) { ReaderData::setBits(keys_, row * COLS, COLS, rows[row]); }
+    }
+
+private:
+    ReaderData::Word keys_[KeyReader<ROWS * COLS>::KEYBOARD_SIZE] = {};
+    uint32_t pressed_[ROWS] = {};
+};
+
+static DiodelessMatrix<4, 4> matrix;
+static GhostFilter<4, 4> filter(matrix);
+
+static bool reads(const uint8_t row, const uint8_t col) { return ReaderData::getBits(filter.getStateData(), row * 4 + col, 1) != 0; }
+static bool ambiguous(const uint8_t row, const uint8_t col) { return filter.isAmbiguous(row * 4 + col); }
+
+int main() {
+    matrix.setKey(0, 0, true);
+    filter.read();
+    matrix.setKey(0, 1, true);
+    filter.read();
+    CHECK(reads(0, 0) && reads(0, 1));
+    CHECK(filter.getGhostScanCount() == 0);
+
+    //三つ目の角と、長方形の外のキー The third corner, and a key outside the rectangle
+    matrix.setKey(1, 0, true);
+    matrix.setKey(3, 3, true);
+    filter.read();
+    CHECK(ReaderData::getBits(matrix.getStateData(), 1 * 4 + 1, 1) != 0); //ゴースト The ghost, as read without the filter
+    CHECK(!reads(1, 1));
+    CHECK(!reads(1, 0));                //新しい押下は保留 The new press is held back.
+    CHECK(reads(0, 0) && reads(0, 1));  //押されていたキーはそのまま Keys already pressed stay pressed.
+    CHECK(reads(3, 3) && !ambiguous(3, 3));
+    CHECK(ambiguous(0, 0) && ambiguous(0, 1) && ambiguous(1, 0) && ambiguous(1, 1));
+    CHECK(filter.getGhostScanCount() == 1);
+
+    filter.read();
+    CHECK(!reads(1, 1) && !reads(1, 0));
+    CHECK(filter.getGhostScanCount() == 2);
+
+    //長方形がなくなると保留した押下が報告される Breaking the rectangle reports the held-back press.
+    matrix.setKey(0, 1, false);
+    filter.read();
+    CHECK(reads(0, 0) && !reads(0, 1) && reads(1, 0) && !reads(1, 1));
+    CHECK(!ambiguous(0, 0) && !ambiguous(1, 0) && !ambiguous(1, 1));
+    CHECK(filter.getGhostScanCount() == 2);
+
+    return g_hostFailures ? 1 : 0;
+}
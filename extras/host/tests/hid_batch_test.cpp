@@ -0,0 +1,70 @@
+#define MMZ_HID_BATCH 1
+#define MMZ_HID_QUEUE_SIZE 4
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+
+#include <vector>
+
+#include "HostHarness.h"
+
+// キューが満杯のときに離す入力が失われないことを確認する
+// Fills the HidBatch queue while 'a' is held, then releases and presses 'a' again before anything is
+// sent. The release must reach the sink, and the press that would cancel it is dropped and counted.
+
+class RecordingSink : public HidSink {
+public:
+    void send(const HidReport& report) override { reports.push_back(report); }
+    std::vector<HidReport> reports;
+};
+
+static RecordingSink g_sink;
+
+static void drain() {
+    for (uint16_t i = 0; i < 4 * MMZ_HID_QUEUE_SIZE; i++) {
+        Host::advance(MMZ_HID_INTERVAL);
+        HidBatch::flush();
+    }
+}
+
+int main() {
+    Host::reset();
+    HidBatch::reset();
+    HidBatch::begin(g_sink);
+
+    uint8_t usage, modifiers;
+    HidData::toUsage('a', usage, modifiers);
+
+    HidBatch::press('a');
+    HidBatch::commit();
+    drain();
+    CHECK((g_sink.reports.size() == 1) && g_sink.reports.back().isPressed(usage));
+
+    //別のキーのタップでキューを満たす Fill the queue with taps of other keys.
+    for (uint8_t code = 'b'; HidBatch::getNumOfPending() < MMZ_HID_QUEUE_SIZE; code++) {
+        HidBatch::press(code);
+        HidBatch::commit();
+        HidBatch::release(code);
+        HidBatch::commit();
+    }
+
+    //満杯のまま離して押し直す Release and press again while the queue is full.
+    HidBatch::release('a');
+    HidBatch::commit();
+    HidBatch::press('a');
+    HidBatch::commit();
+    CHECK(HidBatch::getDroppedCount() == 1);
+    CHECK(!HidBatch::getCurrent().isPressed(usage));
+
+    g_sink.reports.clear();
+    drain();
+    HidBatch::commit();
+    drain();
+
+    bool released = false;
+    for (const HidReport& report : g_sink.reports) { released = released || !report.isPressed(usage); }
+    CHECK(released);
+    CHECK(!g_sink.reports.empty() && (g_sink.reports.back() == HidReport{}));
+    CHECK(HidBatch::getNumOfPending() == 0);
+    return g_hostFailures ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/InterruptDirect.h>
+
+#include "HostHarness.h"
+
+// idle()で眠っても、保留中のHOLD/LONG/SINGLEの判定とmacroDelay()の期限に間に合うことを確認する
+// Sleeps with idle() after every update() and advances the clock by the whole sleep: pending HOLD,
+// LONG and SINGLE decisions and macroDelay() deadlines must still happen on time (within one ms),
+// and an idle pad must only wake up once per MMZ_MAX_IDLE_TIME.
+
+static uint8_t pins[2] = { 0, 1 };
+static InterruptDirect<2, InjectedEdgeSource> reader(pins);
+static MacroPad<2, 1, 1, SerialEngine<2>, InterruptDirect<2, InjectedEdgeSource>> pad(reader);
+
+struct Record {
+    uint16_t index;
+    uint16_t events;
+    uint32_t time;
+};
+static std::vector<Record> g_records;
+static uint32_t g_delayedAt = 0;
+
+static void press(const uint16_t key, const bool pressed) {
+    Host::setDirectKey(key, pressed);
+    InjectedEdgeSource::inject(1UL << key);
+}
+
+// usの間update()とidle()を繰り返し、眠った時間だけ時計を進める(眠れない場合は250us)
+// Runs update() and idle() for us, advancing the clock by each sleep (250 us when it cannot sleep).
+static void run(const uint32_t us) {
+    const uint32_t end = micros() + us;
+    while (static_cast<int32_t>(end - micros()) > 0) {
+        pad.update();
+        const uint32_t wakeups = pad.getIdleStats().wakeups;
+        pad.idle();
+
+        uint32_t step = (pad.getIdleStats().wakeups != wakeups) ? InjectedEdgeSource::getLastTimeout() : 250;
+        if (step > end - micros()) { step = end - micros(); }
+        Host::advance(step);
+    }
+}
+
+//eventが最初に発生した時刻 When event first occurred on the key, or 0
+static uint32_t firstTime(const uint16_t index, const Key::Event event) {
+    for (const Record& record : g_records) {
+        if ((record.index == index) && (record.events & Key::mask(event))) { return record.time; }
+    }
+    return 0;
+}
+
+int main() {
+    Host::reset(1000);
+    const Macro log([](const Key& key) { g_records.push_back({ key.getIndex(), key.getOccurred(), micros() }); },
+                    Macro::ALL_EVENTS & ~Key::mask(Key::Event::PRESSED, Key::Event::RELEASED));
+    ProfiledLayers<2, 1, 1> keymap = {{{{ log, log }}}};
+    pad.init(keymap);
+
+    //何も起きなければMMZ_MAX_IDLE_TIMEごとに起きる Nothing pending: one wakeup per MMZ_MAX_IDLE_TIME.
+    run(10000);
+    CHECK(pad.getIdleTime(micros()) == MMZ_MAX_IDLE_TIME * 1000UL);
+    pad.resetIdleStats();
+    run(5 * MMZ_MAX_IDLE_TIME * 1000UL);
+    CHECK(pad.getIdleStats().wakeups <= 6);
+
+    //押している間はHOLDとLONGの判定まで While held, the sleep ends in time for HOLD and then LONG.
+    const Timing& timing = TimingTable::get(0);
+    const uint32_t pressedAt = micros();
+    press(0, true);
+    pad.update();
+    CHECK(pad.getIdleTime(micros()) <= timing.holdThreshold * 1000UL);
+    run(timing.longThreshold * 1000UL + 50000);
+    const uint32_t holdAt = firstTime(0, Key::Event::HOLD);
+    const uint32_t longAt = firstTime(0, Key::Event::LONG);
+    CHECK((holdAt - pressedAt >= timing.holdThreshold * 1000UL) && (holdAt - pressedAt <= timing.holdThreshold * 1000UL + 1000));
+    CHECK((longAt - pressedAt >= timing.longThreshold * 1000UL) && (longAt - pressedAt <= timing.longThreshold * 1000UL + 1000));
+    press(0, false);
+    run(timing.doubleThreshold * 1000UL + 50000);
+
+    //離した後はSINGLEの判定まで After a tap, the sleep ends in time for SINGLE.
+    run(50000);
+    const uint32_t secondPressAt = micros();
+    press(1, true);
+    run(50000);
+    press(1, false);
+    const uint32_t tapAt = micros();
+    pad.update();
+    CHECK(pad.getIdleTime(micros()) <= timing.doubleThreshold * 1000UL + 1000);
+    run(timing.doubleThreshold * 1000UL + 50000);
+    const uint32_t singleAt = firstTime(1, Key::Event::SINGLE);
+    CHECK(firstTime(1, Key::Event::RISING_EDGE) - secondPressAt <= 1000);
+    CHECK((singleAt - tapAt > timing.doubleThreshold * 1000UL) && (singleAt - tapAt <= timing.doubleThreshold * 1000UL + 1000));
+
+    //macroDelay()の期限まで Until a macroDelay() callback is due
+    run(MMZ_MAX_IDLE_TIME * 1000UL);
+    const uint32_t scheduledAt = micros();
+    macroDelay(300, []() { g_delayedAt = micros(); });
+    CHECK(pad.getIdleTime(micros()) <= 300000);
+    pad.resetIdleStats();
+    run(400000);
+    CHECK((g_delayedAt - scheduledAt >= 300000) && (g_delayedAt - scheduledAt <= 301000));
+    CHECK(pad.getIdleStats().wakeups <= 3);
+
+    return g_hostFailures ? 1 : 0;
+}
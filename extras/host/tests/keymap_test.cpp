@@ -0,0 +1,100 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeymapLoader.h>
+#include <KeyReader/Direct.h>
+
+#include <string.h>
+
+#include "HostHarness.h"
+
+// KeymapFileのページの入れ替えと、プロファイルの数が異なるキーマップの拒否を確認する
+// Reading a profile into the scratch page must leave the page in use intact when the read fails; with
+// one page, a failed read must read the profile in use back, or empty the page if that fails too. A
+// keymap whose number of profiles differs from the MacroPad's must not be attached.
+
+static constexpr ActionProfiles<2, 1, 2> KEYMAP = {{
+    {{ { Action::key('a'), Action::profileTo(1) } }},
+    {{ { Action::key('b'), Action::profileTo(0) } }},
+}};
+
+// 読み込みを失敗させられるメモリ上のファイル A file in memory whose reads can be made to fail
+class MemoryFile {
+public:
+    explicit MemoryFile(const std::vector<uint8_t>& bytes) : bytes_(bytes), position_(0), failing_(false), failures_(0) {}
+
+    bool seek(const uint32_t position) {
+        position_ = position;
+        return position <= bytes_.size();
+    }
+    size_t read(uint8_t* buffer, const size_t size) {
+        if (failing_) { return 0; }
+        if (failures_ > 0) {
+            failures_--;
+            return 0;
+        }
+        const size_t count = std::min(size, bytes_.size() - position_);
+        memcpy(buffer, bytes_.data() + position_, count);
+        position_ += count;
+        return count;
+    }
+    void setFailing(const bool failing) { failing_ = failing; }
+    // 次のreads回の読み込みを失敗させる Makes the next reads calls fail.
+    void failNext(const uint32_t reads) { failures_ = reads; }
+
+private:
+    std::vector<uint8_t> bytes_;
+    size_t position_;
+    bool failing_;
+    uint32_t failures_;
+};
+
+int main() {
+    Host::reset();
+    Print image;
+    KeymapFormat::write(image, KEYMAP);
+
+    MemoryFile file(image.bytes);
+    KeymapFile<2, 1, MemoryFile> keymapFile(file);
+    CHECK(keymapFile.isValid());
+
+    const Action* first = keymapFile.load(0);
+    CHECK((first != nullptr) && (first[0] == Action::key('a')));
+
+    //読み込みに失敗しても使用中のページは変わらない A failed read leaves the page in use intact.
+    file.setFailing(true);
+    CHECK(keymapFile.load(1) == nullptr);
+    CHECK(first[0] == Action::key('a'));
+    CHECK(keymapFile.getReadErrorCount() == 1);
+
+    file.setFailing(false);
+    const Action* second = keymapFile.load(1);
+    CHECK((second != nullptr) && (second != first) && (second[0] == Action::key('b')));
+    CHECK(keymapFile.load(0) != nullptr);
+
+    //ページが一つの場合 With one page
+    KeymapFile<2, 1, MemoryFile, 1> singlePage(file);
+    const Action* page = singlePage.load(0);
+    CHECK((page != nullptr) && (page[0] == Action::key('a')));
+    file.failNext(1);
+    CHECK(singlePage.load(1) == nullptr);
+    CHECK(page[0] == Action::key('a')); //読み直した Read back
+    CHECK(singlePage.load(1) == page);
+    CHECK(page[0] == Action::key('b'));
+    file.setFailing(true);
+    CHECK(singlePage.load(0) == nullptr);
+    CHECK((page[0] == Action::none()) && (page[1] == Action::none())); //読み直せなければ空 Emptied when it cannot be read back
+    CHECK(singlePage.getReadErrorCount() == 3);
+    file.setFailing(false);
+    CHECK((singlePage.load(1) == page) && (page[0] == Action::key('b')));
+    CHECK(sizeof(singlePage) < sizeof(keymapFile));
+
+    //プロファイルの数が異なるキーマップは使わない A keymap with another number of profiles is rejected.
+    static uint8_t pins[2] = { 0, 1 };
+    Direct<2> reader(pins);
+    MacroPad<2, 1, 2> pad(reader);
+    MacroPad<2, 1, 3> wider(reader);
+    CHECK(pad.attach(keymapFile));
+    CHECK(!wider.attach(keymapFile));
+    return g_hostFailures ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include "HostHarness.h"
+
+// transparent()はレイヤーを切り替えてもBASEレイヤーの割り当てにたどり着く
+// transparent() keys fall through to BASE, whichever way the other layers are switched.
+
+static uint8_t pins[2] = { 0, 1 };
+static Direct<2> reader(pins);
+static MacroPad<2, 3, 1> pad(reader);
+
+//キーを押して離し、送信されたキーを返す Taps the key and returns the code it sent, 0 if none.
+static uint8_t tap(const uint16_t key) {
+    Keyboard.clear();
+    Host::setDirectKey(key, true);
+    for (uint8_t i = 0; i < 50; i++) { Host::advance(1000); pad.update(); }
+    Host::setDirectKey(key, false);
+    for (uint8_t i = 0; i < 50; i++) { Host::advance(1000); pad.update(); }
+    return Keyboard.log.empty() ? 0 : Keyboard.log.front().code;
+}
+
+int main() {
+    Host::reset();
+    ProfiledLayers<2, 3, 1> keymap = {{{{
+        {{ pressTo('a'), pressTo('b') }},
+        {{ transparent(), pressTo('c') }},
+        {{ transparent(), transparent() }},
+    }}}};
+    pad.init(keymap);
+
+    CHECK(tap(0) == 'a');
+
+    pad.LAYERS.set(2);
+    CHECK(pad.LAYERS.isActive(BASE));
+    CHECK(tap(0) == 'a');
+    CHECK(tap(1) == 'b');
+
+    pad.LAYERS.on(1);
+    CHECK(tap(1) == 'c'); //レイヤー2は透過 Layer 2 is transparent here.
+    pad.LAYERS.set(2);
+    CHECK(tap(1) == 'b'); //set()はレイヤー1を外す set() drops layer 1.
+
+    pad.LAYERS.off(BASE);
+    CHECK(pad.LAYERS.isActive(BASE));
+    CHECK(tap(0) == 'a');
+
+    return g_hostFailures ? 1 : 0;
+}
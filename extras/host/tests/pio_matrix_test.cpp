@@ -0,0 +1,53 @@
+#include <KeyReader/Matrix.h>
+#include <KeyReader/PioMatrix.h>
+
+#include "HostHarness.h"
+
+// PioModelで動かしたPIOのプログラムが、同じ配線のMatrixと同じ状態を読み取ることを確認する
+// Runs the PIO matrix program on PioModel over the mock pins and checks, for random sets of pressed
+// keys, that PioMatrix reads the same state words as Matrix on the same wiring. 4x8 packs the rows
+// into the state words; 5x7 pads every row to a word of its own.
+
+template<size_t SIZE>
+static bool sameWords(const ReaderData::Word (&a)[SIZE], const ReaderData::Word (&b)[SIZE]) {
+    for (size_t i = 0; i < SIZE; i++) {
+        if (a[i] != b[i]) { return false; }
+    }
+    return true;
+}
+
+template<uint8_t ROWS, uint8_t COLS>
+static void test(const uint8_t rowBase, const uint8_t colBase, const bool packed, std::mt19937& random) {
+    static uint8_t rowPins[ROWS];
+    static uint8_t colPins[COLS];
+    for (uint8_t i = 0; i < ROWS; i++) { rowPins[i] = rowBase + i; }
+    for (uint8_t i = 0; i < COLS; i++) { colPins[i] = colBase + i; }
+    using Wiring = Host::MatrixWiring<ROWS, COLS>;
+
+    Host::reset();
+    Wiring::attach(rowPins, colPins);
+    Matrix<ROWS, COLS> matrix(rowPins, colPins);
+    PioMatrix<ROWS, COLS, PioModel<Host::PinPort>> pio(rowBase, colBase);
+    CHECK(pio.isRunning());
+    CHECK(pio.PACKED == packed);
+
+    for (uint16_t round = 0; round < 500; round++) {
+        //最初はすべて離し、次はすべて押す First nothing, then everything pressed, then random sets.
+        for (uint16_t key = 0; key < ROWS * COLS; key++) { Wiring::setKey(key, (round == 1) || ((round > 1) && (random() % 4 == 0))); }
+
+        pio.read();
+        //PIOと同様に、PioModelは次のスキャンまで最後の行をLOWにしたままにする
+        //Like the PIO, PioModel keeps driving the last row LOW until its next scan; release it for Matrix.
+        Host::PinPort::setPullUps(PioData::toMask(rowBase, ROWS));
+        matrix.read();
+        CHECK(sameWords(pio.getStateData(), matrix.getStateData()));
+    }
+}
+
+int main() {
+    std::mt19937 random(15);
+    test<4, 8>(2, 10, true, random);
+    test<5, 7>(20, 9, false, random);
+    test<8, 4>(0, 8, true, random); //要素の境界をまたがない32キー 32 keys, each row within one word
+    return g_hostFailures ? 1 : 0;
+}
@@ -0,0 +1,69 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include "HostHarness.h"
+
+// dispatch()が200スキャンの間止まっても、毎スキャン発生するPRESSED/RELEASEDでエッジが失われないことを確認する
+// Stalls dispatch() for 200 scans while key 1 is pressed and released; key 0 subscribes to every
+// event, so it has PRESSED/RELEASED on every scan. No edge may be lost and 'a' must not stay down.
+
+static uint8_t pins[2] = { 0, 1 };
+static Direct<2> reader(pins);
+static MacroPad<2> pad(reader);
+static Pipeline<decltype(pad)> pipeline(pad);
+
+static uint32_t g_levels = 0;
+
+static void scan(const uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        Host::advance(1000);
+        pipeline.scan();
+    }
+}
+
+int main() {
+    Host::reset();
+    ProfiledLayers<2, 1, 1> keymap = {{{{ [](const Key&) { g_levels++; }, pressTo('a') }}}};
+    pad.init(keymap);
+
+    scan(50);
+    pipeline.dispatch();
+    CHECK(g_levels > 0);
+    const uint32_t levels = g_levels;
+
+    //dispatch()を止めたまま押して離す Press and release while dispatch() is stalled.
+    Host::setDirectKey(1, true);
+    scan(100);
+    Host::setDirectKey(1, false);
+    scan(100);
+    CHECK(Keyboard.log.empty());
+
+    pipeline.dispatch();
+    CHECK((Keyboard.log.size() == 2) && Keyboard.log[0].pressed && (Keyboard.log[0].code == 'a') && !Keyboard.log[1].pressed);
+    CHECK(g_levels == levels + 1); //まとめて1回 Coalesced into one call
+    CHECK(pipeline.getMaxLatency() >= 100000);
+
+    //キューが一杯になるほど押しても、scan()が待つため失われない
+    //Tapping until the queue fills makes scan() wait instead of losing events.
+    Keyboard.clear();
+    for (uint8_t i = 0; i < 60; i++) {
+        Host::setDirectKey(1, true);
+        scan(30);
+        Host::setDirectKey(1, false);
+        scan(30);
+    }
+    CHECK(pipeline.getStallCount() > 0);
+    pipeline.dispatch();
+    scan(50);
+    pipeline.dispatch();
+
+    int32_t held = 0;
+    for (const HostKeyboard::Entry& entry : Keyboard.log) { held += entry.pressed ? 1 : -1; }
+    CHECK(held == 0);
+    CHECK(!Keyboard.log.empty());
+    CHECK(pipeline.getOverflowCount() == 0);
+
+    return g_hostFailures ? 1 : 0;
+}
@@ -0,0 +1,67 @@
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include <atomic>
+#include <thread>
+
+#include "HostHarness.h"
+
+// start()で別のスレッドがscan()を繰り返す間、メインスレッドでキーを切り替えながらdispatch()する
+// start() runs scan() on its own thread while the main thread toggles keys and calls dispatch(),
+// as on two cores. Every press must be matched by a release and no event may be lost.
+// The pins are atomics read through Host::readHook, so the test itself is free of data races and can
+// be built with -fsanitize=thread to check the pipeline.
+
+static constexpr uint16_t N = 8;
+static uint8_t pins[N];
+static Direct<N> reader(pins);
+static MacroPad<N> pad(reader);
+static Pipeline<decltype(pad)> pipeline(pad);
+
+static std::atomic<uint8_t> g_pins[N];
+
+int main() {
+    for (uint16_t i = 0; i < N; i++) {
+        pins[i] = i;
+        g_pins[i] = HIGH;
+    }
+    Host::reset();
+    Host::readHook = [](const uint8_t pin) -> int { return (pin < N) ? g_pins[pin].load(std::memory_order_relaxed) : HIGH; };
+
+    Keymap<N> keys;
+    for (uint16_t i = 0; i < N; i++) { keys[i] = pressTo('a' + i); }
+    ProfiledLayers<N, 1, 1> keymap = {{{{ keys }}}};
+    pad.init(keymap);
+
+    std::mt19937 random(12);
+    pipeline.start();
+    for (uint32_t step = 0; step < 40000; step++) {
+        if (step % 20 == 0) {
+            const uint16_t key = random() % N;
+            g_pins[key].store((g_pins[key].load(std::memory_order_relaxed) == LOW) ? HIGH : LOW, std::memory_order_relaxed);
+        }
+        Host::advance(250);
+        pipeline.dispatch();
+        if (step % 64 == 0) { std::this_thread::yield(); }
+    }
+    for (std::atomic<uint8_t>& pin : g_pins) { pin = HIGH; }
+    pipeline.stop();
+
+    //スレッドを止めた後、離した状態を読み取って残りを実行する After stop(), scan the releases and dispatch the rest here.
+    for (uint16_t i = 0; i < 300; i++) {
+        Host::advance(1000);
+        pipeline.scan();
+        pipeline.dispatch();
+    }
+
+    int32_t held[N] = {};
+    for (const HostKeyboard::Entry& entry : Keyboard.log) { held[entry.code - 'a'] += entry.pressed ? 1 : -1; }
+    for (uint16_t i = 0; i < N; i++) { CHECK(held[i] == 0); }
+    CHECK(Keyboard.log.size() > 100);
+    CHECK(pipeline.getOverflowCount() == 0);
+    CHECK(pipeline.getRequestOverflowCount() == 0);
+
+    return g_hostFailures ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#include <KeyReader/Direct.h>
+#include <KeyReader/Matrix.h>
+#include <KeyReader/PortDirect.h>
+#include <KeyReader/PortMatrix.h>
+
+#include "HostHarness.h"
+
+// PortMatrixとPortDirectは、同じ配線のMatrixとDirectと同じ状態を読み取る
+// PortMatrix and PortDirect read the same state words as Matrix and Direct on the same wiring, for
+// random sets of pressed keys. The pins are not contiguous, and in the 10x7 matrix rows 4 and 9
+// straddle a word boundary (keys 28-34 and 63-69), whichever MMZ_READ_BITS the test is built with.
+
+template<size_t SIZE>
+static bool sameWords(const ReaderData::Word (&a)[SIZE], const ReaderData::Word (&b)[SIZE]) {
+    for (size_t i = 0; i < SIZE; i++) {
+        if (a[i] != b[i]) { return false; }
+    }
+    return true;
+}
+
+static void testMatrix(std::mt19937& random) {
+    static uint8_t rowPins[10] = { 0, 1, 2, 4, 5, 6, 13, 14, 30, 31 };
+    static uint8_t colPins[7] = { 3, 7, 8, 9, 17, 18, 25 };
+    using Wiring = Host::MatrixWiring<10, 7>;
+
+    Host::reset();
+    Wiring::attach(rowPins, colPins);
+    Matrix<10, 7> matrix(rowPins, colPins);
+    PortMatrix<10, 7, Host::PinPort> port(rowPins, colPins, 0);
+
+    for (uint16_t round = 0; round < 500; round++) {
+        //最初はすべて離し、次はすべて押す First nothing, then everything pressed, then random sets.
+        for (uint16_t key = 0; key < 70; key++) { Wiring::setKey(key, (round == 1) || ((round > 1) && (random() % 4 == 0))); }
+
+        matrix.read();
+        const uint32_t reads = Host::PinPort::reads;
+        port.read();
+        CHECK(Host::PinPort::reads - reads == 10); //一行につき一回 One port read per row
+        CHECK(sameWords(port.getStateData(), matrix.getStateData()));
+    }
+}
+
+template<uint16_t N>
+static void testDirect(uint8_t (&pins)[N], std::mt19937& random) {
+    Host::reset();
+    Direct<N> direct(pins);
+    PortDirect<N, Host::PinPort> port(pins);
+
+    for (uint16_t round = 0; round < 500; round++) {
+        for (uint16_t key = 0; key < N; key++) {
+            const bool pressed = (round == 1) || ((round > 1) && (random() % 3 == 0));
+            Host::levels[pins[key]] = pressed ? LOW : HIGH;
+        }
+
+        direct.read();
+        const uint32_t reads = Host::PinPort::reads;
+        port.read();
+        CHECK(Host::PinPort::reads - reads == 1);
+        CHECK(sameWords(port.getStateData(), direct.getStateData()));
+    }
+}
+
+int main() {
+    std::mt19937 random(6);
+    testMatrix(random);
+
+    //飛び飛びのピンと、逆順のピン Gaps between the pins, and two pins in descending order
+    static uint8_t sparse[20] = { 0, 1, 2, 3, 5, 6, 8, 10, 11, 12, 13, 14, 16, 20, 21, 23, 22, 26, 29, 31 };
+    testDirect(sparse, random);
+
+    //32本すべてが一つの連続した範囲 All 32 pins as a single run
+    static uint8_t all[32];
+    for (uint8_t i = 0; i < 32; i++) { all[i] = i; }
+    testDirect(all, random);
+
+    return g_hostFailures ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+#define MMZ_RECORDER 1
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include "HostHarness.h"
+
+// 記録用レイヤーで'a'のタップを記録し、再生で同じ間隔のキー入力が送られることを確認する
+// Records a tap of 'a' while the record layer is on and replays it: the replay must send the same
+// press and release 100 ms apart, and the replayed key must time its state from the replayed event.
+// A gap of 40 minutes, too long for an int32_t of us, must also be replayed at its length.
+
+static uint8_t pins[3] = { 0, 1, 2 };
+static Direct<3> reader(pins);
+static MacroPad<3, 2> pad(reader);
+static auto layer = pad.getLayerUtil();
+
+static const Macro g_pressA = pressTo('a');
+static uint32_t g_duration = UINT32_MAX; //'a'を離したときのgetStateDuration() getStateDuration() when 'a' is released
+
+static void scan(const uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        Host::advance(1000);
+        pad.update();
+    }
+}
+
+static void tap(const uint16_t key, const uint32_t holdMs) {
+    Host::setDirectKey(key, true);
+    scan(holdMs);
+    Host::setDirectKey(key, false);
+    scan(50);
+}
+
+int main() {
+    Host::reset();
+    LayeredKeymap<3, 2> keymap = {{
+        {{ Macro(Do {
+               g_pressA(key);
+               if (key.hasOccurred(Key::Event::FALLING_EDGE)) { g_duration = key.getStateDuration(); }
+           }, Key::mask(Key::Event::RISING_EDGE, Key::Event::FALLING_EDGE)),
+           layer.toggle(1), Macro([](const Key&) { pad.replay(); }, Key::mask(Key::Event::RISING_EDGE)) }},
+        {{ Macro::transparent(), layer.toggle(1), Macro::transparent() }},
+    }};
+    pad.init({ keymap });
+    pad.setRecordLayer(1);
+    scan(50);
+
+    tap(1, 30);
+    tap(0, 100);
+    tap(1, 30);
+    CHECK(Recorder::getNumOfEvents() == 2);
+    CHECK(g_duration == 0); //離した瞬間 Measured at the release edge
+
+    //再生 Replay
+    g_duration = UINT32_MAX;
+    Keyboard.clear();
+    tap(2, 30);
+    scan(300);
+    CHECK(g_duration == 0);
+    CHECK(Keyboard.log.size() == 2);
+    if (Keyboard.log.size() == 2) {
+        CHECK(Keyboard.log[0].code == 'a' && Keyboard.log[0].pressed && !Keyboard.log[1].pressed);
+        const uint32_t gap = Keyboard.log[1].time - Keyboard.log[0].time;
+        CHECK((gap >= 99000) && (gap <= 102000));
+    }
+    CHECK(!Recorder::isReplaying());
+
+    //40分の間隔(micros()は再生中に一周する) A gap of 40 minutes; micros() wraps during the replay.
+    constexpr uint32_t GAP = 40UL * 60 * 1000000;
+    tap(1, 30);
+    Host::setDirectKey(0, true);
+    scan(100);
+    Host::advance(GAP);
+    Host::setDirectKey(0, false);
+    scan(50);
+    tap(1, 30);
+    CHECK(Recorder::getNumOfEvents() == 2);
+
+    Keyboard.clear();
+    tap(2, 30); //離すまでに再生が始まり、80ms進む The replay starts and 80 ms pass before the jump.
+    Host::advance(GAP);
+    scan(300);
+    CHECK(Keyboard.log.size() == 2);
+    if (Keyboard.log.size() == 2) {
+        const uint32_t gap = Keyboard.log[1].time - Keyboard.log[0].time;
+        CHECK((gap >= GAP + 99000) && (gap <= GAP + 102000));
+    }
+    CHECK(!Recorder::isReplaying());
+    return g_hostFailures ? 1 : 0;
+}
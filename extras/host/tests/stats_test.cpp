@@ -0,0 +1,144 @@
+#define MMZ_STATS 1
+#include <Keyboard.h>
+#define USE_KEYBOARD_H
+#include <MacroPad.h>
+#include <KeyReader/Direct.h>
+
+#include "HostHarness.h"
+
+// dumpStats()のフレームをextras/stats_decoder.pyと同じように解析し、内容とチェックサムを確認する
+// Parses the frame written by dumpStats() the way extras/stats_decoder.py does and checks that it
+// round-trips: the histograms, the slowest macros and the Fletcher-16 checksum. Also checks that
+// values far beyond 16 buckets (scans in CPU cycles) land in their own bucket.
+
+static uint8_t pins[4] = { 0, 1, 2, 3 };
+static Direct<4> reader(pins);
+static MacroPad<4> pad(reader);
+
+struct Frame {
+    uint8_t version;
+    uint8_t buckets;
+    uint16_t cyclesPerMicro;
+    std::vector<uint32_t> histograms[3];
+    std::vector<std::pair<uint16_t, uint32_t>> slowest;
+};
+
+static uint16_t fletcher16(const uint8_t* data, const size_t length) {
+    uint16_t sum1 = 0, sum2 = 0;
+    for (size_t i = 0; i < length; i++) {
+        sum1 = (sum1 + data[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+}
+
+// 前後の文字列を読み飛ばしてフレームを一つ読む 不完全かチェックサムが違う場合はfalse
+// Finds one frame among the other bytes and parses it; false if it is incomplete or the checksum is wrong.
+static bool parse(const std::vector<uint8_t>& bytes, Frame& frame) {
+    static const uint8_t MAGIC[4] = { 'M', 'M', 'Z', 'S' };
+    const auto start = std::search(bytes.begin(), bytes.end(), std::begin(MAGIC), std::end(MAGIC));
+    if (start == bytes.end()) { return false; }
+    const uint8_t* data = &*start;
+    const size_t length = bytes.end() - start;
+
+    size_t offset = 4;
+    const auto get = [&](const uint8_t size) -> uint32_t {
+        uint32_t value = 0;
+        for (uint8_t i = 0; (i < size) && (offset < length); i++, offset++) { value |= static_cast<uint32_t>(data[offset]) << (i * 8); }
+        return value;
+    };
+    frame.version = get(1);
+    frame.buckets = get(1);
+    frame.cyclesPerMicro = get(2);
+    for (std::vector<uint32_t>& histogram : frame.histograms) {
+        histogram.clear();
+        for (uint8_t i = 0; i < frame.buckets; i++) { histogram.push_back(get(4)); }
+    }
+    const uint16_t count = get(2);
+    frame.slowest.clear();
+    for (uint16_t i = 0; i < count; i++) {
+        const uint16_t index = get(2);
+        frame.slowest.push_back({ index, get(4) });
+    }
+    if (offset + 2 > length) { return false; }
+    const uint16_t checksum = fletcher16(data, offset);
+    return get(2) == checksum;
+}
+
+static bool same(const std::vector<uint32_t>& counts, const StatsHistogram& histogram) {
+    return std::equal(counts.begin(), counts.end(), std::begin(histogram.counts), std::end(histogram.counts));
+}
+
+static void scan(const uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        Host::advance(1000);
+        pad.update();
+    }
+}
+
+static void tap(const uint16_t key) {
+    Host::setDirectKey(key, true);
+    scan(50);
+    Host::setDirectKey(key, false);
+    scan(400);
+}
+
+int main() {
+    //16区間を超える値 Values past the old 16 buckets, as in a scan of 200000 cycles
+    StatsHistogram histogram = {};
+    histogram.record(0);
+    histogram.record(200000);
+    histogram.record(UINT32_MAX);
+    CHECK((StatsHistogram::BUCKETS == 32) && (histogram.counts[0] == 1) && (histogram.counts[18] == 1) && (histogram.counts[31] == 1));
+
+    Host::reset();
+    const Macro slow([](const Key&) { Host::advance(1500); }, Key::mask(Key::Event::RISING_EDGE));
+    const Macro later([](const Key&) { macroDelay(20, []() {}); }, Key::mask(Key::Event::RISING_EDGE));
+    ProfiledLayers<4, 1, 1> keymap = {{{{ pressTo('a'), slow, later, pressTo('b') }}}};
+    pad.init(keymap);
+    pad.resetStats();
+
+    tap(0);
+    tap(1);
+    tap(2);
+    tap(3);
+    tap(1);
+
+    Print out;
+    out.print("text before the frame\n");
+    pad.dumpStats(out);
+    out.print("text after the frame\n");
+
+    Frame frame;
+    CHECK(parse(out.bytes, frame));
+    CHECK((frame.version == Stats::VERSION) && (frame.buckets == StatsHistogram::BUCKETS) && (frame.cyclesPerMicro == 1));
+    CHECK(same(frame.histograms[0], Stats::getScanHistogram()));
+    CHECK(same(frame.histograms[1], Stats::getLatenessHistogram()));
+    CHECK(same(frame.histograms[2], Stats::getReportHistogram()));
+
+    uint32_t scans = 0, reports = 0, delays = 0;
+    for (uint8_t i = 0; i < frame.buckets; i++) {
+        scans += frame.histograms[0][i];
+        delays += frame.histograms[1][i];
+        reports += frame.histograms[2][i];
+    }
+    CHECK(scans == 5 * 450);
+    CHECK(delays == 1);
+    CHECK(reports >= 2);
+
+    //最も遅いマクロは実行したキーのみ Only keys whose macro ran have a slowest run.
+    bool found = false;
+    for (const auto& entry : frame.slowest) {
+        CHECK(entry.second == pad.getSlowestMacro(entry.first));
+        if (entry.first == 1) { found = (entry.second == 1500); }
+    }
+    CHECK(found);
+    CHECK(pad.getSlowestMacro(2) < 1500);
+
+    //1バイトでも壊れたらチェックサムで弾く A single changed byte fails the checksum.
+    std::vector<uint8_t> corrupted = out.bytes;
+    corrupted[corrupted.size() / 2] ^= 0x10;
+    CHECK(!parse(corrupted, frame));
+
+    return g_hostFailures ? 1 : 0;
+}
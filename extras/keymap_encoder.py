@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+# JSONで書いたキーマップを KeymapImage/KeymapFile が読み込むバイナリ形式に変換する
+# Encodes a keymap written in JSON into the binary format read by KeymapImage and KeymapFile
+# (see src/KeymapLoader.h for the format).
+#
+#     python3 keymap_encoder.py keymap.json keymap.bin        # file for LittleFS or a flash region
+#     python3 keymap_encoder.py keymap.json keymap.h --c NAME # const array to compile into the sketch
+#
+# keymap.json: one list of key actions per layer, one list of layers per profile.
+#     {
+#         "keys": 4, "layers": 2,
+#         "profiles": [
+#             [["key:a", "modtap:0xB1:lctrl", "macro:0", "layer_hold:1"],
+#              ["key:1", "trans",             "profile_to:0", "trans"]]
+#         ]
+#     }
+# Actions: none, trans, key:<char or number> (key:: is the colon), modtap:<char or number>:<lctrl|lshift|lalt|lgui|rctrl|...>,
+#          layer_to:<n>, layer_back:<n>, layer_reset, layer_hold:<n>, layer_toggle:<n>,
+#          profile_to:<n>, profile_back:<n>, profile_reset, macro:<id>
+
+import json
+import struct
+import sys
+
+MAGIC = b"MMZK"
+VERSION = 1
+HEADER_SIZE = 16
+
+# Action::Type
+TYPES = {
+    "none": 0, "trans": 1, "key": 2, "modtap": 3,
+    "layer_to": 4, "layer_back": 5, "layer_reset": 6, "layer_hold": 7, "layer_toggle": 8,
+    "profile_to": 9, "profile_back": 10, "profile_reset": 11, "macro": 12,
+}
+MODIFIERS = ["lctrl", "lshift", "lalt", "lgui", "rctrl", "rshift", "ralt", "rgui"]
+
+
+def fletcher16(data):
+    sum1 = sum2 = 0
+    for byte in data:
+        sum1 = (sum1 + byte) % 255
+        sum2 = (sum2 + sum1) % 255
+    return (sum2 << 8) | sum1
+
+
+def keycode(text):
+    if len(text) == 1:
+        return ord(text)
+    return int(text, 0)
+
+
+def encode_action(text, layers, profiles):
+    # The argument is everything after the first ':', so "key::" is the ':' key and "modtap:::lctrl"
+    # taps ':'; the modifier of modtap is after the last ':'.
+    name, _, argument_text = text.partition(":")
+    if name not in TYPES:
+        raise ValueError(f"unknown action '{text}'")
+
+    argument = 0
+    if name == "key":
+        argument = keycode(argument_text)
+    elif name == "modtap":
+        code, _, modifier = argument_text.rpartition(":")
+        argument = keycode(code) | (MODIFIERS.index(modifier) << 8)
+    elif name in ("layer_to", "layer_back", "layer_hold", "layer_toggle"):
+        argument = int(argument_text, 0)
+        if argument >= layers:
+            raise ValueError(f"'{text}': there are only {layers} layers")
+    elif name in ("profile_to", "profile_back"):
+        argument = int(argument_text, 0)
+        if argument >= profiles:
+            raise ValueError(f"'{text}': there are only {profiles} profiles")
+    elif name == "macro":
+        argument = int(argument_text, 0)
+
+    if not 0 <= argument <= (0xFF if name == "key" else 0xFFF):
+        raise ValueError(f"'{text}': argument out of range")
+    return (TYPES[name] << 12) | argument
+
+
+def encode(keymap):
+    keys, layers, profiles = keymap["keys"], keymap["layers"], len(keymap["profiles"])
+    words = []
+    for p, profile in enumerate(keymap["profiles"]):
+        if len(profile) != layers:
+            raise ValueError(f"profile {p} has {len(profile)} layers instead of {layers}")
+        for l, layer in enumerate(profile):
+            if len(layer) != keys:
+                raise ValueError(f"profile {p} layer {l} has {len(layer)} keys instead of {keys}")
+            words += [encode_action(action, layers, profiles) for action in layer]
+
+    macros = max([(word & 0xFFF) + 1 for word in words if (word >> 12) == TYPES["macro"]], default=0)
+    body = struct.pack(f"<{len(words)}H", *words)
+    header = struct.pack("<4sBBHBBHHH", MAGIC, VERSION, HEADER_SIZE, keys, layers, profiles, macros, fletcher16(body), 0)
+    return header + body
+
+
+def to_c_array(name, data):
+    lines = ["// Generated by keymap_encoder.py", f"alignas(2) const uint8_t {name}[{len(data)}] = {{"]
+    for i in range(0, len(data), 16):
+        lines.append("    " + ", ".join(f"0x{byte:02X}" for byte in data[i:i + 16]) + ",")
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    if len(sys.argv) not in (3, 5) or (len(sys.argv) == 5 and sys.argv[3] != "--c"):
+        print("usage: keymap_encoder.py keymap.json out.bin [--c NAME]", file=sys.stderr)
+        sys.exit(2)
+
+    with open(sys.argv[1]) as source:
+        data = encode(json.load(source))
+
+    if len(sys.argv) == 5:
+        with open(sys.argv[2], "w") as out:
+            out.write(to_c_array(sys.argv[4], data))
+    else:
+        with open(sys.argv[2], "wb") as out:
+            out.write(data)
+    print(f"{len(data)} bytes", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
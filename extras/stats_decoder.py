@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+# MacroPad::dumpStats() が出力した統計を表示する
+# Decodes the statistics frames written by MacroPad::dumpStats() (see src/Stats.h for the format).
+# Text printed by the sketch between the frames is skipped.
+#
+#     python3 stats_decoder.py /dev/ttyACM0   # serial port (needs pyserial), reads until Ctrl+C
+#     python3 stats_decoder.py capture.bin    # file saved from the serial port
+#     python3 stats_decoder.py - < capture.bin
+
+import struct
+import sys
+
+MAGIC = b"MMZS"
+# 1は16区間、2は32区間 区間の数はヘッダーにあるのでどちらも読み取れる
+# 1: 16 buckets, 2: 32 buckets; the header gives the number of buckets, so both can be read.
+VERSIONS = (1, 2)
+
+
+def fletcher16(data):
+    sum1 = sum2 = 0
+    for byte in data:
+        sum1 = (sum1 + byte) % 255
+        sum2 = (sum2 + sum1) % 255
+    return (sum2 << 8) | sum1
+
+
+def parse(buffer):
+    """Returns (frame, consumed): frame is None while incomplete or if the checksum is wrong."""
+    header = struct.calcsize("<4sBBH")
+    if len(buffer) < header:
+        return None, 0
+    _, version, buckets, cycles_per_us = struct.unpack_from("<4sBBH", buffer)
+    if version not in VERSIONS:
+        return None, len(MAGIC)
+
+    offset = header
+    histograms = []
+    for _ in range(3):
+        end = offset + buckets * 4
+        if len(buffer) < end:
+            return None, 0
+        histograms.append(struct.unpack_from("<%dI" % buckets, buffer, offset))
+        offset = end
+
+    if len(buffer) < offset + 2:
+        return None, 0
+    (count,) = struct.unpack_from("<H", buffer, offset)
+    offset += 2
+    if len(buffer) < offset + count * 6 + 2:
+        return None, 0
+    slowest = [struct.unpack_from("<HI", buffer, offset + i * 6) for i in range(count)]
+    offset += count * 6
+
+    (checksum,) = struct.unpack_from("<H", buffer, offset)
+    if checksum != fletcher16(buffer[:offset]):
+        return None, len(MAGIC)
+
+    frame = {
+        "cycles_per_us": cycles_per_us,
+        "scan": histograms[0],
+        "lateness": histograms[1],
+        "report": histograms[2],
+        "slowest": slowest,
+    }
+    return frame, offset + 2
+
+
+def bucket_label(bucket, last):
+    if bucket == 0:
+        return "0"
+    low = 1 << (bucket - 1)
+    high = (1 << bucket) - 1
+    if bucket == last:
+        return ">=%d" % low
+    return "%d" % low if low == high else "%d-%d" % (low, high)
+
+
+def print_histogram(title, unit, counts):
+    total = sum(counts)
+    print("%s (%s), %d samples" % (title, unit, total))
+    if total == 0:
+        return
+    width = max(counts)
+    for bucket, count in enumerate(counts):
+        if count == 0:
+            continue
+        bar = "#" * max(1, count * 40 // width)
+        print("  %12s %10d %s" % (bucket_label(bucket, len(counts) - 1), count, bar))
+
+
+def print_frame(frame):
+    unit = "cycles, %d per us" % frame["cycles_per_us"] if frame["cycles_per_us"] > 1 else "us"
+    print_histogram("scan time", unit, frame["scan"])
+    print_histogram("macroDelay() lateness", "ms", frame["lateness"])
+    print_histogram("event to HID report", "us", frame["report"])
+    print("slowest macro per key (us)")
+    for index, us in sorted(frame["slowest"], key=lambda entry: -entry[1]):
+        print("  key %5d %10d" % (index, us))
+    print()
+
+
+def decode(chunks):
+    buffer = b""
+    for chunk in chunks:
+        buffer += chunk
+        while True:
+            start = buffer.find(MAGIC)
+            if start < 0:
+                buffer = buffer[-(len(MAGIC) - 1):]
+                break
+            buffer = buffer[start:]
+            frame, consumed = parse(buffer)
+            if consumed == 0:
+                break
+            buffer = buffer[consumed:]
+            if frame is not None:
+                print_frame(frame)
+
+
+def read_chunks(stream):
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            return
+        yield chunk
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "-"
+    if path == "-":
+        decode(read_chunks(sys.stdin.buffer))
+    elif path.startswith("/dev/") or path.upper().startswith("COM"):
+        import serial  # pyserial
+
+        with serial.Serial(path, 115200, timeout=1) as port:
+            try:
+                decode(iter(lambda: port.read(256), None))
+            except KeyboardInterrupt:
+                pass
+    else:
+        with open(path, "rb") as stream:
+            decode(read_chunks(stream))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,125 @@
+#ifndef MMZ_ACTION_H
+#define MMZ_ACTION_H
+
+#include <stdint.h>
+#include <array>
+
+#include "Key.h"
+
+// よく使う処理を16ビットで表したキーの割り当て constexprのキーマップとしてフラッシュに置ける
+// A key binding for the common actions packed into 16 bits: the type in bits 12-15 and its argument
+// in bits 0-11. Keymaps of actions can be declared constexpr, so they stay in flash and need no setup;
+// MacroPad runs them with a switch on the type. Action::macro(i) calls the i-th Macro of a separate
+// table for everything else.
+//     constexpr ActionProfiles<4, 2, 1> KEYMAP = {{ {{
+//         {{ Action::key('a'), Action::modTap(KEY_ESC, KEY_LEFT_CTRL), Action::macro(0), Action::layerHold(1) }},
+//         {{ Action::key('1'), Action::transparent(), Action::profileTo(0), Action::transparent() }},
+//     }} }};
+class Action {
+public:
+    enum class Type : uint8_t {
+        EMPTY,         // 0 .何もしない                   Does nothing (NONE)
+        THROUGH,       // 1 .下のレイヤーを使う            Falls through to the layer below (transparent())
+        KEY,           // 2 .押している間キーを押す        Holds the keycode while the key is held (pressTo())
+        MOD_TAP,       // 3 .タップでキー、ホールドで修飾キー Keycode on tap, modifier on hold (mod())
+        LAYER_TO,      // 4 .レイヤーを移動               layer.to()
+        LAYER_BACK,    // 5 .離したときにレイヤーを移動     layer.back()
+        LAYER_RESET,   // 6 .前のレイヤーに戻る            layer.reset()
+        LAYER_HOLD,    // 7 .押している間レイヤーを重ねる   layer.hold()
+        LAYER_TOGGLE,  // 8 .レイヤーを重ねる/外す         layer.toggle()
+        PROFILE_TO,    // 9 .プロファイルを移動           profile.to()
+        PROFILE_BACK,  // 10.離したときにプロファイルを移動 profile.back()
+        PROFILE_RESET, // 11.前のプロファイルに戻る        profile.reset()
+        MACRO,         // 12.マクロの表のi番目を呼び出す    Calls the i-th Macro of the macro table
+    };
+
+    constexpr Action() : word_(0) {}
+    // 16ビットの値から作る(ファイルから読み込む場合など) From a raw word, e.g. one read from a file.
+    explicit constexpr Action(const uint16_t word) : word_(word) {}
+
+    static constexpr Action none() { return Action(); }
+    static constexpr Action transparent() { return make(Type::THROUGH, 0); }
+    static constexpr Action key(const uint8_t code) { return make(Type::KEY, code); }
+    // holdはKEY_LEFT_CTRL~KEY_RIGHT_GUIのいずれか hold must be one of KEY_LEFT_CTRL to KEY_RIGHT_GUI.
+    static constexpr Action modTap(const uint8_t tap, const uint8_t hold) { return make(Type::MOD_TAP, tap | ((hold & 0x07) << 8)); }
+    static constexpr Action layerTo(const uint8_t layer) { return make(Type::LAYER_TO, layer); }
+    static constexpr Action layerBack(const uint8_t layer) { return make(Type::LAYER_BACK, layer); }
+    static constexpr Action layerReset() { return make(Type::LAYER_RESET, 0); }
+    static constexpr Action layerHold(const uint8_t layer) { return make(Type::LAYER_HOLD, layer); }
+    static constexpr Action layerToggle(const uint8_t layer) { return make(Type::LAYER_TOGGLE, layer); }
+    static constexpr Action profileTo(const uint8_t profile) { return make(Type::PROFILE_TO, profile); }
+    static constexpr Action profileBack(const uint8_t profile) { return make(Type::PROFILE_BACK, profile); }
+    static constexpr Action profileReset() { return make(Type::PROFILE_RESET, 0); }
+    // マクロの表のインデックス(0~4095) Index into the macro table (0-4095)
+    static constexpr Action macro(const uint16_t index) { return make(Type::MACRO, index); }
+
+    constexpr Type getType() const { return static_cast<Type>(word_ >> 12); }
+    constexpr uint16_t getArgument() const { return word_ & 0x0FFF; }
+    constexpr uint16_t getWord() const { return word_; }
+
+    // KEYとMOD_TAPのキーコード、MOD_TAPのホールドの修飾キー The keycode, and the modifier held by MOD_TAP
+    constexpr uint8_t getCode() const { return word_ & 0xFF; }
+    constexpr uint8_t getHoldCode() const { return 0x80 + ((word_ >> 8) & 0x07); }
+
+    constexpr bool isTransparent() const { return getType() == Type::THROUGH; }
+    constexpr bool isMacro() const { return getType() == Type::MACRO; }
+
+    // 実行に必要なイベント(MACROの場合はマクロのイベントを使う) Events the action runs on; MACRO uses those of its macro.
+    constexpr uint16_t getEvents() const {
+        switch (getType()) {
+            case Type::KEY:
+            case Type::LAYER_HOLD:
+                return Key::mask(Key::Event::RISING_EDGE, Key::Event::FALLING_EDGE);
+            case Type::MOD_TAP:
+                return Key::mask(Key::Event::TAP, Key::Event::HOLD, Key::Event::FALLING_EDGE);
+            case Type::LAYER_TO:
+            case Type::LAYER_RESET:
+            case Type::LAYER_TOGGLE:
+            case Type::PROFILE_TO:
+            case Type::PROFILE_RESET:
+                return Key::mask(Key::Event::RISING_EDGE);
+            case Type::LAYER_BACK:
+            case Type::PROFILE_BACK:
+                return Key::mask(Key::Event::FALLING_EDGE);
+            default:
+                return 0;
+        }
+    }
+
+    constexpr bool operator==(const Action& other) const { return word_ == other.word_; }
+    constexpr bool operator!=(const Action& other) const { return word_ != other.word_; }
+
+private:
+    static constexpr Action make(const Type type, const uint16_t argument) {
+        return Action(static_cast<uint16_t>((static_cast<uint16_t>(type) << 12) | (argument & 0x0FFF)));
+    }
+
+    uint16_t word_;
+};
+
+static_assert(sizeof(Action) == 2, "An action must be one 16-bit word.");
+
+template<uint16_t NUM_OF_KEYS>
+using ActionKeymap = std::array<Action, NUM_OF_KEYS>;
+template<uint16_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS>
+using ActionLayers = std::array<ActionKeymap<NUM_OF_KEYS>, NUM_OF_LAYERS>;
+template<uint16_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS, uint8_t NUM_OF_PROFILES>
+using ActionProfiles = std::array<ActionLayers<NUM_OF_KEYS, NUM_OF_LAYERS>, NUM_OF_PROFILES>;
+
+// プロファイルごとのActionのキーマップを提供する(Profile::attach()に渡す)
+// Provides the actions of one profile at a time to Profile::attach(), e.g. the loaders of
+// KeymapLoader.h. Profile::set() calls load(), so a source can page the selected profile in and keep
+// only that one in RAM.
+template<uint16_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS>
+class ActionSource {
+public:
+    // profileのNUM_OF_LAYERS * NUM_OF_KEYS個のAction 読み込めない場合はnullptr 次のload()まで有効
+    // Returns the NUM_OF_LAYERS * NUM_OF_KEYS actions of the profile, layer by layer, or nullptr if
+    // it cannot be loaded. The actions stay valid until the next successful load().
+    virtual const Action* load(uint8_t profile) = 0;
+    virtual uint8_t getNumOfProfiles() const = 0;
+
+    virtual ~ActionSource() = default;
+};
+
+#endif
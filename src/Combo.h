@@ -0,0 +1,414 @@
+#ifndef MMZ_COMBO_H
+#define MMZ_COMBO_H
+
+#include <Arduino.h>
+#include <initializer_list>
+
+#include "KeyReader/KeyReader.h"
+#include "Key.h"
+
+// 登録できるコンボの最大数 0の場合はコンボを使わず、MacroPadにコンボの領域を確保しない
+// Maximum number of combos that can be registered. With 0 (the default) combos are disabled and
+// a MacroPad carries no combo state at all.
+#ifndef MMZ_MAX_COMBOS
+#define MMZ_MAX_COMBOS 0
+#endif
+
+// 一つのコンボに含められるキーの最大数
+// Maximum number of keys in one combo.
+#ifndef MMZ_COMBO_MAX_KEYS
+#define MMZ_COMBO_MAX_KEYS 8
+#endif
+
+// コンボのキーをすべて押すまでの既定の猶予時間(ms) この間キー入力は保留される
+// Default time in ms to press every key of a combo; key events are held back for at most this long.
+#ifndef MMZ_COMBO_TIMEOUT
+#define MMZ_COMBO_TIMEOUT 50
+#endif
+
+// キー入力を保留した時間などの統計 Statistics about held-back key events
+struct ComboStats {
+    uint32_t fired;       //成立したコンボの数 Number of combos that completed
+    uint32_t replayed;    //不成立で再生したキー入力の数 Number of held presses replayed
+    uint32_t lastLatency; //直前に保留した時間(us) How long the last window held keys back, in us
+    uint32_t maxLatency;  //保留した時間の最大値(us) Longest time keys were held back, in us
+};
+
+// 同時押しされたキーの組み合わせを一つの仮想キーとして扱う
+// Treats a set of keys pressed together as one virtual key.
+//
+// The manager sits between the reader and the engine. A press of a key that belongs to a combo is
+// held back while the keys pressed so far can still complete a combo. Candidates are tracked as a
+// bitset of combos (AND of the per-key membership words), and a combo matches when its key mask
+// equals the held mask, so the cost per press depends on the number of 32-combo words, not on the
+// number of combos or keys. If no combo completes, the held presses are replayed to the engine in
+// the order they happened, one per scan. The keys of a completed combo are hidden from the engine
+// until they are released, and the combo's macro is driven by its own Key, which stays pressed
+// while every key of the combo is held.
+//
+// TIMING is the timing source of the engine (TimingTable or FixedTiming).
+template<uint16_t NUM_OF_KEYS, typename TIMING = TimingTable, uint16_t MAX_COMBOS = MMZ_MAX_COMBOS>
+class ComboManager {
+public:
+    static constexpr uint16_t KEYBOARD_SIZE = ReaderData::calcKeyboardSize<NUM_OF_KEYS>();
+    static constexpr uint8_t MAX_KEYS = MMZ_COMBO_MAX_KEYS;
+    static_assert((MAX_KEYS >= 2), "'MMZ_COMBO_MAX_KEYS' must be 2 or greater.");
+
+    using Words = ReaderData::Word[KEYBOARD_SIZE];
+    using Stats = ComboStats;
+
+    ComboManager()
+     : combos_{}, membership_{}, previous_{}, held_{}, queued_{}, consumed_{}, replayed_{}, active_{}, candidates_{}, output_{}, stats_{},
+       count_(0), heldCount_(0), queueHead_(0), queueSize_(0), match_(INVALID), windowStart_(0), firedAt_(0), replayedAt_(0) {}
+
+    // keysをすべて同時に押したときにmacroを実行する 登録できない場合はfalseを返す
+    // Runs the macro when every key in keys is pressed within timeout ms. Returns false when the
+    // combo cannot be registered (full, fewer than 2 or more than MMZ_COMBO_MAX_KEYS keys, invalid index).
+    bool add(std::initializer_list<uint16_t> keys, Macro macro, const uint16_t timeout = MMZ_COMBO_TIMEOUT) {
+        if ((count_ >= MAX_COMBOS) || (keys.size() < 2) || (keys.size() > MAX_KEYS) || !macro) { return false; }
+
+        Combo& combo = combos_[count_];
+        uint8_t size = 0;
+        for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) { combo.keys[word] = 0; }
+        for (const uint16_t index : keys) {
+            if (index >= NUM_OF_KEYS) { return false; }
+            combo.keys[ReaderData::getIndex(index)] |= bitOf(index);
+        }
+        for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) { size += ReaderData::countBits(combo.keys[word]); }
+        if (size < 2) { return false; }
+
+        combo.macro = std::move(macro);
+        combo.timeout = timeout;
+        combo.latched = false;
+        combo.key.setIndex(NUM_OF_KEYS + count_);
+
+        for (const uint16_t index : keys) { membership_[index][count_ / 32] |= (1UL << (count_ % 32)); }
+        count_++;
+        return true;
+    }
+
+    uint16_t getNumOfCombos() const { return count_; }
+
+    // コンボの仮想キー(インデックスはNUM_OF_KEYS + 登録順) The virtual key of a combo, indexed NUM_OF_KEYS + n
+    const Key& getKey(const uint16_t combo) const { return combos_[combo].key; }
+    const Macro& getMacro(const uint16_t combo) const { return combos_[combo].macro; }
+
+    // 保留中のキー、再生待ちのキー、判定中のコンボがないかを返す(ないときはスキャンを止めてよい)
+    // Returns whether no key is held back or waiting for replay and no combo key is still updating,
+    // i.e. whether filter() would pass the input through unchanged until the input changes.
+    bool isIdle(const uint32_t now) const {
+        if (count_ == 0) { return true; }
+        if ((heldCount_ > 0) || (queueSize_ > 0)) { return false; }
+        if ((now - firedAt_) < toMicros(TIMING::getMaxDebounce())) { return false; }
+
+        for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) {
+            if (replayed_[word] != 0) { return false; }
+        }
+        for (uint16_t i = 0; i < COMBO_WORDS; i++) {
+            if (active_[i] != 0) { return false; }
+        }
+        return true;
+    }
+
+    const Stats& getStats() const { return stats_; }
+    void resetStats() { stats_ = {}; }
+
+    // 読み取った入力から、保留中や消費済みのキーを除いた入力を返す(nowはmicros())
+    // Returns the input the engine should see: held, queued and consumed keys are masked out,
+    // and at most one queued press is replayed per call. sink(const Key& key, uint32_t now) is called
+    // with the virtual key of every combo that has a subscribed event.
+    template<typename SINK>
+    const Words& filter(const Words& input, const uint32_t now, SINK&& sink) {
+        if (count_ == 0) { return input; }
+
+        //成立直後のチャタリングでは解除しない Bounces right after a combo completes do not release its keys.
+        if ((now - firedAt_) >= toMicros(TIMING::getMaxDebounce())) {
+            for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) { consumed_[word] &= input[word]; }
+        }
+
+        const uint16_t replay = dequeue();
+
+        for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) {
+            ReaderData::Word edges = input[word] & ~previous_[word];
+            while (edges != 0) {
+                const uint8_t digit = ReaderData::lowestBit(edges);
+                edges &= ~ReaderData::bit(digit);
+                press(word * ReaderData::READ_BITS + digit, now);
+            }
+        }
+
+        if (heldCount_ > 0) { checkReleases(input, now); }
+        if (heldCount_ > 0) { expire(now); }
+
+        updateCombos(input, now, sink);
+
+        for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) {
+            output_[word] = input[word] & ~(held_[word] | queued_[word] | consumed_[word]);
+            previous_[word] = input[word];
+        }
+
+        //再生したキーは離されていてもデバウンス時間の間は押された状態で渡す
+        //A replayed press is reported for the debounce time even if the key was already released,
+        //so that the key registers both the press and the release.
+        if (replay != INVALID) {
+            replayed_[ReaderData::getIndex(replay)] |= bitOf(replay);
+            replayedAt_ = now;
+        } else if ((now - replayedAt_) >= toMicros(TIMING::getMaxDebounce())) {
+            for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) { replayed_[word] = 0; }
+        }
+        for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) { output_[word] |= replayed_[word]; }
+
+        return output_;
+    }
+
+private:
+    static constexpr uint16_t INVALID = UINT16_MAX;
+    static constexpr uint16_t COMBO_WORDS = (MAX_COMBOS + 31) / 32;
+    static constexpr uint8_t QUEUE_SIZE = MAX_KEYS * 2;
+
+    struct Combo {
+        ReaderData::Word keys[KEYBOARD_SIZE];
+        Macro macro;
+        Key key;
+        uint16_t timeout;
+        bool latched; //すべてのキーが押されている間true True while every key of the combo stays pressed
+    };
+
+    struct Held {
+        uint16_t index;
+        uint32_t time;
+    };
+
+    static constexpr uint32_t toMicros(const uint16_t ms) { return ms * 1000UL; }
+
+    static inline ReaderData::Word bitOf(const uint16_t index) { return ReaderData::bit(ReaderData::getDigit(index)); }
+
+    void press(const uint16_t index, const uint32_t now) {
+        const uint16_t word = ReaderData::getIndex(index);
+        if ((held_[word] | queued_[word] | consumed_[word]) & bitOf(index)) { return; } //チャタリング Bounce
+
+        //再生待ちのキーがあれば順序を保つため後ろに並べる Keep the order behind presses waiting for replay.
+        if (queueSize_ > 0) {
+            enqueue(index);
+            return;
+        }
+
+        if (heldCount_ == 0) {
+            if (!isMember(index)) { return; }
+
+            windowStart_ = now;
+            for (uint16_t i = 0; i < COMBO_WORDS; i++) { candidates_[i] = membership_[index][i]; }
+        } else {
+            uint32_t remaining = 0;
+            for (uint16_t i = 0; i < COMBO_WORDS; i++) { remaining |= candidates_[i] & membership_[index][i]; }
+
+            //これまでの判定を確定し、押されたキーを改めて処理する Settle the window, then handle the press afresh.
+            if ((remaining == 0) || (heldCount_ >= MAX_KEYS)) {
+                resolve(now);
+                press(index, now);
+                return;
+            }
+            for (uint16_t i = 0; i < COMBO_WORDS; i++) { candidates_[i] &= membership_[index][i]; }
+            match_ = INVALID; //より大きなコンボを優先する A larger combo takes precedence over a smaller match.
+        }
+
+        held_[word] |= bitOf(index);
+        order_[heldCount_++] = { index, now };
+        match(now);
+    }
+
+    // 保留中のキーとキーの組み合わせが一致するコンボを探す 他に候補がなければすぐに成立させる
+    // Looks for a candidate whose keys equal the held keys; it completes at once unless a larger combo is still possible.
+    void match(const uint32_t now) {
+        uint16_t remaining = 0;
+        for (uint16_t i = 0; i < COMBO_WORDS; i++) {
+            uint32_t bits = candidates_[i];
+            while (bits != 0) {
+                const uint8_t digit = __builtin_ctz(bits);
+                bits &= ~(1UL << digit);
+                remaining++;
+
+                const uint16_t combo = i * 32 + digit;
+                if (equals(combos_[combo].keys, held_)) { match_ = combo; }
+            }
+        }
+
+        if ((match_ != INVALID) && (remaining == 1)) { fire(now); }
+    }
+
+    // 保留中のキーが(チャタリングでなく)離されたら確定する Resolves when a held key is really released.
+    void checkReleases(const Words& input, const uint32_t now) {
+        for (uint8_t i = 0; i < heldCount_; i++) {
+            const uint16_t index = order_[i].index;
+            if (input[ReaderData::getIndex(index)] & bitOf(index)) { continue; }
+            if ((now - order_[i].time) < toMicros(TIMING::getMaxDebounce())) { continue; }
+
+            resolve(now);
+            return;
+        }
+    }
+
+    // 猶予時間を過ぎたコンボを候補から外す Drops candidates whose timeout has elapsed.
+    void expire(const uint32_t now) {
+        const uint32_t elapsed = now - windowStart_;
+        bool pending = false;
+
+        for (uint16_t i = 0; i < COMBO_WORDS; i++) {
+            uint32_t bits = candidates_[i];
+            while (bits != 0) {
+                const uint8_t digit = __builtin_ctz(bits);
+                bits &= ~(1UL << digit);
+
+                const uint16_t combo = i * 32 + digit;
+                if (combo == match_) { continue; }
+                if (elapsed >= toMicros(combos_[combo].timeout)) { candidates_[i] &= ~(1UL << digit); }
+                else { pending = true; }
+            }
+        }
+
+        if (!pending) { resolve(now); }
+    }
+
+    void resolve(const uint32_t now) {
+        if (match_ != INVALID) {
+            fire(now);
+            return;
+        }
+
+        for (uint8_t i = 0; i < heldCount_; i++) { enqueue(order_[i].index); }
+        closeWindow(now);
+    }
+
+    void fire(const uint32_t now) {
+        Combo& combo = combos_[match_];
+        combo.latched = true;
+        active_[match_ / 32] |= (1UL << (match_ % 32));
+
+        for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) { consumed_[word] |= held_[word]; }
+        firedAt_ = now;
+        stats_.fired++;
+        closeWindow(now);
+    }
+
+    void closeWindow(const uint32_t now) {
+        stats_.lastLatency = now - windowStart_;
+        if (stats_.lastLatency > stats_.maxLatency) { stats_.maxLatency = stats_.lastLatency; }
+
+        for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) { held_[word] = 0; }
+        for (uint16_t i = 0; i < COMBO_WORDS; i++) { candidates_[i] = 0; }
+        heldCount_ = 0;
+        match_ = INVALID;
+    }
+
+    // 成立したコンボの仮想キーを更新し、マクロを実行する Drives the virtual keys of completed combos.
+    template<typename SINK>
+    void updateCombos(const Words& input, const uint32_t now, SINK& sink) {
+        for (uint16_t i = 0; i < COMBO_WORDS; i++) {
+            uint32_t bits = active_[i];
+            while (bits != 0) {
+                const uint8_t digit = __builtin_ctz(bits);
+                bits &= ~(1UL << digit);
+
+                Combo& combo = combos_[i * 32 + digit];
+                if (combo.latched && !contains(input, combo.keys) && ((now - firedAt_) >= toMicros(TIMING::getMaxDebounce()))) {
+                    combo.latched = false;
+                }
+
+                if (combo.key.template update<TIMING>(combo.latched, now) & combo.macro.getEvents()) { sink(combo.key, now); }
+
+                if (!combo.latched && combo.key.template isSettled<TIMING>(now)) { active_[i] &= ~(1UL << digit); }
+            }
+        }
+    }
+
+    void enqueue(const uint16_t index) {
+        //あふれた場合はそのまま通す If the queue is full the press passes through unordered.
+        if (queueSize_ >= QUEUE_SIZE) { return; }
+
+        queue_[(queueHead_ + queueSize_) % QUEUE_SIZE] = index;
+        queueSize_++;
+        queued_[ReaderData::getIndex(index)] |= bitOf(index);
+    }
+
+    uint16_t dequeue() {
+        if (queueSize_ == 0) { return INVALID; }
+
+        const uint16_t index = queue_[queueHead_];
+        queueHead_ = (queueHead_ + 1) % QUEUE_SIZE;
+        queueSize_--;
+        queued_[ReaderData::getIndex(index)] &= ~bitOf(index);
+        stats_.replayed++;
+        return index;
+    }
+
+    bool isMember(const uint16_t index) const {
+        for (uint16_t i = 0; i < COMBO_WORDS; i++) {
+            if (membership_[index][i] != 0) { return true; }
+        }
+        return false;
+    }
+
+    static bool equals(const Words& a, const Words& b) {
+        for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) {
+            if (a[word] != b[word]) { return false; }
+        }
+        return true;
+    }
+    static bool contains(const Words& input, const Words& keys) {
+        for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) {
+            if ((input[word] & keys[word]) != keys[word]) { return false; }
+        }
+        return true;
+    }
+
+    Combo combos_[MAX_COMBOS];
+    uint32_t membership_[NUM_OF_KEYS][COMBO_WORDS]; //キーごとの所属するコンボ Combos each key belongs to
+    ReaderData::Word previous_[KEYBOARD_SIZE];
+    ReaderData::Word held_[KEYBOARD_SIZE];     //コンボの判定のため保留中のキー Keys held back while a combo may complete
+    ReaderData::Word queued_[KEYBOARD_SIZE];   //再生待ちのキー Keys waiting for replay
+    ReaderData::Word consumed_[KEYBOARD_SIZE]; //成立したコンボのキー(離されるまで隠す) Keys of completed combos, hidden until released
+    ReaderData::Word replayed_[KEYBOARD_SIZE]; //再生した直後のキー Keys replayed within the debounce time
+    uint32_t active_[COMBO_WORDS];             //仮想キーを更新するコンボ Combos whose virtual key is still updating
+    uint32_t candidates_[COMBO_WORDS];         //保留中のキーをすべて含むコンボ Combos containing every held key
+    ReaderData::Word output_[KEYBOARD_SIZE];
+    Held order_[MAX_KEYS];                     //保留中のキー(押された順) Held keys in press order
+    uint16_t queue_[QUEUE_SIZE];
+    Stats stats_;
+    uint16_t count_;
+    uint8_t heldCount_, queueHead_, queueSize_;
+    uint16_t match_;
+    uint32_t windowStart_;
+    uint32_t firedAt_;    //直前にコンボが成立した時刻 When the last combo completed
+    uint32_t replayedAt_; //直前にキーを再生した時刻 When the last held press was replayed
+};
+
+// コンボを使わない場合(MMZ_MAX_COMBOSが0) 入力をそのまま通し、状態を持たない
+// Combos disabled (MMZ_MAX_COMBOS is 0): the input passes through and nothing is stored.
+template<uint16_t NUM_OF_KEYS, typename TIMING>
+class ComboManager<NUM_OF_KEYS, TIMING, 0> {
+public:
+    using Words = ReaderData::Word[ReaderData::calcKeyboardSize<NUM_OF_KEYS>()];
+    using Stats = ComboStats;
+
+    template<typename T = void>
+    bool add(std::initializer_list<uint16_t>, Macro, const uint16_t = MMZ_COMBO_TIMEOUT) {
+        static_assert(sizeof(T) == 0, "Combos are disabled. #define MMZ_MAX_COMBOS before including the library.");
+        return false;
+    }
+
+    uint16_t getNumOfCombos() const { return 0; }
+    const Macro& getMacro(const uint16_t) const { return EMPTY; }
+
+    bool isIdle(const uint32_t) const { return true; }
+
+    Stats getStats() const { return {}; }
+    void resetStats() {}
+
+    template<typename SINK>
+    const Words& filter(const Words& input, const uint32_t, SINK&&) { return input; }
+
+private:
+    inline static const Macro EMPTY = nullptr;
+};
+
+#endif
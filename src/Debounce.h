@@ -0,0 +1,57 @@
+#ifndef MMZ_DEBOUNCE_H
+#define MMZ_DEBOUNCE_H
+
+#include <stdint.h>
+
+#include "Timing.h"
+
+// チャタリングを除去した入力レベルを求める方法 エンジンのテンプレート引数で選ぶ
+// Debounce policies turn the raw input of a key into the debounced level. They are chosen with the
+// DEBOUNCE template parameter of the engine, and every policy has the same static function:
+//     static bool filter(bool raw, bool level, uint32_t sinceEdge, uint32_t stableFor, const Timing& timing);
+//         raw:       the input read in this scan
+//         level:     the debounced level so far
+//         sinceEdge: us since the debounced level last changed
+//         stableFor: us since the raw input last changed, in steps of 1024 us and modulo about 262 ms
+//     and returns the new debounced level.
+// MS overrides the debounce time of the timing profile when it is not 0.
+
+// stableForで測れる最大の時間(ms) DeferredDebounceの時間はこれで頭打ちになる
+// Longest time in ms stableFor can measure (255 ticks of 1024 us); DeferredDebounce caps its window here.
+constexpr uint16_t MAX_DEFERRED_DEBOUNCE = 255;
+
+// 最初の変化ですぐに反応し、その後一定時間は入力を無視する(遅延なし)
+// Reports the first edge at once, then ignores the input for the debounce time. Adds no latency.
+template<uint16_t MS = 0>
+struct EagerDebounce {
+    static inline bool filter(const bool raw, const bool level, const uint32_t sinceEdge, const uint32_t /*stableFor*/, const Timing& timing) {
+        return (sinceEdge >= ((MS != 0) ? MS : timing.debounceTime) * 1000UL) ? raw : level;
+    }
+};
+
+// 入力が一定時間変化しなかったときに反応する(デバウンス時間分遅れるが、ノイズに強い)
+// Reports a change once the input has been stable for the debounce time. Adds that much latency but
+// also rejects short noise pulses. The window is at most MAX_DEFERRED_DEBOUNCE ms; a longer
+// debounceTime in the timing profile is capped to it.
+template<uint16_t MS = 0>
+struct DeferredDebounce {
+    static_assert(MS <= MAX_DEFERRED_DEBOUNCE, "DeferredDebounce measures at most MAX_DEFERRED_DEBOUNCE (255) ms.");
+
+    static inline bool filter(const bool raw, const bool level, const uint32_t /*sinceEdge*/, const uint32_t stableFor, const Timing& timing) {
+        const uint16_t time = (MS != 0) ? MS : timing.debounceTime;
+        return ((raw != level) && (stableFor >= ((time < MAX_DEFERRED_DEBOUNCE) ? time : MAX_DEFERRED_DEBOUNCE) * 1000UL)) ? raw : level;
+    }
+};
+
+// 押したときと離したときで別の方法を使う 例: AsymmetricDebounce<EagerDebounce<>, DeferredDebounce<10>>
+// Uses one policy for presses and another for releases,
+// e.g. AsymmetricDebounce<EagerDebounce<>, DeferredDebounce<10>> reports presses at once and filters release noise.
+template<typename PRESS, typename RELEASE>
+struct AsymmetricDebounce {
+    static inline bool filter(const bool raw, const bool level, const uint32_t sinceEdge, const uint32_t stableFor, const Timing& timing) {
+        return (level) ? RELEASE::filter(raw, level, sinceEdge, stableFor, timing)
+                       : PRESS::filter(raw, level, sinceEdge, stableFor, timing);
+    }
+};
+
+#endif
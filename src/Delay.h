@@ -3,59 +3,293 @@
 
 #include <Arduino.h>
 #include <functional>
-#include <vector>
+#include <new>
 
-using CallbackFunc = std::function<void()>;
+#include "InplaceFunction.h"
+#include "Key.h"
+#include "Stats.h"
+
+// 同時に待機できるコールバックの最大数
+// Maximum number of callbacks that can be pending at the same time.
+#ifndef MMZ_MACRO_DELAY_CAPACITY
+#define MMZ_MACRO_DELAY_CAPACITY 32
+#endif
+
+// コールバックが動的メモリ確保なしで保持できる関数オブジェクトの大きさ(バイト) After{}がキャプチャするkeyを含む
+// Size in bytes of the callables kept without allocating, large enough for the key captured by After{}.
+#ifndef MMZ_DELAY_STORAGE_SIZE
+#define MMZ_DELAY_STORAGE_SIZE (sizeof(Key) + 2 * sizeof(void*))
+#endif
+
+using CallbackFunc = InplaceFunction<void(), MMZ_DELAY_STORAGE_SIZE>;
 
 #define After [key]()
 
+// 待機中のコールバックを指す Identifies a pending callback, e.g. to cancel it.
+struct DelayHandle {
+    static constexpr uint16_t INVALID = UINT16_MAX;
+
+    uint16_t slot = INVALID;
+    uint16_t generation = 0;
+
+    bool isValid() const { return slot != INVALID; }
+};
+
+// 事前に確保したスロットと、実行時刻の最小ヒープで遅延実行を管理する
+// Delayed callbacks live in a fixed pool of slots ordered by a binary min-heap on their execution time,
+// so invoke() only looks at the earliest one. Times are compared with wrap-safe arithmetic,
+// so millis() overflowing after about 49 days is handled as long as each wait is below about 24 days.
 class MacroDelay {
 public:
+    static constexpr uint16_t CAPACITY = MMZ_MACRO_DELAY_CAPACITY;
+    static_assert((CAPACITY > 0) && (CAPACITY < DelayHandle::INVALID), "'MMZ_MACRO_DELAY_CAPACITY' must be between 1 and 65534.");
+
     // Callback function is called after specified time.
-    static void delay(uint32_t ms, CallbackFunc func) {
-        callbacks_.push_back(LazyCallback(ms, func));
+    // 空きがない場合は無効なハンドルを返す Returns an invalid handle when every slot is in use.
+    template<typename F>
+    static DelayHandle delay(uint32_t ms, F func) { return schedule(ms, 0, wrap(std::move(func))); }
+
+    // Callback function is called repeatedly at the specified interval until it is cancelled.
+    template<typename F>
+    static DelayHandle repeat(uint32_t intervalMs, F func) {
+        if (intervalMs == 0) { intervalMs = 1; }
+        return schedule(intervalMs, intervalMs, wrap(std::move(func)));
     }
 
-    static inline void invoke() {
-        uint32_t now = millis();
+    // 待機中のコールバックを取り消す(実行中の繰り返しコールバックの場合は次回以降を取り消す)
+    // Cancels a pending callback. A repeating callback may cancel itself from inside its own call.
+    static bool cancel(DelayHandle& handle) {
+        if (!isPending(handle)) { return false; }
+
+        Slot& slot = slots()[handle.slot];
+        handle = DelayHandle();
+
+        if (slot.state == State::RUNNING) {
+            slot.state = State::CANCELLED;
+            return true;
+        }
 
-        //Limit execution to only once per millisecond, as it is called from the update() method of all instances.
-        if ((now - lastInvokedTime_) == 0) { return; }
-        lastInvokedTime_ = now;
+        removeAt(slot.position);
+        release(&slot - slots());
+        return true;
+    }
+
+    static bool isPending(const DelayHandle& handle) {
+        if (handle.slot >= unused_) { return false; }
+        const Slot& slot = slots()[handle.slot];
+        return (slot.generation == handle.generation) && (slot.state == State::PENDING || slot.state == State::RUNNING);
+    }
 
-        uint8_t size = callbacks_.size();
+    static uint16_t getNumOfPending() { return size_; }
+    // 空きがなく予約できなかったコールバックの数 Callbacks that could not be scheduled because every slot was in use
+    static uint32_t getDroppedCount() { return dropped_; }
 
-        for (uint8_t i = 0; i < size; i++) {
-            if (callbacks_[i].executeTime > now) { continue; }
+    // 次のコールバックを実行するまでの時間(ms) 待機中のものがなければUINT32_MAX
+    // Time in ms until the earliest callback is due, 0 if it is overdue, UINT32_MAX if nothing is pending.
+    static uint32_t getTimeUntilNext() {
+        if (size_ == 0) { return UINT32_MAX; }
 
-            callbacks_[i].func();
-            callbacks_.erase(callbacks_.begin() + i);
+        const int32_t remaining = static_cast<int32_t>(earliest_ - millis());
+        return (remaining > 0) ? remaining : 0;
+    }
 
-            //The 'i' and 'size' are set to -1 because the element is packed by one.
-            if (i != 0) { i--; }
-            size--;
+    // 待機中のコールバックを実行せずにすべて取り消し、起動時の状態に戻す(PC上のテストなど)
+    // Drops every pending callback without running it and returns to the start-up state, e.g. between
+    // tests in one process. Handles given out before stay invalid. Must not be called from a callback.
+    static void reset() {
+        //番号順に空きリストへ戻し、起動時と同じ順に使われるようにする The slots are reused in the same order as after start-up.
+        freeHead_ = DelayHandle::INVALID;
+        for (uint16_t i = unused_; i > 0; i--) {
+            Slot& slot = slots()[i - 1];
+            if (slot.state != State::FREE) {
+                slot.func = nullptr;
+                slot.state = State::FREE;
+                slot.generation++;
+            }
+            slot.position = freeHead_;
+            freeHead_ = i - 1;
         }
+        size_ = 0;
+        earliest_ = 0;
+        dropped_ = 0;
+    }
+
+    // 期限の来たコールバックを実行する 何も予約されていない場合はスロットに触れない
+    // Runs the due callbacks. Only the earliest time is checked here; the slots are reached through
+    // a pointer set by the first delay(), so a sketch that never delays does not link them.
+    static inline void invoke() {
+        const uint32_t now = millis();
+        if ((size_ > 0) && isDue(earliest_, now)) { run_(now); }
     }
 
 private:
     MacroDelay() {}
 
-    struct LazyCallback {
-    public:
-        LazyCallback(uint32_t waitMs, CallbackFunc f) : func(f), executeTime(millis() + waitMs) {}
+    enum class State : uint8_t { FREE, PENDING, RUNNING, CANCELLED };
+
+    struct Slot {
+        constexpr Slot() : func(), executeTime(0), interval(0), generation(0), position(0), state(State::FREE) {}
 
         CallbackFunc func;
         uint32_t executeTime; // Time to execute.
+        uint32_t interval;    // 0 for one-shot callbacks.
+        uint16_t generation;
+        uint16_t position;    // ヒープ内の位置、空きスロットの場合は次の空きスロット Heap position, or the next free slot.
+        State state;
     };
 
-    static std::vector<LazyCallback> callbacks_;
-    static uint32_t lastInvokedTime_;
-};
+    static void run(const uint32_t now) {
+        while ((size_ > 0) && isDue(slots()[heap_[0]].executeTime, now)) {
+            const uint16_t index = heap_[0];
+            removeAt(0);
+
+            Slot& slot = slots()[index];
+            Stats::recordLateness(now - slot.executeTime);
+            slot.state = State::RUNNING;
+            slot.func();
 
+            if ((slot.interval == 0) || (slot.state == State::CANCELLED)) {
+                release(index);
+                continue;
+            }
 
-std::vector<typename MacroDelay::LazyCallback> MacroDelay::callbacks_;
-uint32_t MacroDelay::lastInvokedTime_ = 0;
+            //呼び出しが遅れた場合でも、まとめて実行せずに次の周期から再開する
+            //If the call was late, skip the missed periods instead of firing them in a burst.
+            slot.executeTime += slot.interval;
+            if (isDue(slot.executeTime, now)) { slot.executeTime = now + slot.interval; }
+
+            slot.state = State::PENDING;
+            push(index);
+        }
+    }
+
+    // 収まらない関数はMMZ_MACRO_ALLOW_HEAPが1の場合のみstd::functionを介して保持する(Macroと同じ)
+    // Callables that do not fit are a compile error unless MMZ_MACRO_ALLOW_HEAP is 1, in which case
+    // they are kept through std::function, as for Macro.
+    template<typename F>
+    static CallbackFunc wrap(F func) {
+        if constexpr (CallbackFunc::fits<F>()) {
+            return CallbackFunc(std::move(func));
+        } else {
+            static_assert(MMZ_MACRO_ALLOW_HEAP || (sizeof(F) == 0),
+                          "The callback does not fit in MMZ_DELAY_STORAGE_SIZE. Capture less (e.g. a pointer), raise MMZ_DELAY_STORAGE_SIZE, or define MMZ_MACRO_ALLOW_HEAP 1.");
+            std::function<void()> fallback(std::move(func));
+            if (!fallback) { return nullptr; }
+            return CallbackFunc([fallback]() { fallback(); });
+        }
+    }
+
+    static DelayHandle schedule(const uint32_t ms, const uint32_t interval, CallbackFunc&& func) {
+        if (!func) { return DelayHandle(); }
+
+        uint16_t index;
+        if (freeHead_ != DelayHandle::INVALID) {
+            index = freeHead_;
+            freeHead_ = slots()[index].position;
+        } else if (unused_ < CAPACITY) {
+            index = unused_++;
+            new (&storage_[index * sizeof(Slot)]) Slot();
+        } else {
+            dropped_++;
+            return DelayHandle();
+        }
+        run_ = &run;
+
+        Slot& slot = slots()[index];
+        slot.func = std::move(func);
+        slot.executeTime = millis() + ms;
+        slot.interval = interval;
+        slot.state = State::PENDING;
+        push(index);
+
+        DelayHandle handle;
+        handle.slot = index;
+        handle.generation = slot.generation;
+        return handle;
+    }
+
+    static void release(const uint16_t index) {
+        Slot& slot = slots()[index];
+        slot.func = nullptr;
+        slot.state = State::FREE;
+        slot.generation++;
+        slot.position = freeHead_;
+        freeHead_ = index;
+    }
+
+    static inline bool isDue(const uint32_t executeTime, const uint32_t now) {
+        return static_cast<int32_t>(now - executeTime) >= 0;
+    }
+    static inline bool isEarlier(const uint16_t a, const uint16_t b) {
+        return static_cast<int32_t>(slots()[a].executeTime - slots()[b].executeTime) < 0;
+    }
+
+    static inline void place(const uint16_t position, const uint16_t index) {
+        heap_[position] = index;
+        slots()[index].position = position;
+    }
+
+    static void push(const uint16_t index) {
+        place(size_, index);
+        siftUp(size_++);
+        earliest_ = slots()[heap_[0]].executeTime;
+    }
+
+    static void removeAt(const uint16_t position) {
+        size_--;
+        if (position != size_) {
+            const uint16_t moved = heap_[size_];
+            place(position, moved);
+            siftUp(position);
+            siftDown(slots()[moved].position);
+        }
+        if (size_ > 0) { earliest_ = slots()[heap_[0]].executeTime; }
+    }
+
+    static void siftUp(uint16_t position) {
+        const uint16_t index = heap_[position];
+
+        while (position > 0) {
+            const uint16_t parent = (position - 1) / 2;
+            if (!isEarlier(index, heap_[parent])) { break; }
+            place(position, heap_[parent]);
+            position = parent;
+        }
+        place(position, index);
+    }
+
+    static void siftDown(uint16_t position) {
+        const uint16_t index = heap_[position];
+
+        while (true) {
+            uint32_t child = position * 2UL + 1;
+            if (child >= size_) { break; }
+            if ((child + 1 < size_) && isEarlier(heap_[child + 1], heap_[child])) { child++; }
+            if (!isEarlier(heap_[child], index)) { break; }
+            place(position, heap_[child]);
+            position = child;
+        }
+        place(position, index);
+    }
+
+    // inline so that the header can be included from more than one translation unit.
+    // スロットは最初に使うときに構築する(Slotの配列にすると、デストラクタの登録のため使わなくてもリンクされる)
+    // Slots are constructed in this storage when first used. A static array of Slot would be linked
+    // into every sketch, used or not, to register its destructor.
+    static inline Slot* slots() { return std::launder(reinterpret_cast<Slot*>(storage_)); }
+    alignas(Slot) inline static uint8_t storage_[sizeof(Slot) * CAPACITY] = {};
+    inline static uint16_t heap_[CAPACITY] = {};
+    inline static uint16_t size_ = 0;
+    inline static uint16_t unused_ = 0;                      //一度も使われていないスロットの先頭 First never-used slot
+    inline static uint16_t freeHead_ = DelayHandle::INVALID; //解放されたスロットのリスト List of released slots
+    inline static uint32_t earliest_ = 0;                    //最も早い実行時刻 Execution time at the top of the heap
+    inline static uint32_t dropped_ = 0;
+    inline static void (*run_)(uint32_t) = nullptr;          //最初のdelay()で設定する Set by the first delay()
+};
 
-inline void macroDelay(uint32_t ms, CallbackFunc func) { MacroDelay::delay(ms, func); }
+template<typename F>
+inline DelayHandle macroDelay(uint32_t ms, F func) { return MacroDelay::delay(ms, std::move(func)); }
+template<typename F>
+inline DelayHandle macroRepeat(uint32_t intervalMs, F func) { return MacroDelay::repeat(intervalMs, std::move(func)); }
 
 #endif
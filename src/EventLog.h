@@ -0,0 +1,73 @@
+#ifndef MMZ_EVENT_LOG_H
+#define MMZ_EVENT_LOG_H
+
+#include <stdint.h>
+
+#include "SpscQueue.h"
+
+// 記録できるイベントの数(2のべき乗) 0(既定)の場合は記録の処理ごと取り除かれる
+// Number of events the log can hold (a power of two). With 0, the default, the log and its cost are
+// removed entirely; define it (e.g. 64) to opt in.
+#ifndef MMZ_EVENT_LOG_SIZE
+#define MMZ_EVENT_LOG_SIZE 0
+#endif
+
+// 発生したイベントの記録 A recorded key event
+struct EventRecord {
+    uint32_t time;  //発生した時刻(micros()) When it occurred, in micros()
+    uint16_t index; //キーのインデックス Index of the key (NUM_OF_KEYS + n for combo n)
+    uint8_t event;  //Key::Eventの値 The Key::Event, as its underlying value
+};
+
+// Key::update()で発生したイベントを時刻とともに記録する
+// Records every event emitted by Key::update() with its timestamp, so that macros and host tools can
+// read what happened in bulk instead of polling hasOccurred() on every key. PRESSED and RELEASED,
+// which occur on every scan, are not recorded. Keys record on the scanning core and one other
+// place may drain the log; when it is full, new events are dropped and counted.
+class EventLog {
+public:
+    static constexpr uint16_t CAPACITY = MMZ_EVENT_LOG_SIZE;
+    static constexpr bool ENABLED = (CAPACITY > 0);
+
+    static inline void record(const uint16_t index, uint16_t events, const uint32_t time) {
+        if constexpr (ENABLED) {
+            while (events != 0) {
+                const uint8_t event = __builtin_ctz(events);
+                events &= ~(1U << event);
+                queue_.push({ time, index, event });
+            }
+        }
+    }
+
+    static bool pop(EventRecord& record) {
+        if constexpr (ENABLED) { return queue_.pop(record); }
+        return false;
+    }
+
+    // 最大max個のイベントを古い順にrecordsへ取り出し、その数を返す
+    // Moves up to max events, oldest first, into records and returns how many were moved.
+    static uint16_t drain(EventRecord* records, const uint16_t max) {
+        uint16_t count = 0;
+        while ((count < max) && pop(records[count])) { count++; }
+        return count;
+    }
+
+    static uint16_t size() {
+        if constexpr (ENABLED) { return queue_.size(); }
+        return 0;
+    }
+
+    // 記録できずに失われたイベントの数 Events dropped because the log was full
+    static uint32_t getOverflowCount() {
+        if constexpr (ENABLED) { return queue_.getOverflowCount(); }
+        return 0;
+    }
+
+private:
+    EventLog() {}
+
+    //無効な場合は参照されないため、リンクされない Never referenced, so never linked, when disabled
+    inline static SpscQueue<EventRecord, (ENABLED ? CAPACITY : 1)> queue_;
+};
+
+#endif
@@ -0,0 +1,264 @@
+#ifndef MMZ_HID_BATCH_H
+#define MMZ_HID_BATCH_H
+
+#include <Arduino.h>
+
+#include "SpscQueue.h"
+#include "Stats.h"
+
+// 1にするとpressTo()やmod()のキー入力をまとめて送信する
+// 1 makes pressTo(), mod() and the other Keyboard_h_Util macros go through HidBatch instead of
+// calling Keyboard directly. 0 (the default) removes the batching entirely.
+#ifndef MMZ_HID_BATCH
+#define MMZ_HID_BATCH 0
+#endif
+
+// 送信を待てるレポートの数(2のべき乗) Number of reports that can wait for the bus (a power of two).
+#ifndef MMZ_HID_QUEUE_SIZE
+#define MMZ_HID_QUEUE_SIZE 16
+#endif
+
+// レポートを送信する最短の間隔(us) USBフルスピードのフレームは1ms
+// Shortest time between two reports in us; a full-speed USB frame is 1 ms.
+#ifndef MMZ_HID_INTERVAL
+#define MMZ_HID_INTERVAL 1000
+#endif
+
+// 押されているキーの集合(NKRO) The keys held down, as an NKRO bitmap of HID usages plus the modifier byte.
+struct HidReport {
+    uint8_t modifiers; //ビット0が左Ctrl...ビット7が右GUI Bit 0 is left Ctrl ... bit 7 is right GUI
+    uint8_t keys[32];  //使用法uはkeys[u / 8]のビットu % 8 Usage u is bit (u % 8) of keys[u / 8]
+
+    inline bool isPressed(const uint8_t usage) const { return keys[usage / 8] & (1U << (usage % 8)); }
+    inline void set(const uint8_t usage, const bool pressed) {
+        if (pressed) { keys[usage / 8] |= (1U << (usage % 8)); }
+        else { keys[usage / 8] &= ~(1U << (usage % 8)); }
+    }
+
+    bool operator==(const HidReport& other) const {
+        if (modifiers != other.modifiers) { return false; }
+        for (uint8_t i = 0; i < 32; i++) {
+            if (keys[i] != other.keys[i]) { return false; }
+        }
+        return true;
+    }
+    bool operator!=(const HidReport& other) const { return !(*this == other); }
+
+    // ブートプロトコル(6KRO)のキーの配列に変換し、押されているキーの数を返す(7個目以降は含まれない)
+    // Fills the 6-key array of a boot protocol report with the lowest usages held and returns how many
+    // keys are held; keys beyond the sixth are left out.
+    uint8_t toBoot(uint8_t (&boot)[6]) const {
+        uint8_t count = 0;
+        for (uint16_t usage = 1; usage < 256; usage++) {
+            if (!isPressed(usage)) { continue; }
+            if (count < 6) { boot[count] = usage; }
+            count++;
+        }
+        for (uint8_t i = count; i < 6; i++) { boot[i] = 0; }
+        return count;
+    }
+};
+
+// レポートの送信先 Where the batched reports go.
+class HidSink {
+public:
+    // 次のレポートを受け付けられるか(USBの送信が終わっているか) Whether the previous report has gone out
+    virtual bool ready() { return true; }
+    virtual void send(const HidReport& report) = 0;
+
+    virtual ~HidSink() = default;
+};
+
+namespace HidData {
+    // ShiftのビットとなるUS配列のASCIIの変換表の印 Marks the ASCII characters typed with Shift.
+    static constexpr uint8_t SHIFT = 0x80;
+
+    // ASCII (0x00-0x7F)からUS配列のHIDの使用法への変換表 ASCII to HID usage on a US layout; 0 is not typeable.
+    static constexpr uint8_t ASCII[128] = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,                 // NUL-BEL
+        0x2A, 0x2B, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00,                 // BS TAB LF
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x29, 0x00, 0x00, 0x00, 0x00,                 // ESC
+        0x2C, 0x1E | SHIFT, 0x34 | SHIFT, 0x20 | SHIFT,                 // space ! " #
+        0x21 | SHIFT, 0x22 | SHIFT, 0x24 | SHIFT, 0x34,                 // $ % & '
+        0x26 | SHIFT, 0x27 | SHIFT, 0x25 | SHIFT, 0x2E | SHIFT,         // ( ) * +
+        0x36, 0x2D, 0x37, 0x38,                                         // , - . /
+        0x27, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26,     // 0-9
+        0x33 | SHIFT, 0x33, 0x36 | SHIFT, 0x2E, 0x37 | SHIFT, 0x38 | SHIFT, // : ; < = > ?
+        0x1F | SHIFT,                                                   // @
+        0x04 | SHIFT, 0x05 | SHIFT, 0x06 | SHIFT, 0x07 | SHIFT, 0x08 | SHIFT, 0x09 | SHIFT, 0x0A | SHIFT, // A-G
+        0x0B | SHIFT, 0x0C | SHIFT, 0x0D | SHIFT, 0x0E | SHIFT, 0x0F | SHIFT, 0x10 | SHIFT, 0x11 | SHIFT, // H-N
+        0x12 | SHIFT, 0x13 | SHIFT, 0x14 | SHIFT, 0x15 | SHIFT, 0x16 | SHIFT, 0x17 | SHIFT, 0x18 | SHIFT, // O-U
+        0x19 | SHIFT, 0x1A | SHIFT, 0x1B | SHIFT, 0x1C | SHIFT, 0x1D | SHIFT,                             // V-Z
+        0x2F, 0x31, 0x30, 0x23 | SHIFT, 0x2D | SHIFT, 0x35,             // [ \ ] ^ _ `
+        0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A,                       // a-g
+        0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11,                       // h-n
+        0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,                       // o-u
+        0x19, 0x1A, 0x1B, 0x1C, 0x1D,                                   // v-z
+        0x2F | SHIFT, 0x31 | SHIFT, 0x30 | SHIFT, 0x35 | SHIFT, 0x00    // { | } ~ DEL
+    };
+
+    // Keyboard.press()と同じキーコードを使用法と修飾キーに変換する 変換できない場合はfalse
+    // Converts a keycode as passed to Keyboard.press() into a usage and modifier bits: ASCII characters
+    // (US layout), KEY_LEFT_CTRL-KEY_RIGHT_GUI (0x80-0x87), and other KEY_* codes (usage + 0x88).
+    inline bool toUsage(const uint8_t code, uint8_t& usage, uint8_t& modifiers) {
+        usage = 0;
+        modifiers = 0;
+
+        if (code >= 0x88) {
+            usage = code - 0x88;
+        } else if (code >= 0x80) {
+            modifiers = 1U << (code - 0x80);
+        } else {
+            usage = ASCII[code] & ~SHIFT;
+            if (ASCII[code] & SHIFT) { modifiers = 0x02; } //左Shift Left Shift
+        }
+        return (usage != 0) || (modifiers != 0);
+    }
+
+    // キューに入れたレポートと、最初の変化を起こしたイベントの時刻(Stats用)
+    // A queued report with the time of the event behind its first change, for Stats.
+    struct QueuedReport {
+        HidReport report;
+        uint32_t eventTime;
+    };
+}
+
+// マクロのキー入力をまとめ、USBのフレームごとに一つのレポートとして送信する
+// Gathers the presses and releases of the macros run in one MacroPad::update() into one report, and
+// sends the queued reports at most once per MMZ_HID_INTERVAL, so that many keys changing in one scan
+// produce one report instead of a burst. A key that is pressed and released within the same update
+// (e.g. mod()'s tap) still produces two reports, so no keystroke is lost while the queue has room.
+// When it is full, releases are merged into the next report and a press that would cancel a pending
+// release is dropped instead, so a release is never lost and no key is left stuck down.
+// MacroPad::update() (or Pipeline::dispatch()) calls commit() and flush(); flush() never waits.
+class HidBatch {
+public:
+    static constexpr bool ENABLED = (MMZ_HID_BATCH != 0);
+    static constexpr uint16_t CAPACITY = MMZ_HID_QUEUE_SIZE;
+
+    static void begin(HidSink& sink) { sink_ = &sink; }
+
+    static void press(const uint8_t code) { change(code, true); }
+    static void release(const uint8_t code) { change(code, false); }
+    static void releaseAll() {
+        commitIfChanged();
+        if (current_ == committed_) { eventTime_ = Stats::getEventTime(); }
+        current_ = {};
+    }
+
+    // 一回のupdate()の変化を一つのレポートとしてキューに入れる Queues the changes of this update as one report.
+    static void commit() { commitIfChanged(); }
+
+    // 前回の送信から一フレーム経っていれば、キューのレポートを一つ送信する
+    // Sends one queued report if a frame has passed since the last one and the sink is ready.
+    // With MMZ_STATS the report latency is recorded here, when the report is actually sent.
+    static bool flush() {
+        if ((sink_ == nullptr) || (queue_.size() == 0)) { return false; }
+
+        const uint32_t now = micros();
+        if ((reports_ > 0) && ((now - lastSend_) < MMZ_HID_INTERVAL)) { return false; }
+        if (!sink_->ready()) { return false; }
+
+        HidData::QueuedReport queued;
+        queue_.pop(queued);
+        sink_->send(queued.report);
+        Stats::recordReport(queued.eventTime);
+        lastSend_ = now;
+        reports_++;
+        return true;
+    }
+
+    // 現在押されているキー(まだ送信されていないものを含む) The keys held now, including unsent changes
+    static const HidReport& getCurrent() { return current_; }
+    static uint16_t getNumOfPending() { return queue_.size(); }
+    static uint32_t getReportCount() { return reports_; }
+    // キューがあふれて失われた中間のレポートの数 Intermediate reports lost because the queue was full
+    static uint32_t getOverflowCount() { return queue_.getOverflowCount(); }
+    // キューが満杯のため捨てた押下の数 Presses dropped because the queue was full and they would cancel a release
+    static uint32_t getDroppedCount() { return dropped_; }
+
+    // すべての状態を初期状態に戻す(送信先は残す) Clears every state except the sink, e.g. between tests.
+    static void reset() {
+        HidData::QueuedReport queued;
+        while (queue_.pop(queued)) {}
+        current_ = {};
+        committed_ = {};
+        lastSend_ = 0;
+        reports_ = 0;
+        dropped_ = 0;
+    }
+
+private:
+    HidBatch() {}
+
+    static void change(const uint8_t code, const bool pressed) {
+        uint8_t usage, modifiers;
+        if (!HidData::toUsage(code, usage, modifiers)) { return; }
+
+        //このupdate()で変化したキーが元に戻る場合は、先に変化をレポートにする
+        //A key going back to its committed state within one update first commits the change, so taps are kept.
+        const bool usageReverts = (usage != 0) && (current_.isPressed(usage) != pressed) &&
+                                  (current_.isPressed(usage) != committed_.isPressed(usage));
+        const uint8_t modifierChange = pressed ? (modifiers & ~current_.modifiers) : (modifiers & current_.modifiers);
+        const bool modifierReverts = (modifierChange & (current_.modifiers ^ committed_.modifiers)) != 0;
+        if (usageReverts || modifierReverts) {
+            commitIfChanged();
+            //満杯の場合は、まだ送れていない離す入力を押下で打ち消さない
+            //With the queue full, a press must not cancel a release that is not queued yet.
+            if (pressed && (current_ != committed_)) {
+                dropped_++;
+                return;
+            }
+        }
+        if (current_ == committed_) { eventTime_ = Stats::getEventTime(); }
+
+        if (usage != 0) { current_.set(usage, pressed); }
+        if (pressed) { current_.modifiers |= modifiers; }
+        else { current_.modifiers &= ~modifiers; }
+    }
+
+    static void commitIfChanged() {
+        if (current_ == committed_) { return; }
+        //あふれた場合は次のcommit()で最新の状態を送る On overflow the next commit() queues the latest state.
+        if (queue_.push({ current_, eventTime_ })) { committed_ = current_; }
+    }
+
+    inline static HidReport current_ = {};   //押されているキー Keys held now
+    inline static HidReport committed_ = {}; //最後にキューに入れた状態 State of the last queued report
+    //無効な場合は参照されないため、リンクされない Never referenced, so never linked, when disabled
+    inline static SpscQueue<HidData::QueuedReport, (ENABLED ? CAPACITY : 1)> queue_;
+    inline static HidSink* sink_ = nullptr;
+    inline static uint32_t eventTime_ = 0; //まだキューに入れていない最初の変化の時刻 Event time of the first unqueued change
+    inline static uint32_t lastSend_ = 0;
+    inline static uint32_t reports_ = 0;
+    inline static uint32_t dropped_ = 0;
+};
+
+// PC上のテスト用の送信先 送信されたレポートを数える
+// A sink for tests on a PC: counts the reports and the keystrokes (keys going down) they carry,
+// so getReportsPerKeystroke() shows how well presses are batched.
+class MockHidSink : public HidSink {
+public:
+    MockHidSink() : last_{}, reports_(0), keystrokes_(0) {}
+
+    void send(const HidReport& report) override {
+        for (uint16_t usage = 1; usage < 256; usage++) {
+            if (report.isPressed(usage) && !last_.isPressed(usage)) { keystrokes_++; }
+        }
+        last_ = report;
+        reports_++;
+    }
+
+    const HidReport& getLast() const { return last_; }
+    uint32_t getReportCount() const { return reports_; }
+    uint32_t getKeystrokeCount() const { return keystrokes_; }
+    float getReportsPerKeystroke() const { return (keystrokes_ == 0) ? 0 : static_cast<float>(reports_) / keystrokes_; }
+
+private:
+    HidReport last_;
+    uint32_t reports_;
+    uint32_t keystrokes_;
+};
+
+#endif
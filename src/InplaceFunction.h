@@ -0,0 +1,118 @@
+#ifndef MMZ_INPLACE_FUNCTION_H
+#define MMZ_INPLACE_FUNCTION_H
+
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// 動的メモリ確保を行わない固定容量の関数ラッパー
+// A fixed-capacity function wrapper that never allocates.
+// The callable is stored inside the object; callables larger than CAPACITY are rejected at compile time.
+template<typename Signature, size_t CAPACITY>
+class InplaceFunction;
+
+template<typename R, typename... Args, size_t CAPACITY>
+class InplaceFunction<R(Args...), CAPACITY> {
+public:
+    template<typename F>
+    static constexpr bool fits() {
+        return (sizeof(F) <= CAPACITY) && (alignof(F) <= ALIGNMENT) && std::is_copy_constructible<F>::value;
+    }
+
+    //constexprにして静的な配列を定数初期化にする(使われない場合はリンクされない)
+    //constexpr, so static arrays of them are constant-initialized and dropped by the linker when unused.
+    constexpr InplaceFunction() : storage_{}, ops_(nullptr) {}
+    constexpr InplaceFunction(std::nullptr_t) : storage_{}, ops_(nullptr) {}
+
+    template<typename F, typename Fn = std::decay_t<F>,
+             typename = std::enable_if_t<!std::is_same<Fn, InplaceFunction>::value && !std::is_same<Fn, std::nullptr_t>::value>>
+    InplaceFunction(F&& func) : ops_(nullptr) {
+        static_assert(fits<Fn>(), "The callable does not fit in the InplaceFunction storage.");
+
+        //空の関数ポインタやstd::functionは空として扱う Empty function pointers and std::function objects are kept empty.
+        if constexpr (std::is_constructible<bool, const Fn&>::value) {
+            if (!static_cast<bool>(func)) { return; }
+        }
+
+        new (storage_) Fn(std::forward<F>(func));
+        ops_ = &OPS<Fn>;
+    }
+
+    InplaceFunction(const InplaceFunction& other) : ops_(other.ops_) {
+        if (ops_ != nullptr) { ops_->copy(storage_, other.storage_); }
+    }
+
+    //移動元は空になる The source is left empty.
+    InplaceFunction(InplaceFunction&& other) : ops_(other.ops_) {
+        if (ops_ != nullptr) { ops_->move(storage_, other.storage_); }
+        other.ops_ = nullptr;
+    }
+
+    InplaceFunction& operator=(const InplaceFunction& other) {
+        if (this == &other) { return *this; }
+        reset();
+        if (other.ops_ != nullptr) { other.ops_->copy(storage_, other.storage_); }
+        ops_ = other.ops_;
+        return *this;
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other) {
+        if (this == &other) { return *this; }
+        reset();
+        if (other.ops_ != nullptr) { other.ops_->move(storage_, other.storage_); }
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t) {
+        reset();
+        return *this;
+    }
+
+    ~InplaceFunction() { reset(); }
+
+    R operator()(Args... args) const { return ops_->invoke(storage_, std::forward<Args>(args)...); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+    bool operator==(std::nullptr_t) const { return ops_ == nullptr; }
+    bool operator!=(std::nullptr_t) const { return ops_ != nullptr; }
+
+private:
+    static constexpr size_t ALIGNMENT = alignof(void*) * 2;
+
+    struct Ops {
+        R (*invoke)(const void*, Args&&...);
+        void (*copy)(void*, const void*);
+        void (*move)(void*, void*); //移動し、移動元を破棄する Moves, then destroys the source
+        void (*destroy)(void*);
+    };
+
+    template<typename Fn>
+    static R invokeAs(const void* storage, Args&&... args) {
+        return (*static_cast<Fn*>(const_cast<void*>(storage)))(std::forward<Args>(args)...);
+    }
+    template<typename Fn>
+    static void copyAs(void* dst, const void* src) { new (dst) Fn(*static_cast<const Fn*>(src)); }
+    template<typename Fn>
+    static void moveAs(void* dst, void* src) {
+        new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+        static_cast<Fn*>(src)->~Fn();
+    }
+    template<typename Fn>
+    static void destroyAs(void* storage) { static_cast<Fn*>(storage)->~Fn(); }
+
+    template<typename Fn>
+    static constexpr Ops OPS = { &invokeAs<Fn>, &copyAs<Fn>, &moveAs<Fn>, &destroyAs<Fn> };
+
+    inline void reset() {
+        if (ops_ != nullptr) { ops_->destroy(storage_); }
+        ops_ = nullptr;
+    }
+
+    alignas(ALIGNMENT) unsigned char storage_[CAPACITY];
+    const Ops* ops_;
+};
+
+#endif
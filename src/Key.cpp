@@ -28,39 +28,14 @@
 /* public */
 
 Key::Key()
- : lastTransTime_(0), countOfClick_(0), eventFlags_(0), index_(0),
-   hasOccurred_(0), callback_() {}
+ : countOfClick_(0), eventFlags_(0), index_(0), lastTransTime_(0),
+   hasOccurred_(0), timing_(0), rawTime_(0) {}
 
-void Key::registerMacro(const Macro func) { callback_ = func; }
-void Key::removeMacro() { registerMacro(nullptr); }
+void Key::emulate(const Event type) { hasOccurred_ |= (1U << static_cast<uint8_t>(type)); }
+void Key::clear(const Event type) { hasOccurred_ &= ~(1U << static_cast<uint8_t>(type)); }
 
-void Key::emulate(const Event type) { hasOccurred_ |= (1 << static_cast<uint8_t>(type)); }
-void Key::clear(const Event type) { hasOccurred_ &= ~(1 << static_cast<uint8_t>(type)); }
+bool Key::hasOccurred(const Event type) const { return hasOccurred_ & (1U << static_cast<uint8_t>(type)); }
 
-void Key::update(const bool isPressed, const uint32_t now) {
-    hasOccurred_ = 0;
-
-    const uint32_t elapsedTime = now - lastTransTime_;
-
-    if (elapsedTime >= DEBOUNCE_TIME) {
-        if (isPressed) { onPress(now, elapsedTime); }
-        else { onRelease(now, elapsedTime); }
-    }
-
-    //isPressBak_ = isPressed; // 前回の値を更新
-    setFlag(EventFlag::PRESS_BAK, isPressed);
-}
-
-void Key::invoke() const {
-    if (callback_ != nullptr) { callback_(*this); }
-}
-
-bool Key::hasOccurred(const Event type) const { return hasOccurred_ & (1 << static_cast<uint8_t>(type)); }
-
-uint32_t Key::getStateDuration() const { return millis() - lastTransTime_; }
+uint32_t Key::getStateDuration() const { return (micros() - lastTransTime_) / 1000; }
 uint8_t Key::getCountOfClick() const { return countOfClick_; }
 
-uint32_t Key::LONG_THRESHOLD = 500;
-uint32_t Key::DOUBLE_THRESHOLD = 200;
-uint32_t Key::HOLD_THRESHOLD = 200;
-uint32_t Key::DEBOUNCE_TIME = 20;
@@ -25,12 +25,97 @@
 #ifndef MMZ_KEY_H
 #define MMZ_KEY_H
 
+#include <stdint.h>
 #include <functional>
 #include <array>
+#include <type_traits>
+
+#include "InplaceFunction.h"
+#include "Timing.h"
+#include "Debounce.h"
+#include "EventLog.h"
 
 class Key;
 
-using Macro = std::function<void(Key)>;
+// マクロが動的メモリ確保なしで保持できる関数オブジェクトの大きさ(バイト)
+// Size in bytes of the callables a macro can hold without allocating.
+#ifndef MMZ_MACRO_STORAGE_SIZE
+#define MMZ_MACRO_STORAGE_SIZE (4 * sizeof(void*))
+#endif
+
+// 1にすると容量を超える関数をstd::functionでヒープに置く(0の場合はコンパイルエラー)
+// 1 keeps callables larger than MMZ_MACRO_STORAGE_SIZE on the heap through std::function;
+// with 0 they are a compile error, so a macro never allocates behind your back.
+#ifndef MMZ_MACRO_ALLOW_HEAP
+#define MMZ_MACRO_ALLOW_HEAP 0
+#endif
+
+using MacroFunc = InplaceFunction<void(const Key&), MMZ_MACRO_STORAGE_SIZE>;
+using LegacyMacro = std::function<void(Key)>; //以前のマクロの型 The former macro type
+
+// キーに割り当てる処理と、その処理を呼び出すイベントの組
+// A callable assigned to a key, together with the set of events it subscribes to.
+// The macro is only invoked on ticks where at least one of the subscribed events occurred.
+class Macro {
+public:
+    static constexpr uint16_t ALL_EVENTS = 0x03FF;
+
+    constexpr Macro(std::nullptr_t = nullptr) : func_(nullptr), events_(0), timing_(TimingTable::INHERIT) {}
+
+    template<typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Macro>::value &&
+                                                     !std::is_same<std::decay_t<F>, std::nullptr_t>::value>>
+    Macro(F func, const uint16_t events=ALL_EVENTS) : func_(wrap(std::move(func))), events_(events), timing_(TimingTable::INHERIT) {}
+
+    void operator()(const Key& key) const { func_(key); }
+
+    explicit operator bool() const { return static_cast<bool>(func_); }
+    bool operator==(std::nullptr_t) const { return !func_; }
+    bool operator!=(std::nullptr_t) const { return static_cast<bool>(func_); }
+
+    uint16_t getEvents() const { return (func_) ? events_ : 0; }
+
+    // 下のレイヤーの割り当てをそのまま使う Falls through to the binding of the next active layer below.
+    static Macro transparent() {
+        Macro macro;
+        macro.events_ = TRANSPARENT_FLAG;
+        return macro;
+    }
+    bool isTransparent() const { return !func_ && (events_ & TRANSPARENT_FLAG); }
+
+    // このマクロが割り当てられている間、キーが使うタイミング設定(TimingTableのインデックス)
+    // Returns a copy that makes the key use the given TimingTable profile while this macro is bound to it.
+    Macro withTiming(const uint8_t profile) const {
+        Macro macro = *this;
+        macro.timing_ = profile;
+        return macro;
+    }
+    uint8_t getTiming() const { return timing_; }
+
+private:
+    static constexpr uint16_t TRANSPARENT_FLAG = 0x8000;
+
+    // 容量に収まる関数はそのまま保持する 収まらない関数はMMZ_MACRO_ALLOW_HEAPが1の場合のみstd::functionを介して保持する
+    // Callables that fit are stored in place, including the former signatures (std::function<void(Key)>,
+    // void greet(Key key)), which still copy the key. Larger ones are a compile error unless
+    // MMZ_MACRO_ALLOW_HEAP is 1, in which case they are kept through a std::function adapter.
+    template<typename F>
+    static MacroFunc wrap(F func) {
+        if constexpr (MacroFunc::fits<F>() && std::is_invocable<const F&, const Key&>::value) {
+            return MacroFunc(std::move(func));
+        } else {
+            static_assert(MMZ_MACRO_ALLOW_HEAP || (sizeof(F) == 0),
+                          "The macro does not fit in MMZ_MACRO_STORAGE_SIZE (or cannot be called with const Key&). Capture less (e.g. a pointer), raise MMZ_MACRO_STORAGE_SIZE, or define MMZ_MACRO_ALLOW_HEAP 1.");
+            LegacyMacro legacy(std::move(func));
+            if (!legacy) { return nullptr; }
+            return MacroFunc([legacy](const Key& key) { legacy(key); });
+        }
+    }
+
+    MacroFunc func_;
+    uint16_t events_; //Key::Eventと同じ並びのビットマスク Bitmask in the same order as Key::Event
+    uint8_t timing_;  //タイミング設定 Timing profile, TimingTable::INHERIT for the key's own
+};
+
 template<uint16_t NUM_OF_KEYS>
 using Keymap = std::array<Macro, NUM_OF_KEYS>;
 template <uint16_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS>
@@ -40,8 +125,6 @@ using ProfiledLayers = std::array<LayeredKeymap<NUM_OF_KEYS, NUM_OF_LAYERS>, NUM
 
 class Key {
 public:
-    static uint32_t LONG_THRESHOLD, DOUBLE_THRESHOLD, HOLD_THRESHOLD, DEBOUNCE_TIME;
-
     // イベントの種類
     // (排他)とついているイベントは同時にどれか一つしか発生しません。
     // Only one of the events marked with (exclusive) can occur at a time.
@@ -58,27 +141,137 @@ public:
         RELEASED,     // 10.離している間毎回     Every time the button is released
     };
 
+    // 既定のタイミング設定(0番)を変更する 65535msより長い値は65535msになる
+    // Changes the default timing profile (profile 0). Values above 65535 ms are clamped to 65535 ms.
     void static init(const uint32_t longThreshold=500, const uint32_t doubleThreshold=100,
                      const uint32_t holdThreshold=200, const uint32_t debounceTime=20) {
-        LONG_THRESHOLD = longThreshold;
-        DOUBLE_THRESHOLD = doubleThreshold;
-        HOLD_THRESHOLD = holdThreshold;
-        DEBOUNCE_TIME = debounceTime;
+        TimingTable::set(0, { TimingTable::clamp(longThreshold), TimingTable::clamp(doubleThreshold),
+                              TimingTable::clamp(holdThreshold), TimingTable::clamp(debounceTime) });
     }
 
-    Key();
+    // イベントをビットマスクに変換する
+    // Converts events into a bitmask, e.g. for Macro(func, Key::mask(Key::Event::TAP, Key::Event::HOLD)).
+    template<typename... Events>
+    static constexpr uint16_t mask(const Events... types) {
+        return static_cast<uint16_t>((0U | ... | (1U << static_cast<uint8_t>(types))));
+    }
 
-    void registerMacro(const Macro callback);
-    void removeMacro();
+    Key();
 
     void emulate(const Event type);
     void clear(const Event type);
 
-    void update(const bool isPressed, const uint32_t now);  //状態を更新する
+    // 状態を更新し、発生したイベントをビットマスクで返す
+    // Updates the state and returns the events that occurred as a bitmask (see mask()).
+    // now is micros(); every time window is measured with wrap-safe unsigned differences, so they work
+    // across the 71 minute wrap of micros() (a key left untouched for exactly a multiple of that is not).
+    // TIMING provides the thresholds (TimingTable or FixedTiming); profile overrides the key's own
+    // profile unless it is TimingTable::INHERIT. DEBOUNCE is the debounce policy (see Debounce.h).
+    template<typename TIMING = TimingTable, typename DEBOUNCE = EagerDebounce<>>
+    inline uint16_t update(const bool isPressed, const uint32_t now, const uint8_t profile = TimingTable::INHERIT) {
+        const Timing& timing = TIMING::get(resolveTiming(profile));
+        hasOccurred_ = 0;
+
+        //入力が最後に変化した時刻(1024マイクロ秒単位の下位8ビット) Low byte of the time the raw input last changed, in 1024 us ticks
+        if (isPressed != getFlag(EventFlag::RAW_BAK)) {
+            rawTime_ = static_cast<uint8_t>(now >> 10);
+            setFlag(EventFlag::RAW_BAK, isPressed);
+        }
+
+        const uint32_t elapsedTime = now - lastTransTime_;
+        const uint32_t stableFor = static_cast<uint32_t>(static_cast<uint8_t>((now >> 10) - rawTime_)) << 10;
+        const bool level = DEBOUNCE::filter(isPressed, getFlag(EventFlag::PRESS_BAK), elapsedTime, stableFor, timing);
+
+        if (level) { onPress(now, elapsedTime, timing); }
+        else { onRelease(now, elapsedTime, timing); }
+
+        //isPressBak_ = isPressed; // 前回の値を更新
+        setFlag(EventFlag::PRESS_BAK, level);
+
+        //PRESSED/RELEASED以外のイベントを記録する Record every event but the level ones
+        EventLog::record(index_, hasOccurred_ & ~mask(Event::PRESSED, Event::RELEASED), now);
+
+        return hasOccurred_;
+    }
+
+    // 時間経過だけでは新たなイベントが発生しない状態(PRESSED/RELEASEDのみ)かを返す
+    // Returns whether, as long as the input stays the same, update() will only emit PRESSED/RELEASED
+    // and change nothing else. Used by BitParallelEngine to skip the state machine for idle keys.
+    template<typename TIMING = TimingTable>
+    inline bool isSettled(const uint32_t now, const uint8_t profile = TimingTable::INHERIT) const {
+        if ((now - lastTransTime_) < toMicros(TIMING::get(resolveTiming(profile)).debounceTime)) { return false; }
 
-    void invoke() const;
+        //チャタリングの判定中 A change of the input has not been reported yet
+        if (getFlag(EventFlag::RAW_BAK) != getFlag(EventFlag::PRESS_BAK)) { return false; }
+
+        //押されている場合はホールドと長押しの判定が終わっていること
+        //While pressed, both the hold and the long press must have been handled.
+        if (getFlag(EventFlag::PRESS_BAK)) { return getFlag(EventFlag::HOLD_HANDLED) && getFlag(EventFlag::HANDLED); }
+
+        //離されている場合はクリックの判定が終わっていること
+        //While released, no click may be waiting for the double click threshold.
+        return (countOfClick_ == 0) && (!getFlag(EventFlag::HANDLED));
+    }
+
+    // 入力が変わらない限りイベントが発生しない時間(us)を返す 判定中のタイマーがなければUINT32_MAX
+    // Returns how long, in us, update() will only emit PRESSED/RELEASED if the input stays the same:
+    // the time left until a pending debounce, HOLD, LONG or SINGLE decision. UINT32_MAX when nothing is pending.
+    // Used by MacroPad::idle() to decide how long it may sleep.
+    template<typename TIMING = TimingTable>
+    inline uint32_t getIdleTime(const uint32_t now, const uint8_t profile = TimingTable::INHERIT) const {
+        const Timing& timing = TIMING::get(resolveTiming(profile));
+        const uint32_t elapsedTime = now - lastTransTime_;
+        uint32_t idleTime = UINT32_MAX;
+
+        //チャタリングの判定中 A change of the input has not been reported yet
+        if (getFlag(EventFlag::RAW_BAK) != getFlag(EventFlag::PRESS_BAK)) {
+            //判定方法により、最後のエッジか最後の入力の変化からの時間を使う Policies time either the last edge or the last raw change.
+            const uint32_t stableFor = static_cast<uint32_t>(static_cast<uint8_t>((now >> 10) - rawTime_)) << 10;
+            const uint32_t sinceEdge = remaining(elapsedTime, toMicros(timing.debounceTime));
+            const uint32_t sinceRaw = remaining(stableFor, toMicros(timing.debounceTime));
+
+            if ((sinceEdge != 0) && (sinceRaw != 0)) { idleTime = shorter(sinceEdge, sinceRaw); }
+            else if ((sinceEdge | sinceRaw) != 0) { idleTime = sinceEdge | sinceRaw; }
+            else { idleTime = 1UL << 10; }
+        }
+
+        if (getFlag(EventFlag::PRESS_BAK)) {
+            if (!getFlag(EventFlag::HOLD_HANDLED)) { idleTime = shorter(idleTime, remaining(elapsedTime, toMicros(timing.holdThreshold))); }
+            if (!getFlag(EventFlag::HANDLED)) { idleTime = shorter(idleTime, remaining(elapsedTime, toMicros(timing.longThreshold) + 1)); }
+        } else if (countOfClick_ != 0) {
+            idleTime = shorter(idleTime, remaining(elapsedTime, toMicros(timing.doubleThreshold) + 1));
+        }
+
+        return idleTime;
+    }
+
+    // キーごとのタイミング設定(TimingTableのインデックス) The key's own timing profile, an index into TimingTable
+    inline void setTiming(const uint8_t profile) { timing_ = profile; }
+    inline uint8_t getTiming() const { return timing_; }
+
+    // update()を呼ばずに、落ち着いたキーのイベントを入力レベルのみにする
+    // Sets the events of a settled key to the input level only, equivalent to update() on an idle key.
+    inline void setLevel(const bool isPressed) {
+        hasOccurred_ = (isPressed) ? mask(Event::PRESSED) : mask(Event::RELEASED);
+    }
+
+    // 別のコアへ渡したイベントからキーを組み立てる(Pipeline用) edgeTimeは直前のエッジの時刻(micros())
+    // Rebuilds what a macro sees of a key from an event handed to another core (see Pipeline):
+    // the index, the events, the click count and the time of the last edge (micros()).
+    inline void restore(const uint16_t index, const uint16_t events, const uint8_t clicks, const uint32_t edgeTime) {
+        index_ = index;
+        setFlag(EventFlag::INITIALIZED, true);
+        hasOccurred_ = events;
+        countOfClick_ = clicks;
+        lastTransTime_ = edgeTime;
+    }
+
+    // 直前のエッジ(チャタリング除去後)の時刻(micros()) Time of the last debounced edge, in micros()
+    inline uint32_t getEdgeTime() const { return lastTransTime_; }
 
     bool hasOccurred(const Event type) const;
+    // 発生したイベントのビットマスク(mask()と同じ並び) Every event that occurred, as a bitmask (see mask())
+    inline uint16_t getOccurred() const { return hasOccurred_; }
 
     uint32_t getStateDuration() const;
     uint8_t getCountOfClick() const;
@@ -86,7 +279,7 @@ public:
     inline bool isPressed() const { return hasOccurred(Event::PRESSED); }
     inline uint32_t getPressTime() const { return (isPressed()) ? getStateDuration() : 0; }
 
-    inline uint16_t getIndex() { return index_; }
+    inline uint16_t getIndex() const { return index_; }
 
     inline void setIndex(const uint16_t index) {
         if (getFlag(EventFlag::INITIALIZED)) { return; }
@@ -101,23 +294,30 @@ private:
         LONG_HANDLED,
         HOLD_HANDLED,
         INITIALIZED,
-        ONE_TIME_DISABLED
+        ONE_TIME_DISABLED,
+        RAW_BAK           //前回読み取った入力 Raw input of the previous update
     };
 
-    inline void onPress(const uint32_t now, const uint32_t elapsedTime) {
+    static constexpr uint32_t toMicros(const uint16_t ms) { return ms * 1000UL; }
+    static constexpr uint32_t shorter(const uint32_t a, const uint32_t b) { return (a < b) ? a : b; }
+    static constexpr uint32_t remaining(const uint32_t elapsed, const uint32_t threshold) { return (elapsed < threshold) ? (threshold - elapsed) : 0; }
+
+    inline uint8_t resolveTiming(const uint8_t profile) const { return (profile != TimingTable::INHERIT) ? profile : timing_; }
+
+    inline void onPress(const uint32_t now, const uint32_t /*elapsedTime*/, const Timing& timing) {
         emit(Event::PRESSED);
 
         //立ち上がりエッジのときの処理
         if (!getFlag(EventFlag::PRESS_BAK)) { onRisingEdge(now); }
 
-        if (((now - lastTransTime_) >= HOLD_THRESHOLD) && (!getFlag(EventFlag::HOLD_HANDLED))) {
+        if (((now - lastTransTime_) >= toMicros(timing.holdThreshold)) && (!getFlag(EventFlag::HOLD_HANDLED))) {
             emit(Event::HOLD);
             //isHoldPressed_ = true;
             setFlag(EventFlag::HOLD_HANDLED, true);
         }
 
         //長押し判定の時間を過ぎたら
-        if ((!getFlag(EventFlag::HANDLED)) && (now - lastTransTime_ > LONG_THRESHOLD)) {
+        if ((!getFlag(EventFlag::HANDLED)) && (now - lastTransTime_ > toMicros(timing.longThreshold))) {
             emit(Event::LONG);
             // isHandled_ = true;
             // isLongPressed_ = true;
@@ -126,11 +326,11 @@ private:
         }
     }
 
-    inline void onRelease(const uint32_t now, const uint32_t elapsedTime) {
+    inline void onRelease(const uint32_t now, const uint32_t elapsedTime, const Timing& timing) {
         emit(Event::RELEASED);
 
         //時間を過ぎた&ダブルクリック待ち(再度押されなかったとき)
-        if (elapsedTime > DOUBLE_THRESHOLD) {
+        if (elapsedTime > toMicros(timing.doubleThreshold)) {
             if (((countOfClick_ == 1)) && (!getFlag(EventFlag::LONG_HANDLED))) {
                 emit(Event::SINGLE);
             }
@@ -138,7 +338,7 @@ private:
         }
 
         //立ち下がりエッジのときの処理
-        if (getFlag(EventFlag::PRESS_BAK)) { onFallingEdge(now, elapsedTime); }
+        if (getFlag(EventFlag::PRESS_BAK)) { onFallingEdge(now, elapsedTime, timing); }
 
         //isHandled_ = false;
         setFlag(EventFlag::HANDLED, false);
@@ -160,11 +360,11 @@ private:
         countOfClick_++;
     }
 
-    inline void onFallingEdge(const uint32_t now, const uint32_t elapsedTime) {
+    inline void onFallingEdge(const uint32_t now, const uint32_t elapsedTime, const Timing& timing) {
         emit(Event::FALLING_EDGE);
         emit(Event::CHANGE_INPUT);
 
-        if (elapsedTime < HOLD_THRESHOLD) {
+        if (elapsedTime < toMicros(timing.holdThreshold)) {
             emit(Event::TAP);
         }
 
@@ -175,12 +375,12 @@ private:
         setFlag(EventFlag::HOLD_HANDLED, false);
     }
 
-    inline void emit(const Event type) { hasOccurred_ |= (1 << static_cast<uint8_t>(type)); }
+    inline void emit(const Event type) { hasOccurred_ |= (1U << static_cast<uint8_t>(type)); }
 
-    inline bool getFlag(const EventFlag flag) const { return eventFlags_ & (1 << static_cast<uint8_t>(flag)); }
+    inline bool getFlag(const EventFlag flag) const { return eventFlags_ & (1U << static_cast<uint8_t>(flag)); }
     inline void setFlag(const EventFlag flag, const bool mode) {
-        if (mode) { eventFlags_ |= (1 << static_cast<uint8_t>(flag)); }
-        else { eventFlags_ &= ~(1 << static_cast<uint8_t>(flag)); }
+        if (mode) { eventFlags_ |= (1U << static_cast<uint8_t>(flag)); }
+        else { eventFlags_ &= ~(1U << static_cast<uint8_t>(flag)); }
     }
 
     static constexpr uint8_t NUM_OF_EVENTS = 8;
@@ -189,11 +389,11 @@ private:
     uint8_t countOfClick_;
     uint8_t eventFlags_;
     uint16_t index_;
-    uint32_t lastTransTime_;
+    uint32_t lastTransTime_; //最後に入力が切り替わった時刻(micros()) Time of the last debounced edge, in micros()
 
     uint16_t hasOccurred_; //0番目のビットが短押し,1番目のビットが長押し...のように対応している
-
-    Macro callback_;
+    uint8_t timing_;       //タイミング設定 Timing profile (fits in the padding, the key does not grow)
+    uint8_t rawTime_;      //入力が最後に変化した時刻 Time the raw input last changed, in 1024 us ticks (low byte)
 };
 
 #endif
@@ -0,0 +1,119 @@
+#ifndef MMZ_KEY_ENGINE_H
+#define MMZ_KEY_ENGINE_H
+
+#include <array>
+
+#include "KeyReader/KeyReader.h"
+#include "Key.h"
+
+// キーの状態を更新し、マクロを実行するキーを求める処理
+// Engines update the state of every key from the reader's state words and mark the keys
+// whose macro has to be dispatched in the dirty bitmap.
+// BINDINGS tells which events each key's macro subscribes to (see Layer):
+//     uint16_t getEvents(uint16_t index);
+//     uint8_t getTiming(uint16_t index);  // Timing profile of the bound macro, or TimingTable::INHERIT
+//     ReaderData::Word getPressedSubscribers(uint16_t word), getReleasedSubscribers(uint16_t word);
+//
+// TIMING: 判定の時間(TimingTable: キーごとに実行中に変更可能, FixedTiming: コンパイル時に固定)
+//         Where the thresholds come from: TimingTable (per key/macro profiles, changeable at run time)
+//         or FixedTiming (constants folded into the state machine).
+// DEBOUNCE: チャタリングの除去方法(EagerDebounce/DeferredDebounce/AsymmetricDebounce)
+//           How the input is debounced (see Debounce.h).
+
+// すべてのキーの状態遷移を毎回一つずつ処理する
+// Runs the state machine of every key on every scan.
+template<uint16_t NUM_OF_KEYS, typename TIMING = TimingTable, typename DEBOUNCE = EagerDebounce<>>
+class SerialEngine {
+public:
+    static constexpr uint16_t KEYBOARD_SIZE = ReaderData::calcKeyboardSize<NUM_OF_KEYS>();
+    using TimingSource = TIMING;
+
+    template<typename BINDINGS>
+    void update(std::array<Key, NUM_OF_KEYS>& keys, const ReaderData::Word (&stateData)[KEYBOARD_SIZE],
+                const uint32_t now, const BINDINGS& bindings, ReaderData::Word (&dirtyKeys)[KEYBOARD_SIZE]) {
+        for (uint16_t i = 0; i < NUM_OF_KEYS; i++) {
+            const uint16_t word = ReaderData::getIndex(i);
+            const ReaderData::Word bit = ReaderData::bit(ReaderData::getDigit(i));
+
+            const uint16_t events = keys[i].template update<TIMING, DEBOUNCE>(stateData[word] & bit, now, bindings.getTiming(i));
+            if (events & bindings.getEvents(i)) { dirtyKeys[word] |= bit; }
+        }
+    }
+
+    void touch(const uint16_t /*index*/) {}
+};
+
+// 1要素分(32または64キー)の状態をビット演算でまとめて処理し、入力が変化したキーとタイマーの判定中のキーのみ状態遷移を処理する
+// Processes a whole state word (32 or 64 keys) at a time with bitwise operations. Only keys whose input changed, or that are
+// still inside the debounce lockout or waiting for a HOLD/LONG/DOUBLE threshold ("busy" keys),
+// go through Key::update(); every other key can only emit PRESSED/RELEASED, which is derived
+// from the state word and the subscriber masks directly. The events are identical to SerialEngine.
+//
+// Events raised with Key::emulate() on an idle key are not cleared on the next scan;
+// use MacroPad::emulate(), which calls touch().
+template<uint16_t NUM_OF_KEYS, typename TIMING = TimingTable, typename DEBOUNCE = EagerDebounce<>>
+class BitParallelEngine {
+public:
+    static constexpr uint16_t KEYBOARD_SIZE = ReaderData::calcKeyboardSize<NUM_OF_KEYS>();
+    using TimingSource = TIMING;
+
+    BitParallelEngine() : previous_{}, stale_{} {
+        //起動直後はすべてのキーがデバウンス中 Every key starts inside the debounce lockout.
+        for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) { busy_[word] = ReaderData::validBits<NUM_OF_KEYS>(word); }
+    }
+
+    template<typename BINDINGS>
+    void update(std::array<Key, NUM_OF_KEYS>& keys, const ReaderData::Word (&stateData)[KEYBOARD_SIZE],
+                const uint32_t now, const BINDINGS& bindings, ReaderData::Word (&dirtyKeys)[KEYBOARD_SIZE]) {
+        for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) {
+            const ReaderData::Word input = stateData[word] & ReaderData::validBits<NUM_OF_KEYS>(word);
+            const ReaderData::Word active = busy_[word] | (input ^ previous_[word]);
+            const uint16_t base = word * ReaderData::READ_BITS;
+
+            //状態遷移を処理するキー Keys that need the full state machine
+            ReaderData::Word bits = active;
+            while (bits != 0) {
+                const uint8_t digit = ReaderData::lowestBit(bits);
+                const ReaderData::Word bit = ReaderData::bit(digit);
+                bits &= ~bit;
+
+                Key& key = keys[base + digit];
+                const uint8_t timing = bindings.getTiming(base + digit);
+                if (key.template update<TIMING, DEBOUNCE>(input & bit, now, timing) & bindings.getEvents(base + digit)) { dirtyKeys[word] |= bit; }
+
+                if (key.template isSettled<TIMING>(now, timing)) { busy_[word] &= ~bit; }
+                else { busy_[word] |= bit; }
+            }
+
+            //前回イベントが発生したキーを入力レベルのみに戻す Idle keys that had other events last scan
+            bits = stale_[word] & ~active;
+            while (bits != 0) {
+                const uint8_t digit = ReaderData::lowestBit(bits);
+                bits &= ~ReaderData::bit(digit);
+
+                keys[base + digit].setLevel(input & ReaderData::bit(digit));
+            }
+
+            //PRESSED/RELEASEDを購読しているキー Idle keys subscribed to PRESSED/RELEASED
+            dirtyKeys[word] |= ~active & ((input & bindings.getPressedSubscribers(word)) |
+                                          (~input & bindings.getReleasedSubscribers(word)));
+
+            stale_[word] = active;
+            previous_[word] = input;
+        }
+    }
+
+    // 次のスキャンで必ず状態遷移を処理する
+    // Forces the state machine of the key to run on the next scan.
+    void touch(const uint16_t index) {
+        if (index >= NUM_OF_KEYS) { return; }
+        stale_[ReaderData::getIndex(index)] |= ReaderData::bit(ReaderData::getDigit(index));
+    }
+
+private:
+    ReaderData::Word previous_[KEYBOARD_SIZE]; //前回の入力 Input of the previous scan
+    ReaderData::Word busy_[KEYBOARD_SIZE];     //状態遷移の処理が必要なキー Keys that are not settled
+    ReaderData::Word stale_[KEYBOARD_SIZE];     //前回状態遷移を処理したキー Keys updated through the state machine last scan
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef MMZ_COMPOSITE_H
+#define MMZ_COMPOSITE_H
+
+#include <stddef.h>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "KeyReader.h"
+
+// 複数の読み取りクラスを一つのキー配列にまとめる
+// Concatenates several readers into one key space: the keys of the first reader come first, then those
+// of the second reader, and so on, at offsets fixed at compile time.
+//     Matrix<4, 4> matrix(rowPins, colPins);
+//     ShiftRegister<16> buttons(loadPin, clockPin, dataPin);
+//     Composite reader(matrix, buttons); // keys 0-15: matrix, keys 16-31: buttons
+// The readers are called through their own types, so there is no virtual call, and their state words
+// are merged once per scan: a reader that starts on a word boundary is copied word by word, any other
+// with shifts across the word boundaries. wait() does not sleep, because only one reader could wake it.
+template<typename... READERS>
+class Composite : public KeyReader<(READERS::getNumOfKeys() + ...)> {
+public:
+    static_assert((sizeof...(READERS) > 0), "'Composite' needs at least one reader.");
+    static_assert((std::is_base_of<KeyReader<READERS::getNumOfKeys()>, READERS>::value && ...), "Every reader must derive from KeyReader.");
+
+    static constexpr uint16_t NUM_OF_KEYS = (READERS::getNumOfKeys() + ...);
+    static constexpr uint16_t KEYBOARD_SIZE = KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE;
+
+    Composite(READERS&... readers) : readers_(readers...), keys_{} {}
+
+    ReaderData::Word (&getStateData())[KEYBOARD_SIZE] { return keys_; }
+
+    void read() { readAll(std::index_sequence_for<READERS...>{}); }
+
+    // I番目の読み取りクラスの最初のキーのインデックス Index of the first key of the I-th reader
+    template<size_t I>
+    static constexpr uint16_t getOffset() {
+        constexpr uint16_t sizes[] = { READERS::getNumOfKeys()... };
+        uint16_t offset = 0;
+        for (size_t i = 0; i < I; i++) { offset += sizes[i]; }
+        return offset;
+    }
+
+    template<size_t I>
+    auto& getReader() { return std::get<I>(readers_); }
+
+private:
+    template<size_t... I>
+    void readAll(std::index_sequence<I...>) { (readOne<I>(), ...); }
+
+    template<size_t I>
+    void readOne() {
+        using Reader = typename std::tuple_element<I, std::tuple<READERS...>>::type;
+        constexpr uint16_t KEYS = Reader::getNumOfKeys();
+        constexpr uint16_t SIZE = ReaderData::calcKeyboardSize<KEYS>();
+        constexpr uint16_t OFFSET = getOffset<I>();
+
+        Reader& reader = std::get<I>(readers_);
+        reader.Reader::read();
+        const ReaderData::Word (&input)[SIZE] = reader.Reader::getStateData();
+
+        if constexpr (ReaderData::getDigit(OFFSET) == 0) {
+            //要素の境界から始まる場合はそのままコピーする(最後の要素の残りは後の読み取りクラスが書き込む)
+            //Word-aligned: copy the words; the rest of the last word is written by the readers that follow.
+            constexpr uint16_t FIRST = ReaderData::getIndex(OFFSET);
+            for (uint16_t word = 0; word < SIZE; word++) {
+                keys_[FIRST + word] = input[word] & ReaderData::validBits<KEYS>(word);
+            }
+        } else {
+            for (uint16_t key = 0; key < KEYS; key += 32) {
+                const uint8_t count = ((KEYS - key) < 32) ? (KEYS - key) : 32;
+                ReaderData::setBits(keys_, OFFSET + key, count, ReaderData::getBits(input, key, count));
+            }
+        }
+    }
+
+    std::tuple<READERS&...> readers_;
+    ReaderData::Word keys_[KEYBOARD_SIZE];
+};
+
+#endif
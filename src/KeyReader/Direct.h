@@ -1,9 +1,10 @@
 #ifndef MMZ_DIRECT_H
 #define MMZ_DIRECT_H
 
+#include <Arduino.h>
 #include "KeyReader.h"
 
-template<uint8_t NUM_OF_KEYS>
+template<uint16_t NUM_OF_KEYS>
 class Direct : public KeyReader<NUM_OF_KEYS> {
 public:
     Direct(uint8_t (&pins)[NUM_OF_KEYS])
@@ -13,17 +14,17 @@ public:
         }
     }
 
-    uint32_t (&getStateData())[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE] { return keys_; }
+    ReaderData::Word (&getStateData())[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE] { return keys_; }
 
     void read() {
-        for (uint8_t i = 0; i < NUM_OF_KEYS; i++) {
-            setState(keys_, i, !digitalRead(PINS[i]));
+        for (uint16_t i = 0; i < NUM_OF_KEYS; i++) {
+            ReaderData::setState(keys_, i, !digitalRead(PINS[i]));
         }
     }
 
 private:
     const uint8_t (&PINS)[NUM_OF_KEYS];
-    uint32_t keys_[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE];
+    ReaderData::Word keys_[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE];
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,100 @@
+#ifndef MMZ_EDGE_SOURCE_H
+#define MMZ_EDGE_SOURCE_H
+
+#include <Arduino.h>
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <hardware/sync.h>
+#include <pico/time.h>
+#endif
+
+// ピンの入力の変化(エッジ)を知らせる仕組み
+// An edge source reports which pins changed since it was last asked, so that a reader only has to read
+// those pins and MacroPad::idle() can sleep until something happens. InterruptDirect is templated on the
+// source, so any type with these static functions works, e.g. a mock on the host (bit n is GPIO n, 0-31):
+//     static void arm(uint32_t mask);              // Starts reporting edges on the pins in mask.
+//     static uint32_t take(uint32_t& time);        // Returns and clears the pins that changed, and sets
+//                                                  // time to the micros() of the first of those edges.
+//     static bool wait(uint32_t timeout);          // Sleeps until an edge or timeout us; false if it cannot sleep.
+
+#if defined(ARDUINO_ARCH_RP2040)
+
+// GPIOの割り込みでエッジを記録し、WFEで眠る
+// Records edges from the GPIO interrupt and sleeps with WFE, so the core idles at low power until
+// a key changes or the timeout passes.
+struct GpioEdgeSource {
+    static void arm(const uint32_t mask) {
+        for (uint8_t pin = 0; pin < 32; pin++) {
+            if (mask & (1UL << pin)) { attachInterruptParam(pin, onEdge, CHANGE, reinterpret_cast<void*>(pin)); }
+        }
+    }
+
+    static uint32_t take(uint32_t& time) {
+        const uint32_t status = save_and_disable_interrupts();
+        const uint32_t pins = pending_;
+        time = time_;
+        pending_ = 0;
+        restore_interrupts(status);
+        return pins;
+    }
+
+    static bool wait(const uint32_t timeout) {
+        const absolute_time_t until = make_timeout_time_us(timeout);
+        while ((pending_ == 0) && !best_effort_wfe_or_timeout(until)) {}
+        return true;
+    }
+
+private:
+    static void onEdge(void* param) {
+        if (pending_ == 0) { time_ = time_us_32(); }
+        pending_ |= (1UL << reinterpret_cast<uintptr_t>(param));
+    }
+
+    inline static volatile uint32_t pending_ = 0; //変化したピン Pins that changed since the last take()
+    inline static volatile uint32_t time_ = 0;    //最初のエッジの時刻 micros() of the first of those edges
+};
+
+using DefaultEdgeSource = GpioEdgeSource;
+
+#endif
+
+// エッジを外部から与える(PCでのテスト用) 眠らずにすぐ戻る
+// Edges are injected by the caller, e.g. a test harness on a PC that changes the mocked pins.
+// wait() returns at once and remembers the timeout, so the harness can advance its clock by it.
+// Not thread-safe; inject from the thread that runs MacroPad.
+struct InjectedEdgeSource {
+    static void arm(const uint32_t mask) { armed_ |= mask; }
+
+    static void inject(const uint32_t pins) {
+        if ((pins & armed_) == 0) { return; }
+        if (pending_ == 0) { time_ = micros(); }
+        pending_ |= pins & armed_;
+    }
+
+    static uint32_t take(uint32_t& time) {
+        const uint32_t pins = pending_;
+        time = time_;
+        pending_ = 0;
+        return pins;
+    }
+
+    static bool wait(const uint32_t timeout) {
+        lastTimeout_ = timeout;
+        return true;
+    }
+
+    // 最後にwait()へ渡された時間(us) The timeout of the last wait() in us
+    static uint32_t getLastTimeout() { return lastTimeout_; }
+
+private:
+    inline static uint32_t armed_ = 0;
+    inline static uint32_t pending_ = 0;
+    inline static uint32_t time_ = 0;
+    inline static uint32_t lastTimeout_ = 0;
+};
+
+#if !defined(ARDUINO_ARCH_RP2040)
+using DefaultEdgeSource = InjectedEdgeSource;
+#endif
+
+#endif
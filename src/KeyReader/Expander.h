@@ -0,0 +1,124 @@
+#ifndef MMZ_EXPANDER_H
+#define MMZ_EXPANDER_H
+
+#include <Arduino.h>
+#include "KeyReader.h"
+
+// I2CなどのIOエキスパンダに接続されたボタンを読み取る
+// Reads buttons on an I/O expander; key i is pin i of the expander, and a pressed key reads LOW.
+// A bus transfer takes far longer than a GPIO read, so the expander can be polled less often than
+// the rest of the keyboard: read() only talks to it when intervalMicros have passed since the last
+// poll and keeps the previous state otherwise. A failed transfer also keeps the previous state.
+// The device is any type with this member function, e.g. a mock on the host:
+//     bool read(uint32_t& pins); // Sets the input level of every pin (bit n is pin n); false on a bus error.
+template<uint16_t NUM_OF_KEYS, typename DEVICE>
+class Expander : public KeyReader<NUM_OF_KEYS> {
+public:
+    static_assert((NUM_OF_KEYS > 0) && (NUM_OF_KEYS <= 32), "'NUM_OF_KEYS' must be between 1 and 32.");
+
+    Expander(DEVICE& device, const uint32_t intervalMicros=0)
+     : device_(device), keys_{}, INTERVAL_MICROS(intervalMicros), lastPoll_(0), polled_(false), errors_(0) {}
+
+    ReaderData::Word (&getStateData())[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE] { return keys_; }
+
+    void read() {
+        const uint32_t now = micros();
+        if (polled_ && ((now - lastPoll_) < INTERVAL_MICROS)) { return; }
+        lastPoll_ = now;
+        polled_ = true;
+
+        uint32_t pins;
+        if (!device_.read(pins)) {
+            errors_++;
+            return;
+        }
+        ReaderData::setBits(keys_, 0, NUM_OF_KEYS, ~pins);
+    }
+
+    // 失敗した読み取りの回数 Number of failed transfers
+    uint32_t getErrorCount() const { return errors_; }
+
+private:
+    DEVICE& device_;
+    ReaderData::Word keys_[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE];
+    const uint32_t INTERVAL_MICROS;
+    uint32_t lastPoll_;
+    bool polled_;
+    uint32_t errors_;
+};
+
+// PCF8574(8ピン)/PCF8575(16ピン) 入力にするピンにはHIGHを書き込んでおく
+// PCF8574 (8 pins) and PCF8575 (16 pins). Their pins are quasi-bidirectional: writing HIGH once turns
+// on the weak pull-ups, and every read is a plain I2C read. WIRE is TwoWire or any type with its API.
+template<typename WIRE, uint8_t PINS = 8>
+class Pcf8574 {
+public:
+    static_assert((PINS == 8) || (PINS == 16), "'PINS' must be 8 or 16.");
+
+    Pcf8574(WIRE& wire, const uint8_t address) : wire_(wire), ADDRESS(address), ready_(false) {}
+
+    bool read(uint32_t& pins) {
+        if (!ready_ && !begin()) { return false; }
+
+        if (wire_.requestFrom(ADDRESS, static_cast<uint8_t>(PINS / 8)) != (PINS / 8)) { return false; }
+        pins = 0;
+        for (uint8_t i = 0; i < PINS / 8; i++) { pins |= static_cast<uint32_t>(wire_.read() & 0xFF) << (i * 8); }
+        return true;
+    }
+
+private:
+    bool begin() {
+        wire_.beginTransmission(ADDRESS);
+        for (uint8_t i = 0; i < PINS / 8; i++) { wire_.write(static_cast<uint8_t>(0xFF)); }
+        ready_ = (wire_.endTransmission() == 0);
+        return ready_;
+    }
+
+    WIRE& wire_;
+    const uint8_t ADDRESS;
+    bool ready_;
+};
+
+// MCP23017(16ピン) 最初の読み取りでプルアップを有効にする GPA0-7が0-7、GPB0-7が8-15
+// MCP23017 (16 pins: GPA0-7 are pins 0-7, GPB0-7 pins 8-15). The internal pull-ups are enabled on the
+// first read, then each read fetches both ports in one transfer.
+template<typename WIRE>
+class Mcp23017 {
+public:
+    Mcp23017(WIRE& wire, const uint8_t address=0x20) : wire_(wire), ADDRESS(address), ready_(false) {}
+
+    bool read(uint32_t& pins) {
+        if (!ready_ && !begin()) { return false; }
+
+        wire_.beginTransmission(ADDRESS);
+        wire_.write(GPIOA);
+        if (wire_.endTransmission() != 0) { return false; }
+        if (wire_.requestFrom(ADDRESS, static_cast<uint8_t>(2)) != 2) { return false; }
+
+        const uint8_t portA = wire_.read();
+        const uint8_t portB = wire_.read();
+        pins = (static_cast<uint32_t>(portB) << 8) | portA;
+        return true;
+    }
+
+private:
+    //IOCON.BANK = 0 のレジスタ Register addresses with IOCON.BANK = 0 (the power-on default)
+    static constexpr uint8_t GPPUA = 0x0C;
+    static constexpr uint8_t GPIOA = 0x12;
+
+    bool begin() {
+        //GPPUAとGPPUBを続けて書き込む Writes GPPUA and GPPUB in one sequential transfer.
+        wire_.beginTransmission(ADDRESS);
+        wire_.write(GPPUA);
+        wire_.write(static_cast<uint8_t>(0xFF));
+        wire_.write(static_cast<uint8_t>(0xFF));
+        ready_ = (wire_.endTransmission() == 0);
+        return ready_;
+    }
+
+    WIRE& wire_;
+    const uint8_t ADDRESS;
+    bool ready_;
+};
+
+#endif
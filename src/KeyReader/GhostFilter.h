@@ -0,0 +1,77 @@
+#ifndef MMZ_GHOST_FILTER_H
+#define MMZ_GHOST_FILTER_H
+
+#include <stdint.h>
+#include "KeyReader.h"
+
+// ダイオードのないキーマトリクスで発生するゴースト(押していないキーが押されたように見える現象)を取り除く
+// Wraps a matrix reader (Matrix, PortMatrix, PioMatrix...) of a matrix without diodes and masks ghost keys.
+// Without diodes, pressing three corners of a rectangle of keys also reads the fourth as pressed, and
+// a reading can never tell which corner is the ghost. So whenever two rows share two or more pressed
+// columns, those keys are "ambiguous": an ambiguous key keeps its previous state (keys already pressed
+// stay pressed, new ones are not reported) until the rectangle is broken. Every other key is passed
+// through in the same scan, without delay.
+// The check compares whole rows with bitwise operations (ROWS * (ROWS - 1) / 2 ANDs at most).
+template<uint8_t ROWS, uint8_t COLS>
+class GhostFilter : public KeyReader<ROWS * COLS> {
+public:
+    static_assert((COLS > 0) && (COLS <= 32), "'COLS' must be between 1 and 32.");
+    static constexpr uint16_t KEYBOARD_SIZE = KeyReader<ROWS * COLS>::KEYBOARD_SIZE;
+
+    GhostFilter(KeyReader<ROWS * COLS>& reader)
+     : reader_(reader), keys_{}, ambiguous_{}, rows_{}, ghostScans_(0) {}
+
+    ReaderData::Word (&getStateData())[KEYBOARD_SIZE] { return keys_; }
+
+    void read() {
+        reader_.read();
+        const ReaderData::Word (&input)[KEYBOARD_SIZE] = reader_.getStateData();
+
+        uint32_t rows[ROWS];
+        uint32_t ambiguous[ROWS] = {};
+        for (uint8_t row = 0; row < ROWS; row++) { rows[row] = ReaderData::getBits(input, row * COLS, COLS); }
+
+        //二つの行が二つ以上の列を共有していれば、その交点は長方形をなす
+        //Two rows sharing two or more columns form a rectangle of ambiguous keys.
+        bool ghosted = false;
+        for (uint8_t first = 0; first < ROWS; first++) {
+            if (!hasTwoOrMore(rows[first])) { continue; }
+
+            for (uint8_t second = first + 1; second < ROWS; second++) {
+                const uint32_t common = rows[first] & rows[second];
+                if (!hasTwoOrMore(common)) { continue; }
+
+                ambiguous[first] |= common;
+                ambiguous[second] |= common;
+                ghosted = true;
+            }
+        }
+
+        for (uint8_t row = 0; row < ROWS; row++) {
+            rows_[row] = (rows[row] & ~ambiguous[row]) | (rows_[row] & ambiguous[row]);
+            ReaderData::setBits(keys_, row * COLS, COLS, rows_[row]);
+            ReaderData::setBits(ambiguous_, row * COLS, COLS, ambiguous[row]);
+        }
+        if (ghosted) { ghostScans_++; }
+    }
+
+    bool wait(const uint32_t timeout) override { return reader_.wait(timeout); }
+
+    // 直前のスキャンで判別できなかったキー(状態データと同じ並び) Keys that were ambiguous in the last scan, in the state data layout
+    const ReaderData::Word (&getAmbiguousKeys() const)[KEYBOARD_SIZE] { return ambiguous_; }
+    bool isAmbiguous(const uint16_t index) const { return ambiguous_[ReaderData::getIndex(index)] & ReaderData::bit(ReaderData::getDigit(index)); }
+
+    // ゴーストの可能性があったスキャンの数 Number of scans in which a rectangle was found
+    uint32_t getGhostScanCount() const { return ghostScans_; }
+
+private:
+    static inline bool hasTwoOrMore(const uint32_t bits) { return (bits & (bits - 1)) != 0; }
+
+    KeyReader<ROWS * COLS>& reader_;
+    ReaderData::Word keys_[KEYBOARD_SIZE];
+    ReaderData::Word ambiguous_[KEYBOARD_SIZE];
+    uint32_t rows_[ROWS]; //前回報告した状態 Rows as reported by the previous scan
+    uint32_t ghostScans_;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef MMZ_INTERRUPT_DIRECT_H
+#define MMZ_INTERRUPT_DIRECT_H
+
+#include <Arduino.h>
+#include "KeyReader.h"
+#include "Port.h"
+#include "EdgeSource.h"
+
+// Direct と同じ配線で、入力が変化したピンのみを読み取る MacroPad::idle()で眠れるようになる
+// Same wiring as Direct, but only the pins the edge source reported as changed are read, and
+// wait() sleeps until an edge arrives, so MacroPad::idle() can stop polling while nobody types.
+// Only GPIO 0-31 can be used.
+template<uint16_t NUM_OF_KEYS, typename SOURCE = DefaultEdgeSource>
+class InterruptDirect : public KeyReader<NUM_OF_KEYS> {
+public:
+    InterruptDirect(const uint8_t (&pins)[NUM_OF_KEYS])
+     : PINS(pins), keys_{}, stale_(PortData::toMask(pins)), lastLatency_(0), maxLatency_(0) {
+        for (uint8_t pin : PINS) {
+            pinMode(pin, INPUT_PULLUP);
+        }
+        SOURCE::arm(stale_);
+    }
+
+    ReaderData::Word (&getStateData())[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE] { return keys_; }
+
+    void read() {
+        uint32_t time;
+        const uint32_t edges = SOURCE::take(time);
+        const uint32_t changed = edges | stale_;
+        if (changed == 0) { return; }
+
+        //最初は全てのピンを読む Every pin is read the first time.
+        stale_ = 0;
+
+        for (uint16_t i = 0; i < NUM_OF_KEYS; i++) {
+            if (changed & (1UL << PINS[i])) { ReaderData::setState(keys_, i, !digitalRead(PINS[i])); }
+        }
+
+        if (edges == 0) { return; }
+        lastLatency_ = micros() - time;
+        if (lastLatency_ > maxLatency_) { maxLatency_ = lastLatency_; }
+    }
+
+    bool wait(const uint32_t timeout) override { return SOURCE::wait(timeout); }
+
+    // エッジが発生してから読み取るまでの時間(us) Time from an edge to the read() that picked it up, in us
+    uint32_t getLastLatency() const { return lastLatency_; }
+    uint32_t getMaxLatency() const { return maxLatency_; }
+
+private:
+    const uint8_t (&PINS)[NUM_OF_KEYS];
+    ReaderData::Word keys_[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE];
+    uint32_t stale_; //エッジによらず読み取るピン Pins read regardless of edges
+    uint32_t lastLatency_, maxLatency_;
+};
+
+#endif
@@ -1,36 +1,106 @@
 #ifndef MMZ_KEY_READER_H
 #define MMZ_KEY_READER_H
 
+#include <stdint.h>
+#include <type_traits>
+
+// キーの状態を格納する要素のビット数(32または64)
+// Width of the words that hold the key states: 32 (default, best on the RP2040) or 64 (for 64-bit hosts).
+#ifndef MMZ_READ_BITS
+#define MMZ_READ_BITS 32
+#endif
+
 namespace ReaderData {
-    static constexpr uint8_t READ_BITS = 32;
-    static constexpr uint8_t READ_BITS_ZERO_INDEXING = READ_BITS - 1;
+    static_assert((MMZ_READ_BITS == 32) || (MMZ_READ_BITS == 64), "'MMZ_READ_BITS' must be 32 or 64.");
+
+    // キーの状態を格納する要素 キーiは要素i / READ_BITSのi % READ_BITSビット目にあたる
+    // A word of key states: key i is bit (i % READ_BITS) of word (i / READ_BITS).
+    using Word = typename std::conditional<(MMZ_READ_BITS == 64), uint64_t, uint32_t>::type;
+
+    static constexpr uint8_t READ_BITS = MMZ_READ_BITS;
+    static constexpr Word ALL_BITS = ~static_cast<Word>(0);
 
-    const inline uint8_t getIndex(const uint16_t index) { return index / READ_BITS; }
-    const inline uint8_t getDigit(const uint16_t index) { return index % READ_BITS_ZERO_INDEXING; }
+    inline constexpr uint16_t getIndex(const uint16_t index) { return index / READ_BITS; }
+    inline constexpr uint8_t getDigit(const uint16_t index) { return index % READ_BITS; }
 
-    template<uint8_t SIZE>
-    const inline void setState(uint32_t (&array)[SIZE], const uint16_t index, const bool state) {
+    // digit番目のビット The bit of the given digit
+    inline constexpr Word bit(const uint8_t digit) { return static_cast<Word>(1) << digit; }
+    // 下位count個のビット The lowest count bits
+    inline constexpr Word lowBits(const uint8_t count) { return (count >= READ_BITS) ? ALL_BITS : (bit(count) - 1); }
+
+    // 最下位の1のビットの位置(0でないこと) Position of the lowest set bit; word must not be 0.
+    inline uint8_t lowestBit(const Word word) {
+        if constexpr (READ_BITS == 64) { return __builtin_ctzll(word); }
+        else { return __builtin_ctz(word); }
+    }
+    inline uint8_t countBits(const Word word) {
+        if constexpr (READ_BITS == 64) { return __builtin_popcountll(word); }
+        else { return __builtin_popcount(word); }
+    }
+
+    template<uint16_t SIZE>
+    inline void setState(Word (&array)[SIZE], const uint16_t index, const bool state) {
         if (state) {
-            array[getIndex(index)] |= (1 << getDigit(index));
+            array[getIndex(index)] |= bit(getDigit(index));
         } else {
-            array[getIndex(index)] &= ~(1 << getDigit(index));
+            array[getIndex(index)] &= ~bit(getDigit(index));
         }
     }
 
-    template<uint8_t NUM_OF_KEYS>
-    constexpr inline uint8_t calcKeyboardSize() { return (NUM_OF_KEYS + READ_BITS - 1) / READ_BITS; }
+    // index番目のキーから連続したcount個(1~32)のキーの状態を取り出す(要素の境界をまたいでもよい)
+    // Returns the states of count (1-32) consecutive keys starting at index; the range may straddle two words.
+    template<uint16_t SIZE>
+    inline uint32_t getBits(const Word (&array)[SIZE], const uint16_t index, const uint8_t count) {
+        const uint16_t word = getIndex(index);
+        const uint8_t digit = getDigit(index);
+
+        Word bits = array[word] >> digit;
+        if ((digit != 0) && (digit + count > READ_BITS)) { bits |= array[word + 1] << (READ_BITS - digit); }
+        return static_cast<uint32_t>(bits & lowBits(count));
+    }
+
+    // index番目のキーから連続したcount個(1~32)のキーの状態を書き込む
+    // Overwrites the states of count (1-32) consecutive keys starting at index with bits.
+    template<uint16_t SIZE>
+    inline void setBits(Word (&array)[SIZE], const uint16_t index, const uint8_t count, const uint32_t bits) {
+        const uint16_t word = getIndex(index);
+        const uint8_t digit = getDigit(index);
+        const Word mask = lowBits(count);
+        const Word value = static_cast<Word>(bits) & mask;
+
+        array[word] = (array[word] & ~(mask << digit)) | (value << digit);
+        if ((digit != 0) && (digit + count > READ_BITS)) {
+            const uint8_t shift = READ_BITS - digit;
+            array[word + 1] = (array[word + 1] & ~(mask >> shift)) | (value >> shift);
+        }
+    }
+
+    // NUM_OF_KEYS個のキーを格納する要素の数 Number of words holding NUM_OF_KEYS keys
+    template<uint16_t NUM_OF_KEYS>
+    constexpr inline uint16_t calcKeyboardSize() { return (NUM_OF_KEYS + READ_BITS - 1) / READ_BITS; }
+
+    // word番目の要素のうち、実在するキーのビット The bits of word that belong to existing keys
+    template<uint16_t NUM_OF_KEYS>
+    constexpr inline Word validBits(const uint16_t word) {
+        return ((word + 1) * READ_BITS <= NUM_OF_KEYS) ? ALL_BITS : lowBits(NUM_OF_KEYS % READ_BITS);
+    }
 }
 
 template<uint16_t NUM_OF_KEYS>
 class KeyReader {
 public:
-    static constexpr uint8_t KEYBOARD_SIZE = ReaderData::calcKeyboardSize<NUM_OF_KEYS>();
+    static constexpr uint16_t KEYBOARD_SIZE = ReaderData::calcKeyboardSize<NUM_OF_KEYS>();
     static constexpr uint16_t getNumOfKeys() { return NUM_OF_KEYS; }
 
-    virtual uint32_t (&getStateData())[KEYBOARD_SIZE] = 0;
+    virtual ReaderData::Word (&getStateData())[KEYBOARD_SIZE] = 0;
 
     virtual void read() = 0;
 
+    // 入力が変化するか、timeout(us)が過ぎるまで眠る 眠った場合はtrueを返す
+    // Sleeps until the input may have changed or timeout us have passed, and returns true if it slept.
+    // Readers that poll the pins cannot tell when the input changes and return false at once.
+    virtual bool wait(const uint32_t /*timeout*/) { return false; }
+
     virtual ~KeyReader() = default;
 };
 
@@ -46,7 +46,7 @@ public:
         }
     }
 
-    uint32_t (&getStateData())[KeyReader<ROWS * COLS>::KEYBOARD_SIZE] { return keys_; }
+    ReaderData::Word (&getStateData())[KeyReader<ROWS * COLS>::KEYBOARD_SIZE] { return keys_; }
 
     void read() {
         uint16_t index = 0;
@@ -54,8 +54,9 @@ public:
         for (const uint8_t rowPin : ROW_PINS) {
             digitalWrite(rowPin, LOW);
             for (const uint8_t colPin : COL_PINS) {
-                //The status is written in order from LSB, and the index of keys is increased by one for each READ_BIT (32 in this case).
-                //If the 33rd key is pressed, index / Matrix::READ_BITS = 1, index % Matrix::READ_BITS - 1 = 2, so the second bit of the second element is 1.
+                //The status is written in order from LSB; each word of keys_ holds ReaderData::READ_BITS keys.
+                //The 33rd key (index 32) is bit index % READ_BITS of word index / READ_BITS: bit 0 of keys_[1] with
+                //READ_BITS = 32, bit 32 of keys_[0] with MMZ_READ_BITS=64.
                 ReaderData::setState(keys_, index, !digitalRead(colPin));
 
                 index++;
@@ -68,7 +69,7 @@ private:
     const uint8_t (&ROW_PINS)[ROWS];
     const uint8_t (&COL_PINS)[COLS];
 
-    uint32_t keys_[KeyReader<ROWS * COLS>::KEYBOARD_SIZE];
+    ReaderData::Word keys_[KeyReader<ROWS * COLS>::KEYBOARD_SIZE];
 };
 
 #endif
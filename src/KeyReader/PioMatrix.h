@@ -0,0 +1,342 @@
+#ifndef MMZ_PIO_MATRIX_H
+#define MMZ_PIO_MATRIX_H
+
+#include <Arduino.h>
+#include "KeyReader.h"
+#include "Port.h"
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <hardware/clocks.h>
+#endif
+
+namespace PioData {
+    // PIOの命令の符号化 Encodings of the PIO instructions used by the matrix program
+    // NULL_SRCはPIOのnull(Layer.hのNONEマクロと衝突しない名前) NULL_SRC is the PIO null source, named so it does not clash with NONE in Layer.h.
+    enum Reg : uint8_t { PINS = 0, X = 1, Y = 2, NULL_SRC = 3, PINDIRS = 4, ISR = 6, OSR = 7 };
+
+    constexpr uint16_t jmp(const uint8_t address) { return 0x0000 | address; }
+    constexpr uint16_t jmpXDec(const uint8_t address) { return 0x0040 | address; }
+    constexpr uint16_t in(const Reg source, const uint8_t bits) { return 0x4000 | (source << 5) | (bits & 0x1F); }
+    constexpr uint16_t out(const Reg destination, const uint8_t bits) { return 0x6000 | (destination << 5) | (bits & 0x1F); }
+    constexpr uint16_t mov(const Reg destination, const Reg source) { return 0xA000 | (destination << 5) | source; }
+    constexpr uint16_t movInvert(const Reg destination, const Reg source) { return 0xA008 | (destination << 5) | source; }
+    constexpr uint16_t movReverse(const Reg destination, const Reg source) { return 0xA010 | (destination << 5) | source; }
+    constexpr uint16_t set(const Reg destination, const uint8_t value) { return 0xE000 | (destination << 5) | (value & 0x1F); }
+    constexpr uint16_t delay(const uint16_t instruction, const uint8_t cycles) { return instruction | ((cycles & 0x1F) << 8); }
+
+    // 行を一つずつLOWにして列を読み取るPIOのプログラム
+    // The PIO program that scans the matrix. One state machine cycle is 1 us.
+    // The row pins idle as inputs and only the selected row is made an output driving LOW (the column
+    // pins have pull-ups), so pressed keys read LOW and are inverted. Results are pushed with autopush, shifting right:
+    // when COLS divides 32 the rows pack into the state words exactly as KeyReader expects
+    // (key row * COLS + col), otherwise every row is padded to a word of its own.
+    struct Program {
+        static constexpr uint8_t MAX_LENGTH = 16;
+
+        uint16_t instructions[MAX_LENGTH];
+        uint8_t length;
+        uint8_t wrapTarget, wrap; //wrapの後はwrapTargetへ戻る Execution continues at wrapTarget after wrap
+        uint8_t outBase, outCount, inBase, inCount;
+
+        // 一回のスキャンでpushされるワード数 Words pushed per scan
+        uint16_t words;
+    };
+
+    // 連続したcount個のピンのマスク Mask of count consecutive pins starting at base
+    constexpr uint32_t toMask(const uint8_t base, const uint8_t count) {
+        return ((count >= 32) ? UINT32_MAX : ((1UL << count) - 1)) << base;
+    }
+
+    inline Program buildMatrixProgram(const uint8_t rowBase, const uint8_t rows, const uint8_t colBase, const uint8_t cols, uint8_t settleMicros) {
+        if (settleMicros < 1) { settleMicros = 1; }
+        if (settleMicros > 32) { settleMicros = 32; }
+
+        const bool packed = (32 % cols) == 0;
+        const uint16_t bits = rows * cols;
+        const uint8_t pad = (32 - (bits % 32)) % 32;
+
+        Program program = {};
+        uint8_t& n = program.length;
+        //yは選択する行のビットを反転した位置に持つ(右シフトで次の行へ進められる)
+        //Y holds the selected row bit-reversed, so that a right shift through the OSR moves to the next row.
+        program.instructions[n++] = set(Y, 1);
+        program.instructions[n++] = movReverse(Y, Y);
+        program.instructions[n++] = set(X, rows - 1);
+        const uint8_t row = n;
+        program.instructions[n++] = movReverse(OSR, Y);
+        program.instructions[n++] = out(PINDIRS, rows);
+        program.instructions[n++] = delay(mov(Y, Y), settleMicros - 1);
+        program.instructions[n++] = movInvert(OSR, PINS);
+        program.instructions[n++] = in(OSR, cols);
+        if (!packed) { program.instructions[n++] = in(NULL_SRC, 32 - cols); }
+        program.instructions[n++] = mov(OSR, Y);
+        program.instructions[n++] = out(NULL_SRC, 1);
+        program.instructions[n++] = mov(Y, OSR);
+        program.instructions[n++] = jmpXDec(row);
+        if (packed && (pad != 0)) { program.instructions[n++] = in(NULL_SRC, pad); }
+
+        program.wrapTarget = 0;
+        program.wrap = n - 1;
+        program.outBase = rowBase;
+        program.outCount = rows;
+        program.inBase = colBase;
+        program.inCount = cols;
+        program.words = (packed) ? (bits + 31) / 32 : rows;
+        return program;
+    }
+}
+
+// PIOのプログラムをソフトウェアで実行するモデル(PCでのテストや、PIOがない環境用)
+// A software model of a PIO state machine running the matrix program against a port, so the program
+// can be checked on a PC against Matrix::read(). sync() runs it until one scan has been pushed.
+// Only the instructions emitted by PioData::buildMatrixProgram() are modelled.
+template<typename PORT = DefaultPort>
+class PioModel {
+public:
+    bool start(const PioData::Program& program, volatile uint32_t* frame) {
+        program_ = program;
+        frame_ = frame;
+        pc_ = program.wrapTarget;
+        rowMask_ = PioData::toMask(program.outBase, program.outCount);
+        PORT::setPullUps(rowMask_ | PioData::toMask(program.inBase, program.inCount));
+        return true;
+    }
+
+    void sync() {
+        for (uint16_t pushed = 0; pushed < program_.words; ) {
+            const uint16_t instruction = program_.instructions[pc_];
+            pc_ = (pc_ == program_.wrap) ? program_.wrapTarget : pc_ + 1;
+            if (execute(instruction)) { frame_[pushed++] = isr_; isr_ = 0; isrCount_ = 0; }
+
+            const uint8_t cycles = (instruction >> 8) & 0x1F;
+            if (cycles != 0) { delayMicroseconds(cycles); }
+        }
+    }
+
+private:
+    // 命令を実行し、autopushした場合はtrueを返す Executes one instruction and returns true on an autopush.
+    bool execute(const uint16_t instruction) {
+        const uint8_t destination = (instruction >> 5) & 0x07;
+        const uint8_t source = instruction & 0x07;
+        const uint8_t bits = ((instruction & 0x1F) == 0) ? 32 : (instruction & 0x1F);
+
+        switch (instruction >> 13) {
+            case 0: //JMP
+                if ((destination == 2) && (x_-- == 0)) { return false; }
+                pc_ = instruction & 0x1F;
+                return false;
+            case 2: { //IN
+                const uint32_t data = read(destination);
+                isr_ = (bits == 32) ? data : ((isr_ >> bits) | (data << (32 - bits)));
+                isrCount_ += bits;
+                return isrCount_ >= 32;
+            }
+            case 3: { //OUT
+                const uint32_t data = (bits == 32) ? osr_ : (osr_ & ((1UL << bits) - 1));
+                osr_ = (bits == 32) ? 0 : (osr_ >> bits);
+                if (destination == PioData::PINDIRS) { setRows(data); }
+                return false;
+            }
+            case 5: { //MOV
+                uint32_t data = read(source);
+                if (((instruction >> 3) & 0x03) == 1) { data = ~data; }
+                if (((instruction >> 3) & 0x03) == 2) { data = reverse(data); }
+                write(destination, data);
+                return false;
+            }
+            case 7: //SET
+                write(destination, instruction & 0x1F);
+                return false;
+        }
+        return false;
+    }
+
+    // 選択した行のみLOWを出力する Only the selected rows drive LOW, the others are inputs.
+    void setRows(const uint32_t data) {
+        const uint32_t outputs = rotate(data, 32 - program_.outBase) & rowMask_;
+        PORT::setPullUps(rowMask_ & ~outputs);
+        PORT::setOutputs(outputs);
+        PORT::clear(outputs);
+    }
+
+    uint32_t read(const uint8_t source) const {
+        switch (source) {
+            case PioData::PINS: return rotate(PORT::read(), program_.inBase);
+            case PioData::X: return x_;
+            case PioData::Y: return y_;
+            case PioData::ISR: return isr_;
+            case PioData::OSR: return osr_;
+        }
+        return 0;
+    }
+    void write(const uint8_t destination, const uint32_t data) {
+        switch (destination) {
+            case PioData::X: x_ = data; break;
+            case PioData::Y: y_ = data; break;
+            case PioData::ISR: isr_ = data; isrCount_ = 0; break;
+            case PioData::OSR: osr_ = data; break;
+        }
+    }
+
+    static uint32_t rotate(const uint32_t value, const uint8_t shift) {
+        return ((shift % 32) == 0) ? value : ((value >> (shift % 32)) | (value << (32 - (shift % 32))));
+    }
+    static uint32_t reverse(uint32_t value) {
+        uint32_t result = 0;
+        for (uint8_t i = 0; i < 32; i++) {
+            result = (result << 1) | (value & 1);
+            value >>= 1;
+        }
+        return result;
+    }
+
+    PioData::Program program_ = {};
+    volatile uint32_t* frame_ = nullptr;
+    uint32_t rowMask_ = 0;
+    uint32_t x_ = 0, y_ = 0, isr_ = 0, osr_ = 0;
+    uint8_t isrCount_ = 0, pc_ = 0;
+};
+
+#if defined(ARDUINO_ARCH_RP2040)
+
+// RP2040/RP2350のPIOでプログラムを実行し、DMAでスキャン結果をバッファへ書き続ける
+// Runs the program on a PIO state machine, and two DMA channels copy every scan into the frame buffer
+// forever: one moves the words from the RX FIFO, the other rewinds its write address when a scan is complete.
+// The CPU is not involved in scanning at all; sync() has nothing to do.
+class PioScanner {
+public:
+    PioScanner(PIO pio = pio0) : pio_(pio) {}
+
+    bool start(const PioData::Program& program, volatile uint32_t* frame) {
+        //命令はpio_add_program()でPIOのメモリへ複製されるため、programはこの関数の中でのみ参照する
+        //pio_add_program() copies the instructions into the PIO's memory, so program is only referenced here.
+        const pio_program_t instructions = { program.instructions, program.length, -1 };
+        if (!pio_can_add_program(pio_, &instructions)) { return false; }
+
+        //ピンを変更する前にすべて確保し、失敗した場合は確保した分を解放する
+        //Everything is claimed before any pin is touched, and released again if any claim fails.
+        const int sm = pio_claim_unused_sm(pio_, false);
+        if (sm < 0) { return false; }
+        const int data = dma_claim_unused_channel(false);
+        const int control = (data < 0) ? -1 : dma_claim_unused_channel(false);
+        if (control < 0) {
+            if (data >= 0) { dma_channel_unclaim(data); }
+            pio_sm_unclaim(pio_, sm);
+            return false;
+        }
+        sm_ = sm;
+        frameAddress_ = frame;
+        const uint offset = pio_add_program(pio_, &instructions);
+
+        const uint32_t rowMask = PioData::toMask(program.outBase, program.outCount);
+        for (uint8_t pin = program.outBase; pin < program.outBase + program.outCount; pin++) {
+            pio_gpio_init(pio_, pin);
+            gpio_disable_pulls(pin);
+        }
+        for (uint8_t pin = program.inBase; pin < program.inBase + program.inCount; pin++) {
+            pio_gpio_init(pio_, pin);
+            gpio_pull_up(pin);
+        }
+        pio_sm_set_pins_with_mask(pio_, sm_, 0, rowMask);
+        pio_sm_set_pindirs_with_mask(pio_, sm_, 0, rowMask);
+
+        pio_sm_config config = pio_get_default_sm_config();
+        sm_config_set_wrap(&config, offset + program.wrapTarget, offset + program.wrap);
+        sm_config_set_out_pins(&config, program.outBase, program.outCount);
+        sm_config_set_in_pins(&config, program.inBase);
+        sm_config_set_out_shift(&config, true, false, 32);
+        sm_config_set_in_shift(&config, true, true, 32);
+        sm_config_set_fifo_join(&config, PIO_FIFO_JOIN_RX);
+        sm_config_set_clkdiv(&config, clock_get_hz(clk_sys) / 1000000.0f);
+        pio_sm_init(pio_, sm_, offset + program.wrapTarget, &config);
+
+        dma_channel_config dataConfig = dma_channel_get_default_config(data);
+        channel_config_set_transfer_data_size(&dataConfig, DMA_SIZE_32);
+        channel_config_set_read_increment(&dataConfig, false);
+        channel_config_set_write_increment(&dataConfig, true);
+        channel_config_set_dreq(&dataConfig, pio_get_dreq(pio_, sm_, false));
+        channel_config_set_chain_to(&dataConfig, control);
+        dma_channel_configure(data, &dataConfig, frame, &pio_->rxf[sm_], program.words, false);
+
+        //書き込み先を戻して再び開始する Rewinds the write address, which also retriggers the data channel.
+        dma_channel_config controlConfig = dma_channel_get_default_config(control);
+        channel_config_set_transfer_data_size(&controlConfig, DMA_SIZE_32);
+        channel_config_set_read_increment(&controlConfig, false);
+        channel_config_set_write_increment(&controlConfig, false);
+        dma_channel_configure(control, &controlConfig, &dma_hw->ch[data].al2_write_addr_trig, &frameAddress_, 1, false);
+
+        dma_channel_start(data);
+        pio_sm_set_enabled(pio_, sm_, true);
+        return true;
+    }
+
+    void sync() {}
+
+private:
+    PIO pio_;
+    uint sm_ = 0;
+    volatile uint32_t* frameAddress_ = nullptr; //制御用チャネルが読む Read by the control channel
+};
+
+using DefaultPioBackend = PioScanner;
+
+#else
+
+using DefaultPioBackend = PioModel<>;
+
+#endif
+
+// Matrix と同じ配線を、PIOで読み取る(CPUはスキャン結果の変化を取り込むだけ)
+// Same wiring as Matrix, but the rows are strobed and the columns sampled by a PIO state machine
+// at a fixed rate with no CPU jitter, and DMA keeps the latest scan in a buffer. read() only copies the
+// words (or rows) that changed into the state words. The rows and the columns must each be consecutive
+// GPIOs starting at rowBase and colBase. On other platforms the program runs on PioModel instead.
+template<uint8_t ROWS, uint8_t COLS, typename BACKEND = DefaultPioBackend>
+class PioMatrix : public KeyReader<ROWS * COLS> {
+public:
+    static_assert((ROWS > 0) && (ROWS <= 32) && (COLS > 0) && (COLS <= 32), "'ROWS' and 'COLS' must be between 1 and 32.");
+    static constexpr bool PACKED = (32 % COLS) == 0; //行がそのまま状態のワードに収まる Rows pack into the state words
+    static constexpr uint16_t FRAME_SIZE = (PACKED) ? (ROWS * COLS + 31) / 32 : ROWS; //32ビットのワード数 In 32-bit words
+
+    // settleMicros: 行を駆動してから列を読むまでの待ち時間(1~32) Wait between driving a row and sampling the columns (1-32).
+    PioMatrix(const uint8_t rowBase, const uint8_t colBase, const uint8_t settleMicros=1, BACKEND backend=BACKEND())
+     : keys_{}, frame_{}, rows_{}, backend_(backend),
+       running_(backend_.start(PioData::buildMatrixProgram(rowBase, ROWS, colBase, COLS, settleMicros), frame_)) {}
+
+    ReaderData::Word (&getStateData())[KeyReader<ROWS * COLS>::KEYBOARD_SIZE] { return keys_; }
+
+    // PIOやDMAを確保できなかった場合はfalse False if no state machine or DMA channel was available
+    bool isRunning() const { return running_; }
+
+    void read() {
+        if (!running_) { return; }
+        backend_.sync();
+
+        if constexpr (PACKED) {
+            for (uint16_t i = 0; i < FRAME_SIZE; i++) {
+                if constexpr (ReaderData::READ_BITS == 32) { keys_[i] = frame_[i]; }
+                else { ReaderData::setBits(keys_, i * 32, 32, frame_[i]); }
+            }
+            return;
+        }
+
+        for (uint8_t row = 0; row < ROWS; row++) {
+            const uint32_t cols = frame_[row];
+            if (cols == rows_[row]) { continue; }
+            rows_[row] = cols;
+
+            ReaderData::setBits(keys_, row * COLS, COLS, cols);
+        }
+    }
+
+private:
+    ReaderData::Word keys_[KeyReader<ROWS * COLS>::KEYBOARD_SIZE];
+    volatile uint32_t frame_[FRAME_SIZE]; //DMAが書き込む最新のスキャン Latest scan, written by DMA
+    uint32_t rows_[ROWS];        //取り込み済みの行 Rows already copied into keys_
+    BACKEND backend_;
+    bool running_;
+};
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef MMZ_PORT_H
+#define MMZ_PORT_H
+
+#include <Arduino.h>
+#include "KeyReader.h"
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <hardware/gpio.h>
+#endif
+
+// GPIOをまとめて読み書きするためのポート
+// A port reads and writes whole GPIO words, bit n being GPIO n (only GPIO 0-31 can be used).
+// PortMatrix and PortDirect are templated on the port, so any type with these static functions works,
+// e.g. a mock on the host:
+//     static uint32_t read();                 // Input level of every pin.
+//     static void set(uint32_t mask);         // Drives the pins in mask HIGH.
+//     static void clear(uint32_t mask);       // Drives the pins in mask LOW.
+//     static void setOutputs(uint32_t mask);  // Makes the pins in mask outputs.
+//     static void setPullUps(uint32_t mask);  // Makes the pins in mask inputs with pull-up.
+
+#if defined(ARDUINO_ARCH_RP2040)
+
+// RP2040/RP2350のSIOレジスタを直接操作する
+// Accesses the RP2040/RP2350 SIO registers directly, one register access per call.
+struct SioPort {
+    static inline uint32_t read() { return gpio_get_all(); }
+    static inline void set(const uint32_t mask) { gpio_set_mask(mask); }
+    static inline void clear(const uint32_t mask) { gpio_clr_mask(mask); }
+
+    static void setOutputs(const uint32_t mask) {
+        for (uint8_t pin = 0; pin < 32; pin++) {
+            if (mask & (1UL << pin)) { pinMode(pin, OUTPUT); }
+        }
+    }
+    static void setPullUps(const uint32_t mask) {
+        for (uint8_t pin = 0; pin < 32; pin++) {
+            if (mask & (1UL << pin)) { pinMode(pin, INPUT_PULLUP); }
+        }
+    }
+};
+
+using DefaultPort = SioPort;
+
+#endif
+
+// digitalRead()/digitalWrite()で同じ操作を行う(SIOがない環境用)
+// Same operations through digitalRead()/digitalWrite(), for platforms without a faster port.
+struct ArduinoPort {
+    static uint32_t read() {
+        uint32_t value = 0;
+        for (uint8_t pin = 0; pin < 32; pin++) {
+            if ((inputs_ & (1UL << pin)) && digitalRead(pin)) { value |= (1UL << pin); }
+        }
+        return value;
+    }
+    static void set(const uint32_t mask) { write(mask, HIGH); }
+    static void clear(const uint32_t mask) { write(mask, LOW); }
+
+    static void setOutputs(const uint32_t mask) {
+        for (uint8_t pin = 0; pin < 32; pin++) {
+            if (mask & (1UL << pin)) { pinMode(pin, OUTPUT); }
+        }
+    }
+    static void setPullUps(const uint32_t mask) {
+        inputs_ |= mask;
+        for (uint8_t pin = 0; pin < 32; pin++) {
+            if (mask & (1UL << pin)) { pinMode(pin, INPUT_PULLUP); }
+        }
+    }
+
+private:
+    static void write(const uint32_t mask, const uint8_t level) {
+        for (uint8_t pin = 0; pin < 32; pin++) {
+            if (mask & (1UL << pin)) { digitalWrite(pin, level); }
+        }
+    }
+
+    inline static uint32_t inputs_ = 0;
+};
+
+#if !defined(ARDUINO_ARCH_RP2040)
+using DefaultPort = ArduinoPort;
+#endif
+
+namespace PortData {
+    // 連続したピンを連続したビットへ一度にコピーするための情報
+    // Consecutive pins that map to consecutive bits of the same word are copied with one shift and mask.
+    struct Run {
+        uint8_t pin;   // 最初のピン First pin of the run
+        uint16_t word; // コピー先の要素 Destination word
+        uint8_t digit; // コピー先の最初のビット Destination bit of the first pin
+        uint32_t mask; // ピン数分のマスク (1 << length) - 1
+    };
+
+    template<typename PINS>
+    inline uint32_t toMask(const PINS& pins) {
+        uint32_t mask = 0;
+        for (const uint8_t pin : pins) { mask |= (1UL << pin); }
+        return mask;
+    }
+
+    // pins[i]をfirstIndex + i番目のビットに対応させるRunの配列を作り、その数を返す
+    // Builds the runs that map pins[i] to bit (firstIndex + i) and returns their count.
+    template<typename PINS, typename RUNS>
+    inline uint8_t buildRuns(const PINS& pins, const uint16_t firstIndex, RUNS& runs) {
+        uint8_t count = 0;
+        uint16_t index = firstIndex;
+
+        for (const uint8_t pin : pins) {
+            const uint16_t word = ReaderData::getIndex(index);
+            const uint8_t digit = ReaderData::getDigit(index);
+
+            Run* last = (count > 0) ? &runs[count - 1] : nullptr;
+            const uint8_t length = (last != nullptr) ? __builtin_popcount(last->mask) : 0;
+
+            if ((last != nullptr) && (last->word == word) && (last->pin + length == pin) && (last->digit + length == digit)) {
+                last->mask = (last->mask << 1) | 1;
+            } else {
+                runs[count++] = { pin, word, digit, 1 };
+            }
+            index++;
+        }
+
+        return count;
+    }
+
+    // 負論理の入力をRunに従って配列に書き込む Scatters the active-low input into the words.
+    template<typename RUNS, typename WORDS>
+    inline void scatter(const uint32_t input, const RUNS& runs, const uint8_t count, WORDS& words) {
+        const uint32_t pressed = ~input;
+        for (uint8_t i = 0; i < count; i++) {
+            words[runs[i].word] |= static_cast<ReaderData::Word>((pressed >> runs[i].pin) & runs[i].mask) << runs[i].digit;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef MMZ_PORT_DIRECT_H
+#define MMZ_PORT_DIRECT_H
+
+#include "KeyReader.h"
+#include "Port.h"
+
+// Direct と同じ配線を、GPIO全体を一度読むだけで処理する
+// Same wiring as Direct, but reads every pin with a single port read and copies the bits with
+// shifts and masks precomputed in the constructor. Only GPIO 0-31 can be used.
+template<uint16_t NUM_OF_KEYS, typename PORT = DefaultPort>
+class PortDirect : public KeyReader<NUM_OF_KEYS> {
+public:
+    PortDirect(const uint8_t (&pins)[NUM_OF_KEYS])
+     : keys_{}, runs_{}, numOfRuns_(PortData::buildRuns(pins, 0, runs_)) {
+        PORT::setPullUps(PortData::toMask(pins));
+    }
+
+    ReaderData::Word (&getStateData())[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE] { return keys_; }
+
+    void read() {
+        ReaderData::Word next[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE] = {};
+        PortData::scatter(PORT::read(), runs_, numOfRuns_, next);
+
+        for (uint16_t i = 0; i < KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE; i++) { keys_[i] = next[i]; }
+    }
+
+private:
+    ReaderData::Word keys_[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE];
+    PortData::Run runs_[NUM_OF_KEYS];
+    uint8_t numOfRuns_;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef MMZ_PORT_MATRIX_H
+#define MMZ_PORT_MATRIX_H
+
+#include <Arduino.h>
+#include "KeyReader.h"
+#include "Port.h"
+
+// Matrix と同じ配線を、行ごとにGPIO全体を一度読むだけで処理する
+// Same wiring as Matrix, but each row is driven with one port write and all columns are sampled
+// with one port read; the column bits are gathered with shifts and masks precomputed in the constructor.
+// Only GPIO 0-31 can be used.
+template<uint8_t ROWS, uint8_t COLS, typename PORT = DefaultPort>
+class PortMatrix : public KeyReader<ROWS * COLS> {
+public:
+    static_assert((COLS > 0) && (COLS <= 32), "'COLS' must be between 1 and 32.");
+
+    // settleMicros: 行を駆動してから列を読むまでの待ち時間 Wait between driving a row and sampling the columns.
+    PortMatrix(const uint8_t (&rowPins)[ROWS], const uint8_t (&colPins)[COLS], const uint8_t settleMicros=1)
+     : keys_{}, colRuns_{}, numOfColRuns_(PortData::buildRuns(colPins, 0, colRuns_)), SETTLE_MICROS(settleMicros) {
+        for (uint8_t row = 0; row < ROWS; row++) { rowMasks_[row] = 1UL << rowPins[row]; }
+
+        const uint32_t rows = PortData::toMask(rowPins);
+        PORT::setOutputs(rows);
+        PORT::set(rows);
+        PORT::setPullUps(PortData::toMask(colPins));
+    }
+
+    ReaderData::Word (&getStateData())[KeyReader<ROWS * COLS>::KEYBOARD_SIZE] { return keys_; }
+
+    void read() {
+        ReaderData::Word next[KeyReader<ROWS * COLS>::KEYBOARD_SIZE] = {};
+        uint16_t index = 0;
+
+        for (uint8_t row = 0; row < ROWS; row++) {
+            PORT::clear(rowMasks_[row]);
+            if (SETTLE_MICROS != 0) { delayMicroseconds(SETTLE_MICROS); }
+            const uint32_t input = PORT::read();
+            PORT::set(rowMasks_[row]);
+
+            uint32_t cols[1] = { 0 };
+            PortData::scatter(input, colRuns_, numOfColRuns_, cols);
+
+            //行のビットを配列の該当位置に書き込む(要素の境界をまたぐ場合がある)
+            //Insert the row at its key index; a row may straddle two words.
+            ReaderData::setBits(next, index, COLS, cols[0]);
+
+            index += COLS;
+        }
+
+        for (uint16_t i = 0; i < KeyReader<ROWS * COLS>::KEYBOARD_SIZE; i++) { keys_[i] = next[i]; }
+    }
+
+private:
+    ReaderData::Word keys_[KeyReader<ROWS * COLS>::KEYBOARD_SIZE];
+    uint32_t rowMasks_[ROWS];
+    PortData::Run colRuns_[COLS];
+    uint8_t numOfColRuns_;
+    const uint8_t SETTLE_MICROS;
+};
+
+#endif
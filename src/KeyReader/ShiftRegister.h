@@ -0,0 +1,56 @@
+#ifndef MMZ_SHIFT_REGISTER_H
+#define MMZ_SHIFT_REGISTER_H
+
+#include <Arduino.h>
+#include "KeyReader.h"
+#include "Port.h"
+
+// 74HC165などの並列入力シフトレジスタ(カスケード接続可)を読み取る
+// Reads buttons through parallel-in/serial-out shift registers such as the 74HC165, chained to any length.
+// The buttons connect the register inputs to GND (with pull-up resistors), so a pressed key reads LOW.
+// Key i is the i-th bit shifted out: on a 74HC165, input H of the register nearest the MCU comes first.
+// The three control pins are driven with one port write each. Only GPIO 0-31 can be used.
+template<uint16_t NUM_OF_KEYS, typename PORT = DefaultPort>
+class ShiftRegister : public KeyReader<NUM_OF_KEYS> {
+public:
+    // pulseMicros: ラッチとクロックのパルス幅 Width of the load and clock pulses; 0 toggles back to back.
+    ShiftRegister(const uint8_t loadPin, const uint8_t clockPin, const uint8_t dataPin, const uint8_t pulseMicros=1)
+     : keys_{}, LOAD(1UL << loadPin), CLOCK(1UL << clockPin), DATA(1UL << dataPin), PULSE_MICROS(pulseMicros) {
+        PORT::setOutputs(LOAD | CLOCK);
+        PORT::set(LOAD);
+        PORT::clear(CLOCK);
+        PORT::setPullUps(DATA);
+    }
+
+    ReaderData::Word (&getStateData())[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE] { return keys_; }
+
+    void read() {
+        ReaderData::Word next[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE] = {};
+
+        //入力をラッチする Latch the parallel inputs.
+        PORT::clear(LOAD);
+        pulse();
+        PORT::set(LOAD);
+
+        for (uint16_t i = 0; i < NUM_OF_KEYS; i++) {
+            if (!(PORT::read() & DATA)) { next[ReaderData::getIndex(i)] |= ReaderData::bit(ReaderData::getDigit(i)); }
+
+            PORT::set(CLOCK);
+            pulse();
+            PORT::clear(CLOCK);
+        }
+
+        for (uint16_t i = 0; i < KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE; i++) { keys_[i] = next[i]; }
+    }
+
+private:
+    inline void pulse() const {
+        if (PULSE_MICROS != 0) { delayMicroseconds(PULSE_MICROS); }
+    }
+
+    ReaderData::Word keys_[KeyReader<NUM_OF_KEYS>::KEYBOARD_SIZE];
+    const uint32_t LOAD, CLOCK, DATA;
+    const uint8_t PULSE_MICROS;
+};
+
+#endif
@@ -1,45 +1,188 @@
 #ifndef MMZ_KEYBOARD_H_UTIL_H
 #define MMZ_KEYBOARD_H_UTIL_H
 
+#include <initializer_list>
+
 #include "Key.h"
+#include "Combo.h"
+#include "Stats.h"
+#include "HidBatch.h"
+#include "Typing.h"
+
+// マクロのキー入力 MMZ_HID_BATCHが有効な場合はHidBatchを経由する
+// Key presses of the macros below; they go through HidBatch when MMZ_HID_BATCH is enabled.
+inline void hidPress(const uint8_t code) {
+    if constexpr (HidBatch::ENABLED) { HidBatch::press(code); }
+    else { Keyboard.press(code); }
+}
+inline void hidRelease(const uint8_t code) {
+    if constexpr (HidBatch::ENABLED) { HidBatch::release(code); }
+    else { Keyboard.release(code); }
+}
+// レポートを送信した直後に呼ぶ HidBatchを経由する場合は、実際に送信するflush()が記録する
+// Call right after hidPress()/hidRelease(); with HidBatch the report is recorded by flush(), when it is sent.
+inline void hidReported() {
+    if constexpr (!HidBatch::ENABLED) { Stats::recordReport(); }
+}
+
+// Keyboardライブラリへ送信する(キーボードライブラリの制約により、変化したキーごとに送信される)
+// Sends batched reports through the Keyboard library. The library sends one report per changed key,
+// so this only paces the reports to one batch per frame; use a sink that writes whole reports
+// (e.g. TinyUsbHidSink) to get one report per batch.
+class KeyboardHidSink : public HidSink {
+public:
+    KeyboardHidSink() : last_{} {}
+
+    void send(const HidReport& report) override {
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            const uint8_t mask = 1U << bit;
+            if ((report.modifiers ^ last_.modifiers) & mask) { apply(0x80 + bit, report.modifiers & mask); }
+        }
+        //KEY_*のコードで表せる使用法のみ Only usages that a KEY_* code can express (up to 0x77)
+        for (uint8_t usage = 1; usage <= 0x77; usage++) {
+            if (report.isPressed(usage) != last_.isPressed(usage)) { apply(usage + 0x88, report.isPressed(usage)); }
+        }
+        last_ = report;
+    }
+
+private:
+    static void apply(const uint8_t code, const bool pressed) {
+        if (pressed) { Keyboard.press(code); }
+        else { Keyboard.release(code); }
+    }
+
+    HidReport last_;
+};
+
+// Adafruit TinyUSBのHIDへ一つのレポートとして送信する(ブートプロトコル、6KRO)
+// Sends each batch as one boot protocol (6KRO) report through an Adafruit TinyUSB HID device,
+// e.g. TinyUsbHidSink<Adafruit_USBD_HID> sink(usbHid);
+template<typename HID>
+class TinyUsbHidSink : public HidSink {
+public:
+    TinyUsbHidSink(HID& hid, const uint8_t reportId=0) : hid_(hid), REPORT_ID(reportId) {}
+
+    bool ready() override { return hid_.ready(); }
+
+    void send(const HidReport& report) override {
+        uint8_t keys[6];
+        report.toBoot(keys);
+        hid_.keyboardReport(REPORT_ID, report.modifiers, keys);
+    }
+
+private:
+    HID& hid_;
+    const uint8_t REPORT_ID;
+};
+
+// 文字列をスキャンを止めずに入力する(Keyboard.print()の代わり) 文字列はコピーされない
+// Types the text a few keys per update() instead of blocking like Keyboard.print(); the text is not
+// copied, so pass a string literal or another string that outlives the typing.
+inline TypingHandle typeText(const char* text) {
+    Typing::setOutput(hidPress, hidRelease);
+    return Typing::type(text);
+}
 
 inline Macro pressTo(uint8_t pressKey) {
-    return [pressKey](Key key) {
+    return Macro([pressKey](const Key& key) {
         if (key.hasOccurred(Key::Event::RISING_EDGE)) {
-            Keyboard.press(pressKey);
+            hidPress(pressKey);
+            hidReported();
         } else if (key.hasOccurred(Key::Event::FALLING_EDGE)) {
-            Keyboard.release(pressKey);
+            hidRelease(pressKey);
+            hidReported();
         }
-    };
+    }, Key::mask(Key::Event::RISING_EDGE, Key::Event::FALLING_EDGE));
 }
 
 inline Macro mod(uint8_t tap, uint8_t hold) {
-    return [tap, hold](Key key) {
+    return Macro([tap, hold](const Key& key) {
         if (key.hasOccurred(Key::Event::TAP)) {
-            Keyboard.press(tap);
-            Keyboard.release(tap);
+            hidPress(tap);
+            hidReported();
+            hidRelease(tap);
         } else {
             if (key.hasOccurred(Key::Event::HOLD)) {
-                Keyboard.press(hold);
+                hidPress(hold);
+                hidReported();
             }
             if (key.hasOccurred(Key::Event::FALLING_EDGE)) {
-                Keyboard.release(hold);
+                hidRelease(hold);
+                hidReported();
             }
         }
-    };
+    }, Key::mask(Key::Event::TAP, Key::Event::HOLD, Key::Event::FALLING_EDGE));
 }
+// マクロを組み合わせたmod()の数 Number of mod(Macro, Macro) that can be created.
+#ifndef MMZ_MOD_MACRO_POOL_SIZE
+#define MMZ_MOD_MACRO_POOL_SIZE 8
+#endif
+
+// 二つのマクロはプールに置き、マクロはその位置だけを保持する(MMZ_MACRO_STORAGE_SIZEに収まるように)
+// Two macros never fit in one macro's storage, so they live in a pool of MMZ_MOD_MACRO_POOL_SIZE
+// pairs and the macro only captures a pointer to its pair; the pool is linked only when this
+// overload is used. Returns NONE once the pool is full.
 inline Macro mod(Macro tap, Macro hold) {
-    return [tap, hold](Key key) {
+    struct Pair { Macro tap, hold; };
+    static Pair pool[MMZ_MOD_MACRO_POOL_SIZE];
+    static uint8_t numOfPairs = 0;
+    if (numOfPairs >= MMZ_MOD_MACRO_POOL_SIZE) { return nullptr; }
+
+    Pair* pair = &pool[numOfPairs++];
+    pair->tap = tap;
+    pair->hold = hold;
+    return Macro([pair](const Key& key) {
         if (key.hasOccurred(Key::Event::TAP)) {
-            tap(key);
+            pair->tap(key);
         } else if (key.hasOccurred(Key::Event::HOLD)) {
-            hold(key);
+            pair->hold(key);
+        }
+    }, Key::mask(Key::Event::TAP, Key::Event::HOLD));
+}
+
+// キーが押されたときに文字列を入力する Types the text when the key goes down.
+inline Macro typeTo(const char* text) {
+    return Macro([text](const Key& key) {
+        if (key.hasOccurred(Key::Event::RISING_EDGE)) { typeText(text); }
+    }, Key::mask(Key::Event::RISING_EDGE));
+}
+
+// 押している間キーリピートする(MMZ_TYPING_REPEAT_DELAYの後、入力の速さで繰り返す)
+// Taps the key, then repeats it at the typing rate after MMZ_TYPING_REPEAT_DELAY while held.
+inline Macro repeatTo(uint8_t repeatKey) {
+    return Macro([repeatKey](const Key& key) {
+        if (key.hasOccurred(Key::Event::RISING_EDGE)) {
+            Typing::setOutput(hidPress, hidRelease);
+            Typing::repeat(repeatKey);
+        } else if (key.hasOccurred(Key::Event::FALLING_EDGE)) {
+            Typing::cancelRepeat(repeatKey);
         }
-    };
+    }, Key::mask(Key::Event::RISING_EDGE, Key::Event::FALLING_EDGE));
 }
 
+// 複数のキーを同時に押す(修飾キーとの組み合わせやコンボのマクロ用)
+// Presses every keycode while the key is held, e.g. pressTo({KEY_LEFT_CTRL, 'c'}) as a combo's macro.
+inline Macro pressTo(std::initializer_list<uint8_t> pressKeys) {
+    struct Keycodes {
+        uint8_t codes[MMZ_COMBO_MAX_KEYS];
+        uint8_t size;
+    } keycodes = {};
+
+    for (const uint8_t code : pressKeys) {
+        if (keycodes.size >= MMZ_COMBO_MAX_KEYS) { break; }
+        keycodes.codes[keycodes.size++] = code;
+    }
 
-//inline Macro combo(uint8_t a, uint8_t b, )
+    return Macro([keycodes](const Key& key) {
+        if (key.hasOccurred(Key::Event::RISING_EDGE)) {
+            for (uint8_t i = 0; i < keycodes.size; i++) { hidPress(keycodes.codes[i]); }
+            hidReported();
+        } else if (key.hasOccurred(Key::Event::FALLING_EDGE)) {
+            for (uint8_t i = keycodes.size; i > 0; i--) { hidRelease(keycodes.codes[i - 1]); }
+            hidReported();
+        }
+    }, Key::mask(Key::Event::RISING_EDGE, Key::Event::FALLING_EDGE));
+}
 
 #endif
 
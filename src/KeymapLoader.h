@@ -0,0 +1,373 @@
+#ifndef MMZ_KEYMAP_LOADER_H
+#define MMZ_KEYMAP_LOADER_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <initializer_list>
+
+#include "Action.h"
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#error "KeymapImage reads the action words in place and needs a little-endian CPU."
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 読み込みに失敗した理由 Why a keymap was rejected
+enum class KeymapError : uint8_t {
+    OK,        //正常 Valid
+    TOO_SHORT, //データが短い The data ends before the header or the actions do
+    MAGIC,     //"MMZK"ではない Not a keymap
+    VERSION,   //未対応のバージョン Unsupported version
+    SHAPE,     //キーやレイヤーの数が異なる The number of keys or layers differs from the MacroPad's
+    ACTION,    //不正なAction(範囲外のレイヤーや未登録のマクロなど) An invalid action, e.g. an unknown layer or macro
+    CHECKSUM,  //チェックサムが一致しない The checksum does not match
+    ALIGNMENT, //アドレスが2バイト境界にない The image does not start on a 2-byte boundary
+    READ,      //ファイルの読み込みに失敗した A file read or seek failed
+};
+
+// キーマップのバイナリ形式(リトルエンディアン)
+// The binary keymap format, little-endian:
+//     "MMZK", version (1), header size (1, 16), number of keys (2), layers (1), profiles (1),
+//     number of macro IDs used (2), Fletcher-16 of the actions (2), reserved (2, 0),
+//     then the 16-bit Action words of every profile, layer and key in that order.
+// The actions of a profile are contiguous, so an image in flash is used without copying.
+// extras/keymap_encoder.py writes this format; write() writes it from an ActionProfiles.
+namespace KeymapFormat {
+    static constexpr uint8_t VERSION = 1;
+    static constexpr uint8_t HEADER_SIZE = 16;
+
+    struct Header {
+        uint16_t numOfKeys;
+        uint8_t numOfLayers;
+        uint8_t numOfProfiles;
+        uint16_t numOfMacros;
+        uint16_t checksum;
+
+        uint32_t getProfileSize() const { return static_cast<uint32_t>(numOfKeys) * numOfLayers; }
+        uint32_t getNumOfActions() const { return getProfileSize() * numOfProfiles; }
+    };
+
+    inline uint16_t get16(const uint8_t* bytes) { return bytes[0] | (static_cast<uint16_t>(bytes[1]) << 8); }
+
+    // ヘッダーを読み取り、MacroPadの形(キーとレイヤーの数)と一致するか確かめる
+    // Parses the header and checks it against the MacroPad's number of keys and layers.
+    inline KeymapError parseHeader(const uint8_t (&bytes)[HEADER_SIZE], const uint16_t numOfKeys, const uint8_t numOfLayers, Header& header) {
+        if ((bytes[0] != 'M') || (bytes[1] != 'M') || (bytes[2] != 'Z') || (bytes[3] != 'K')) { return KeymapError::MAGIC; }
+        if ((bytes[4] != VERSION) || (bytes[5] != HEADER_SIZE)) { return KeymapError::VERSION; }
+
+        header.numOfKeys = get16(&bytes[6]);
+        header.numOfLayers = bytes[8];
+        header.numOfProfiles = bytes[9];
+        header.numOfMacros = get16(&bytes[10]);
+        header.checksum = get16(&bytes[12]);
+
+        if ((header.numOfKeys != numOfKeys) || (header.numOfLayers != numOfLayers) || (header.numOfProfiles == 0)) { return KeymapError::SHAPE; }
+        return KeymapError::OK;
+    }
+
+    // Actionを一つずつ検査し、チェックサムを計算する(メモリを確保しない一回の走査)
+    // Checks the actions one by one while summing them, so a keymap is validated in one pass
+    // without allocating. Layer and profile arguments must be in range, macro IDs below the header's
+    // count, and the header's count must not exceed the number of registered macros.
+    class Checker {
+    public:
+        Checker(const Header& header, const uint16_t numOfMacros)
+         : header_(header), valid_(header.numOfMacros <= numOfMacros), sum1_(0), sum2_(0) {}
+
+        bool add(const uint16_t word) {
+            sum(word & 0xFF);
+            sum(word >> 8);
+            if (!isValid(Action(word))) { valid_ = false; }
+            return valid_;
+        }
+
+        bool isValid() const { return valid_; }
+        uint16_t getChecksum() const { return (sum2_ << 8) | sum1_; }
+
+    private:
+        bool isValid(const Action action) const {
+            const uint16_t argument = action.getArgument();
+            switch (action.getType()) {
+                case Action::Type::EMPTY:
+                case Action::Type::THROUGH:
+                case Action::Type::LAYER_RESET:
+                case Action::Type::PROFILE_RESET:
+                    return argument == 0;
+                case Action::Type::KEY:
+                    return argument <= 0xFF;
+                case Action::Type::MOD_TAP:
+                    return argument <= 0x7FF;
+                case Action::Type::LAYER_TO:
+                case Action::Type::LAYER_BACK:
+                case Action::Type::LAYER_HOLD:
+                case Action::Type::LAYER_TOGGLE:
+                    return argument < header_.numOfLayers;
+                case Action::Type::PROFILE_TO:
+                case Action::Type::PROFILE_BACK:
+                    return argument < header_.numOfProfiles;
+                case Action::Type::MACRO:
+                    return argument < header_.numOfMacros;
+                default:
+                    return false;
+            }
+        }
+
+        inline void sum(const uint8_t value) {
+            sum1_ = (sum1_ + value) % 255;
+            sum2_ = (sum2_ + sum1_) % 255;
+        }
+
+        const Header& header_;
+        bool valid_;
+        uint16_t sum1_, sum2_;
+    };
+
+    // ActionProfilesをこの形式でoutへ書き込む(ファイルやSerialへ保存する場合など)
+    // Writes keymaps of actions in this format, e.g. to save the built-in keymap to a file.
+    //テンプレート引数はstd::arrayの大きさ(size_t)から推論される The sizes are deduced from the std::array types.
+    template<size_t NUM_OF_KEYS, size_t NUM_OF_LAYERS, size_t NUM_OF_PROFILES>
+    void write(Print& out, const std::array<std::array<std::array<Action, NUM_OF_KEYS>, NUM_OF_LAYERS>, NUM_OF_PROFILES>& profiles) {
+        static_assert((NUM_OF_KEYS < UINT16_MAX) && (NUM_OF_LAYERS <= UINT8_MAX) && (NUM_OF_PROFILES <= UINT8_MAX), "The keymap is too large.");
+
+        uint16_t numOfMacros = 0;
+        uint16_t sum1 = 0, sum2 = 0;
+        for (const auto& layers : profiles) {
+            for (const auto& keymap : layers) {
+                for (const Action action : keymap) {
+                    if (action.isMacro() && (action.getArgument() >= numOfMacros)) { numOfMacros = action.getArgument() + 1; }
+                    for (const uint8_t value : { static_cast<uint8_t>(action.getWord() & 0xFF), static_cast<uint8_t>(action.getWord() >> 8) }) {
+                        sum1 = (sum1 + value) % 255;
+                        sum2 = (sum2 + sum1) % 255;
+                    }
+                }
+            }
+        }
+
+        const uint16_t checksum = (sum2 << 8) | sum1;
+        const uint8_t header[HEADER_SIZE] = {
+            'M', 'M', 'Z', 'K', VERSION, HEADER_SIZE,
+            static_cast<uint8_t>(NUM_OF_KEYS & 0xFF), static_cast<uint8_t>(NUM_OF_KEYS >> 8), static_cast<uint8_t>(NUM_OF_LAYERS), static_cast<uint8_t>(NUM_OF_PROFILES),
+            static_cast<uint8_t>(numOfMacros & 0xFF), static_cast<uint8_t>(numOfMacros >> 8),
+            static_cast<uint8_t>(checksum & 0xFF), static_cast<uint8_t>(checksum >> 8), 0, 0
+        };
+        for (const uint8_t value : header) { out.write(value); }
+
+        for (const auto& layers : profiles) {
+            for (const auto& keymap : layers) {
+                for (const Action action : keymap) {
+                    out.write(static_cast<uint8_t>(action.getWord() & 0xFF));
+                    out.write(static_cast<uint8_t>(action.getWord() >> 8));
+                }
+            }
+        }
+    }
+}
+
+// メモリ上(フラッシュの領域やmmapしたファイル)のキーマップをコピーせずに使う
+// Uses a keymap image in addressable memory without copying it: a region of flash (on the RP2040,
+// XIP_BASE + offset), a const array compiled into the sketch, or a memory-mapped file on a PC.
+// The image is validated once when it is opened; load() then only computes a pointer.
+// The image must start on a 2-byte boundary and outlive the MacroPad. Little-endian MCUs only.
+template<uint16_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS>
+class KeymapImage : public ActionSource<NUM_OF_KEYS, NUM_OF_LAYERS> {
+public:
+    // numOfMacros: 登録したマクロの数(Action::macro(i)のiはこれ未満) Number of registered macros
+    KeymapImage(const void* data, const uint32_t size, const uint16_t numOfMacros=0) : KeymapImage() { open(data, size, numOfMacros); }
+
+    bool open(const void* data, const uint32_t size, const uint16_t numOfMacros=0) {
+        actions_ = nullptr;
+        error_ = validate(static_cast<const uint8_t*>(data), size, numOfMacros);
+        if (error_ == KeymapError::OK) {
+            actions_ = reinterpret_cast<const Action*>(static_cast<const uint8_t*>(data) + KeymapFormat::HEADER_SIZE);
+        }
+        return isValid();
+    }
+
+    const Action* load(const uint8_t profile) override {
+        if (!isValid() || (profile >= header_.numOfProfiles)) { return nullptr; }
+        return actions_ + static_cast<uint32_t>(profile) * PROFILE_SIZE;
+    }
+
+    uint8_t getNumOfProfiles() const override { return isValid() ? header_.numOfProfiles : 0; }
+    bool isValid() const { return error_ == KeymapError::OK; }
+    KeymapError getError() const { return error_; }
+
+protected:
+    KeymapImage() : header_{}, actions_(nullptr), error_(KeymapError::TOO_SHORT) {}
+
+private:
+    static constexpr uint32_t PROFILE_SIZE = static_cast<uint32_t>(NUM_OF_KEYS) * NUM_OF_LAYERS;
+
+    KeymapError validate(const uint8_t* data, const uint32_t size, const uint16_t numOfMacros) {
+        if ((data == nullptr) || (size < KeymapFormat::HEADER_SIZE)) { return KeymapError::TOO_SHORT; }
+        if (reinterpret_cast<uintptr_t>(data) % alignof(Action) != 0) { return KeymapError::ALIGNMENT; }
+
+        uint8_t bytes[KeymapFormat::HEADER_SIZE];
+        for (uint8_t i = 0; i < KeymapFormat::HEADER_SIZE; i++) { bytes[i] = data[i]; }
+        const KeymapError error = KeymapFormat::parseHeader(bytes, NUM_OF_KEYS, NUM_OF_LAYERS, header_);
+        if (error != KeymapError::OK) { return error; }
+
+        const uint32_t count = header_.getNumOfActions();
+        if ((size - KeymapFormat::HEADER_SIZE) / 2 < count) { return KeymapError::TOO_SHORT; }
+
+        KeymapFormat::Checker checker(header_, numOfMacros);
+        const uint8_t* words = data + KeymapFormat::HEADER_SIZE;
+        for (uint32_t i = 0; i < count; i++) {
+            if (!checker.add(KeymapFormat::get16(&words[i * 2]))) { return KeymapError::ACTION; }
+        }
+        return (checker.getChecksum() == header_.checksum) ? KeymapError::OK : KeymapError::CHECKSUM;
+    }
+
+    KeymapFormat::Header header_;
+    const Action* actions_;
+    KeymapError error_;
+};
+
+// ファイル(LittleFSなど)から選択されたプロファイルのみを読み込む
+// Pages the selected profile in from a file, e.g. on LittleFS, so only PAGES (2 by default) pages of
+// NUM_OF_LAYERS * NUM_OF_KEYS * 2 bytes are in RAM: the profile in use, and a scratch page that the next
+// profile is read into and that is swapped in only once it has been read and checked, so a failed read
+// never touches the keymap in use. The whole file is validated once when it is opened, reading it in
+// small chunks. FILE_TYPE is fs::File or any type with
+//     bool seek(uint32_t position);
+//     size_t read(uint8_t* buffer, size_t size); // Returns the number of bytes read.
+// The file must stay open while it is attached. PAGES = 1 halves the RAM: the next profile is then
+// read over the one in use, and a failed read reads the profile in use back (or, if that also fails,
+// leaves every key empty) instead of leaving it untouched.
+template<uint16_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS, typename FILE_TYPE, uint8_t PAGES = 2>
+class KeymapFile : public ActionSource<NUM_OF_KEYS, NUM_OF_LAYERS> {
+public:
+    static_assert((PAGES == 1) || (PAGES == 2), "'PAGES' must be 1 or 2.");
+
+    KeymapFile(FILE_TYPE& file, const uint16_t numOfMacros=0)
+     : file_(file), header_{}, pages_{}, NUM_OF_MACROS(numOfMacros), current_(0), loaded_(NOT_LOADED), error_(validate()) {}
+
+    const Action* load(const uint8_t profile) override {
+        if (!isValid() || (profile >= header_.numOfProfiles)) { return nullptr; }
+        if (profile == loaded_) { return pages_[current_]; }
+
+        //予備のページに読み込み、成功した場合のみ入れ替える Read into the scratch page and swap only on success.
+        const uint8_t scratch = (PAGES == 2) ? (current_ ^ 1) : 0;
+        if (!read(profile, pages_[scratch])) {
+            if constexpr (PAGES == 1) { restore(); }
+            return nullptr;
+        }
+        current_ = scratch;
+        loaded_ = profile;
+        return pages_[current_];
+    }
+
+    uint8_t getNumOfProfiles() const override { return isValid() ? header_.numOfProfiles : 0; }
+    bool isValid() const { return error_ == KeymapError::OK; }
+    KeymapError getError() const { return error_; }
+    // 失敗したページの読み込みの回数 Number of page loads that failed
+    uint32_t getReadErrorCount() const { return readErrors_; }
+
+private:
+    static constexpr uint32_t PROFILE_SIZE = static_cast<uint32_t>(NUM_OF_KEYS) * NUM_OF_LAYERS;
+    static constexpr uint8_t NOT_LOADED = UINT8_MAX;
+    static constexpr uint8_t CHUNK_SIZE = 32; //一度に読み込むバイト数 Bytes read at once
+
+    // 範囲[first, first + count)のActionを読み、checkerに渡す(pageがnullptrでなければ書き込む)
+    // Reads count actions starting at action first, feeding them to the checker and storing them in page.
+    bool readActions(const uint32_t first, const uint32_t count, KeymapFormat::Checker& checker, Action* page) {
+        if (!file_.seek(KeymapFormat::HEADER_SIZE + first * 2)) { return false; }
+
+        uint8_t chunk[CHUNK_SIZE];
+        for (uint32_t done = 0; done < count;) {
+            const uint32_t words = ((count - done) < (CHUNK_SIZE / 2)) ? (count - done) : (CHUNK_SIZE / 2);
+            if (static_cast<uint32_t>(file_.read(chunk, words * 2)) != words * 2) { return false; }
+
+            for (uint32_t i = 0; i < words; i++) {
+                const uint16_t word = KeymapFormat::get16(&chunk[i * 2]);
+                if (!checker.add(word)) { return false; }
+                if (page != nullptr) { page[done + i] = Action(word); }
+            }
+            done += words;
+        }
+        return true;
+    }
+
+    KeymapError validate() {
+        uint8_t bytes[KeymapFormat::HEADER_SIZE];
+        if (!file_.seek(0)) { return KeymapError::READ; }
+        if (static_cast<uint32_t>(file_.read(bytes, KeymapFormat::HEADER_SIZE)) != KeymapFormat::HEADER_SIZE) { return KeymapError::TOO_SHORT; }
+
+        const KeymapError error = KeymapFormat::parseHeader(bytes, NUM_OF_KEYS, NUM_OF_LAYERS, header_);
+        if (error != KeymapError::OK) { return error; }
+
+        KeymapFormat::Checker checker(header_, NUM_OF_MACROS);
+        if (!readActions(0, header_.getNumOfActions(), checker, nullptr)) {
+            return checker.isValid() ? KeymapError::TOO_SHORT : KeymapError::ACTION;
+        }
+        return (checker.getChecksum() == header_.checksum) ? KeymapError::OK : KeymapError::CHECKSUM;
+    }
+
+    bool read(const uint8_t profile, Action* page) {
+        KeymapFormat::Checker checker(header_, NUM_OF_MACROS);
+        if (readActions(profile * PROFILE_SIZE, PROFILE_SIZE, checker, page)) { return true; }
+        readErrors_++;
+        return false;
+    }
+
+    //一つのページに読み込みが失敗した場合、使用中のプロファイルを読み直す(失敗した場合は空にする)
+    //With one page, a failed read has overwritten part of the profile in use: read it again, or empty the page.
+    void restore() {
+        if ((loaded_ != NOT_LOADED) && read(loaded_, pages_[0])) { return; }
+        for (Action& action : pages_[0]) { action = Action::none(); }
+        loaded_ = NOT_LOADED;
+    }
+
+    FILE_TYPE& file_;
+    KeymapFormat::Header header_;
+    //使用中のプロファイルと予備のページ Profileは使用中のページを指すため、次のプロファイルは予備のページに読み込む
+    //The profile in use and the scratch page. Profile keeps a pointer into the page in use, so the next
+    //profile goes into the scratch page: a read that fails half way never changes the keys in use.
+    Action pages_[PAGES][PROFILE_SIZE];
+    const uint16_t NUM_OF_MACROS;
+    uint8_t current_; //使用中のページ Page in use
+    uint8_t loaded_;
+    uint32_t readErrors_ = 0;
+    KeymapError error_;
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+// PC上でファイルをmmapして使う(テストやキーマップの検証用)
+// Maps a keymap file into memory on a PC, e.g. to test keymaps against recorded key traces.
+template<uint16_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS>
+class MappedKeymap : public KeymapImage<NUM_OF_KEYS, NUM_OF_LAYERS> {
+public:
+    MappedKeymap(const char* path, const uint16_t numOfMacros=0) : data_(MAP_FAILED), size_(0) {
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0) { return; }
+
+        struct stat info;
+        if ((fstat(fd, &info) == 0) && (info.st_size > 0)) {
+            size_ = info.st_size;
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+
+        if (data_ != MAP_FAILED) { this->open(data_, size_, numOfMacros); }
+    }
+
+    ~MappedKeymap() {
+        if (data_ != MAP_FAILED) { munmap(data_, size_); }
+    }
+
+    MappedKeymap(const MappedKeymap&) = delete;
+    MappedKeymap& operator=(const MappedKeymap&) = delete;
+
+private:
+    void* data_;
+    size_t size_;
+};
+#endif
+
+#endif
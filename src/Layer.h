@@ -2,47 +2,191 @@
 #define MMZ_LAYER_H
 
 #include <array>
+#include <atomic>
 #include <vector>
 
+#include "KeyReader/KeyReader.h"
 #include "Key.h"
+#include "Action.h"
 
 #define NONE nullptr
 
 constexpr uint8_t BASE = 0;
 
-template<uint8_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS>
+// 下のレイヤーの割り当てをそのまま使う(最後はBASEレイヤーの割り当て)
+// Falls through to the binding of the next active layer below; BASE is always active, so a
+// transparent key ends up on its BASE binding.
+inline Macro transparent() { return Macro::transparent(); }
+
+// 有効なレイヤーをビットマスクで管理し、キーごとに有効なレイヤーのうち最も上にある透過でない割り当てを使う
+// Any number of layers can be active at once, and BASE always is. Each key uses the binding of the
+// highest active layer that is not transparent(); the result is cached per key and only rebuilt when the layer state or the
+// profile changes, so dispatch looks macros up in constant time.
+// The keymaps themselves (of Macro or of Action) are owned by Profile and are never copied.
+// The cache is atomic (relaxed, plain loads and stores on the RP2040) so that Pipeline can read it
+// on the scanning core while a macro switches layers on the other core.
+template<uint16_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS>
 class Layer {
 public:
     using LayerCallback = std::function<void(uint8_t)>;
 
-    Layer(std::array<Key, NUM_OF_KEYS>& keys, LayerCallback onLayerChange=nullptr)
-     : keys_(keys),onLayerChange_(onLayerChange), currentLayer_(0), preLayer_(0) {}
+    Layer(LayerCallback onLayerChange=nullptr)
+     : layers_(nullptr), actions_(nullptr), macros_(nullptr), numOfMacros_(0),
+       active_{}, onLayerChange_(onLayerChange), currentLayer_(0), preLayer_(0) {
+        setBit(BASE);
+        rebuild();
+    }
 
-    void setProfile(LayeredKeymap<NUM_OF_KEYS, NUM_OF_LAYERS> layeredKeymap) {
-        layers_ = layeredKeymap;
+    void setProfile(const LayeredKeymap<NUM_OF_KEYS, NUM_OF_LAYERS>& layeredKeymap) {
+        layers_ = &layeredKeymap;
+        actions_ = nullptr;
+        set(0);
+    }
 
+    // Actionのキーマップを使う Action::macro(i)はmacros[i]を呼び出す
+    // Uses a keymap of actions; Action::macro(i) calls macros[i] (i < numOfMacros).
+    void setProfile(const ActionLayers<NUM_OF_KEYS, NUM_OF_LAYERS>& actionLayers, const Macro* macros=nullptr, const uint16_t numOfMacros=0) {
+        setProfile(actionLayers.front().data(), macros, numOfMacros);
+    }
+    // レイヤー0のキー0から並んだNUM_OF_LAYERS * NUM_OF_KEYS個のAction(KeymapImageなど)
+    // Same with NUM_OF_LAYERS * NUM_OF_KEYS actions in a row, layer by layer, e.g. from a KeymapImage.
+    void setProfile(const Action* actions, const Macro* macros=nullptr, const uint16_t numOfMacros=0) {
+        layers_ = nullptr;
+        actions_ = actions;
+        macros_ = macros;
+        numOfMacros_ = (macros == nullptr) ? 0 : numOfMacros;
         set(0);
     }
 
+    // 指定したレイヤーとBASEレイヤーのみを有効にする Activates only the specified layer, on top of BASE.
     void set(const uint8_t layer) {
         if (layer >= NUM_OF_LAYERS) { return; }
-        preLayer_ = currentLayer_;
-        currentLayer_ = layer;
-        if (onLayerChange_ != nullptr) { onLayerChange_(currentLayer_); }
+        for (uint8_t word = 0; word < ACTIVE_SIZE; word++) { active_[word] = 0; }
+        setBit(BASE);
+        setBit(layer);
+        changed();
+    }
 
-        for (uint16_t i = 0; i < NUM_OF_KEYS; i++) {
-            keys_[i].registerMacro(layers_[layer][i]);
-        }
+    // 他のレイヤーを有効にしたまま、指定したレイヤーを重ねる/外す
+    // Stacks the layer on top of (or removes it from) the active layers, keeping the others.
+    void on(const uint8_t layer) {
+        if ((layer >= NUM_OF_LAYERS) || isActive(layer)) { return; }
+        setBit(layer);
+        changed();
+    }
+    // BASEレイヤーは外せない BASE cannot be turned off.
+    void off(const uint8_t layer) {
+        if ((layer == BASE) || (layer >= NUM_OF_LAYERS) || !isActive(layer)) { return; }
+        active_[layer / 32] &= ~(1UL << (layer % 32));
+        changed();
+    }
+    void toggle(const uint8_t layer) {
+        if (isActive(layer)) { off(layer); }
+        else { on(layer); }
     }
 
     void reset() { set(preLayer_); }
 
+    // 有効なレイヤーのうち最も上のもの The highest active layer
     uint8_t get() const { return currentLayer_; }
 
+    bool isActive(const uint8_t layer) const {
+        return (layer < NUM_OF_LAYERS) && (active_[layer / 32] & (1UL << (layer % 32)));
+    }
+
+    // 有効なレイヤーでキーに割り当てられているマクロ The macro resolved for the key on the active layers
+    inline const Macro& getMacro(const uint16_t index) const { return *resolved_[index].load(std::memory_order_relaxed); }
+    // 有効なレイヤーでキーに割り当てられている処理 Macroのキーマップの場合はAction::macro() The action resolved for the key;
+    // with a keymap of Macro it is always an Action::macro() that stands for getMacro().
+    inline Action getAction(const uint16_t index) const { return Action(resolvedActions_[index].load(std::memory_order_relaxed)); }
+    inline uint16_t getEvents(const uint16_t index) const { return events_[index].load(std::memory_order_relaxed); }
+    inline uint8_t getTiming(const uint16_t index) const { return getMacro(index).getTiming(); }
+
+    inline ReaderData::Word getPressedSubscribers(const uint16_t word) const { return pressed_[word].load(std::memory_order_relaxed); }
+    inline ReaderData::Word getReleasedSubscribers(const uint16_t word) const { return released_[word].load(std::memory_order_relaxed); }
+
 private:
-    LayeredKeymap<NUM_OF_KEYS, NUM_OF_LAYERS> layers_;
-    std::array<Key, NUM_OF_KEYS>& keys_;
-    //ComboManager<NUM_OF_KEYS> combos_;
+    static constexpr uint16_t KEYBOARD_SIZE = ReaderData::calcKeyboardSize<NUM_OF_KEYS>();
+    static constexpr uint8_t ACTIVE_SIZE = (NUM_OF_LAYERS + 31) / 32;
+    static_assert(sizeof(ActionLayers<NUM_OF_KEYS, NUM_OF_LAYERS>) == sizeof(Action) * NUM_OF_KEYS * NUM_OF_LAYERS,
+                  "The actions of all layers must be contiguous.");
+
+    inline static const Macro EMPTY = nullptr;
+
+    inline void setBit(const uint8_t layer) { active_[layer / 32] |= (1UL << (layer % 32)); }
+
+    void changed() {
+        uint8_t top = 0;
+        for (uint8_t layer = NUM_OF_LAYERS; layer > 0; layer--) {
+            if (isActive(layer - 1)) { top = layer - 1; break; }
+        }
+
+        if (top != currentLayer_) { preLayer_ = currentLayer_; }
+        currentLayer_ = top;
+
+        rebuild();
+        if (onLayerChange_ != nullptr) { onLayerChange_(currentLayer_); }
+    }
+
+    // キーごとに、有効なレイヤーを上から順に調べて最初の透過でない割り当てを使う
+    // For each key, walks the active layers from the top and uses the first non-transparent binding.
+    void rebuild() {
+        ReaderData::Word pressed[KEYBOARD_SIZE] = {}, released[KEYBOARD_SIZE] = {};
+
+        for (uint16_t i = 0; i < NUM_OF_KEYS; i++) {
+            const Macro* resolved = &EMPTY;
+            Action action = Action::macro(0);
+
+            if (actions_ != nullptr) {
+                action = resolveAction(i);
+                if (action.isMacro() && (action.getArgument() < numOfMacros_)) { resolved = &macros_[action.getArgument()]; }
+            } else {
+                resolved = resolveMacro(i);
+            }
+            resolved_[i].store(resolved, std::memory_order_relaxed);
+            resolvedActions_[i].store(action.getWord(), std::memory_order_relaxed);
+
+            const uint16_t events = action.isMacro() ? resolved->getEvents() : action.getEvents();
+            events_[i].store(events, std::memory_order_relaxed);
+
+            //PRESSED/RELEASEDを購読しているキー(BitParallelEngine用) Keys subscribed to PRESSED/RELEASED, for BitParallelEngine
+            const ReaderData::Word bit = ReaderData::bit(ReaderData::getDigit(i));
+
+            if (events & Key::mask(Key::Event::PRESSED)) { pressed[ReaderData::getIndex(i)] |= bit; }
+            if (events & Key::mask(Key::Event::RELEASED)) { released[ReaderData::getIndex(i)] |= bit; }
+        }
+
+        for (uint16_t word = 0; word < KEYBOARD_SIZE; word++) {
+            pressed_[word].store(pressed[word], std::memory_order_relaxed);
+            released_[word].store(released[word], std::memory_order_relaxed);
+        }
+    }
+
+    const Macro* resolveMacro(const uint16_t index) const {
+        for (uint8_t layer = NUM_OF_LAYERS; (layer > 0) && (layers_ != nullptr); layer--) {
+            if (!isActive(layer - 1) || (*layers_)[layer - 1][index].isTransparent()) { continue; }
+            return &(*layers_)[layer - 1][index];
+        }
+        return &EMPTY;
+    }
+
+    Action resolveAction(const uint16_t index) const {
+        for (uint8_t layer = NUM_OF_LAYERS; layer > 0; layer--) {
+            const Action action = actions_[(layer - 1) * NUM_OF_KEYS + index];
+            if (!isActive(layer - 1) || action.isTransparent()) { continue; }
+            return action;
+        }
+        return Action::none();
+    }
+
+    const LayeredKeymap<NUM_OF_KEYS, NUM_OF_LAYERS>* layers_;
+    const Action* actions_; //NUM_OF_LAYERS * NUM_OF_KEYS個 NUM_OF_LAYERS * NUM_OF_KEYS actions
+    const Macro* macros_;
+    uint16_t numOfMacros_;
+    std::atomic<const Macro*> resolved_[NUM_OF_KEYS];
+    std::atomic<uint16_t> resolvedActions_[NUM_OF_KEYS], events_[NUM_OF_KEYS];
+    std::atomic<ReaderData::Word> pressed_[KEYBOARD_SIZE], released_[KEYBOARD_SIZE];
+    uint32_t active_[ACTIVE_SIZE];
     LayerCallback onLayerChange_;
     uint8_t currentLayer_, preLayer_;
 };
@@ -26,25 +26,59 @@
 #define MMZ_KEYBOARD_H
 
 #include <Arduino.h>
+#include <type_traits>
+
+#if __cplusplus < 201703L
+#error "This library requires C++17 (gnu++17) or later. Use arduino-pico, esp32 core 3.0 or later, or Teensyduino 1.58 or later."
+#endif
 
 #include "KeyReader/KeyReader.h"
 #include "Key.h"
+#include "KeyEngine.h"
+#include "Combo.h"
+#include "Action.h"
 #include "Delay.h"
 #include "Layer.h"
 #include "Profile.h"
 #include "Util.h"
+#include "Pipeline.h"
+#include "Stats.h"
+#include "HidBatch.h"
+#include "Typing.h"
+#include "Recorder.h"
+
+#define Do [](const Key& key)
 
-#define Do [](Key key)
+// idle()で一度に眠る最大の時間(ms)
+// Longest time in ms that idle() sleeps at once, even when nothing is pending.
+#ifndef MMZ_MAX_IDLE_TIME
+#define MMZ_MAX_IDLE_TIME 1000
+#endif
 
-template<uint8_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS = 1, uint8_t NUM_OF_PROFILES = 1>
+// ENGINE: キーの状態を更新する処理(SerialEngine/BitParallelEngine)
+//         How key states are updated (SerialEngine or BitParallelEngine).
+// READER: 読み取りクラスの型 KeyReader<NUM_OF_KEYS>の場合は仮想関数で呼び出す
+//         Type of the reader. With the default KeyReader<NUM_OF_KEYS> any reader can be passed and is
+//         called through its virtual functions; with a concrete reader type (e.g. PortMatrix<4, 4>)
+//         read() and wait() are called directly and can be inlined into update().
+template<uint16_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS = 1, uint8_t NUM_OF_PROFILES = 1,
+         typename ENGINE = SerialEngine<NUM_OF_KEYS>, typename READER = KeyReader<NUM_OF_KEYS>>
 class MacroPad {
 public:
-    //static constexpr uint16_t NUM_OF_KEYS = ROWS * COLS;
+    static_assert(std::is_base_of<KeyReader<NUM_OF_KEYS>, READER>::value, "'READER' must derive from KeyReader<NUM_OF_KEYS>.");
+
+    static constexpr uint16_t getNumOfKeys() { return NUM_OF_KEYS; }
     static constexpr uint8_t getNumOfLayers() { return NUM_OF_LAYERS; }
 
-    MacroPad(KeyReader<NUM_OF_KEYS>& keyReader)
-     : keyReader_(keyReader), KEY_STATE_DATA(keyReader_.getStateData()),
-       LAYERS(Layer<NUM_OF_KEYS, NUM_OF_LAYERS>(KEYS)), PROFILES(Profile<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES>(LAYERS)) {
+    // idle()で眠った回数と時間 How often and how long idle() slept
+    struct IdleStats {
+        uint32_t wakeups;   //眠った回数 Number of sleeps, divide by the run time for wakeups per second
+        uint32_t sleepTime; //眠っていた時間の合計(us) Total time asleep in us (wraps after about 71 minutes)
+    };
+
+    MacroPad(READER& keyReader)
+     : LAYERS(Layer<NUM_OF_KEYS, NUM_OF_LAYERS>()), PROFILES(Profile<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES>(LAYERS)),
+       keyReader_(keyReader), KEY_STATE_DATA(keyReader_.getStateData()) {
         static_assert((NUM_OF_LAYERS > 0), "'NUM_OF_LAYERS' must be 1 or greater.");
         static_assert((NUM_OF_KEYS < UINT16_MAX), "The total number of keys (including invalid keys) must be 65535 or less.");
 
@@ -58,20 +92,250 @@ public:
         PROFILES.init(profiledLayers);
     }
 
+    // グローバル変数などのキーマップをコピーせずに使う(キーマップはMacroPadより長く存在する必要がある)
+    // Uses the keymaps without copying them; they must outlive the MacroPad.
+    void attach(const ProfiledLayers<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES>& profiledLayers) {
+        PROFILES.attach(profiledLayers);
+    }
+
+    // Actionのキーマップを使う(constexprで宣言すればフラッシュに置かれ、RAMを使わない)
+    // Uses keymaps of actions; declared constexpr they stay in flash and take no RAM or setup time.
+    // Action::macro(i) calls macros[i], for anything the actions cannot express.
+    void attach(const ActionProfiles<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES>& actionProfiles) {
+        PROFILES.attach(actionProfiles);
+    }
+    void attach(const ActionProfiles<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES>& actionProfiles,
+                const Macro* macros, const uint16_t numOfMacros) {
+        PROFILES.attach(actionProfiles, macros, numOfMacros);
+    }
+    template<uint16_t NUM_OF_MACROS>
+    void attach(const ActionProfiles<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES>& actionProfiles, const Macro (&macros)[NUM_OF_MACROS]) {
+        PROFILES.attach(actionProfiles, macros, NUM_OF_MACROS);
+    }
+
+    // 実行時に読み込むキーマップを使う(KeymapImage/KeymapFile) Uses a keymap loaded at run time.
+    // プロファイルの数が異なる場合はfalse False, keeping the current keymaps, if its number of profiles differs.
+    bool attach(ActionSource<NUM_OF_KEYS, NUM_OF_LAYERS>& source) { return PROFILES.attach(source); }
+    bool attach(ActionSource<NUM_OF_KEYS, NUM_OF_LAYERS>& source, const Macro* macros, const uint16_t numOfMacros) {
+        return PROFILES.attach(source, macros, numOfMacros);
+    }
+    template<uint16_t NUM_OF_MACROS>
+    bool attach(ActionSource<NUM_OF_KEYS, NUM_OF_LAYERS>& source, const Macro (&macros)[NUM_OF_MACROS]) {
+        return PROFILES.attach(source, macros, NUM_OF_MACROS);
+    }
+
     void update() {
-        keyReader_.read();
+        scan([this](const Key& key, const uint32_t now) { invoke(key, now); });
+        MacroDelay::invoke();
+        Typing::update();
 
-        uint32_t now = millis();
+        //このupdate()のキー入力を一つのレポートにまとめる Batch this update's key presses into one report.
+        if constexpr (HidBatch::ENABLED) {
+            HidBatch::commit();
+            HidBatch::flush();
+        }
+    }
 
-        for (uint16_t i = 0; i < NUM_OF_KEYS; i++) {
-            KEYS[i].update(KEY_STATE_DATA[i / ReaderData::READ_BITS_ZERO_INDEXING] & (1 << (i % ReaderData::READ_BITS_ZERO_INDEXING)), now);
+    // キーを読み取って状態を更新し、マクロを実行するキーをsinkに渡す(マクロは実行しない)
+    // Reads the keys, updates their state and passes every key with a subscribed event to
+    // sink(const Key& key, uint32_t now) without running any macro; now is micros(). update() runs the macros in the
+    // sink directly; Pipeline queues the keys to run the macros on the other core.
+    template<typename SINK>
+    void scan(SINK&& sink) {
+        const uint32_t start = Stats::ENABLED ? Stats::getCycles() : 0;
+
+        if constexpr (IS_VIRTUAL) { keyReader_.read(); }
+        else { keyReader_.READER::read(); }
+
+        const uint32_t now = micros();
+
+        //コンボの判定中のキーは保留される Keys that may still complete a combo are held back.
+        engine_.update(KEYS, COMBOS.filter(KEY_STATE_DATA, now, sink), now, LAYERS, dirtyKeys_);
+
+        if constexpr (Stats::ENABLED) { Stats::recordScan(Stats::getCycles() - start); }
+
+        flush(sink, now);
+    }
+
+    // emulate()などで追加されたキーをsinkに渡す Passes the keys marked since the last scan to sink.
+    //The word is re-read on each iteration so that keys marked by emulate() during dispatch are picked up.
+    template<typename SINK>
+    void flush(SINK&& sink, const uint32_t now) {
+        for (uint16_t word = 0; word < DIRTY_SIZE; word++) {
+            while (dirtyKeys_[word] != 0) {
+                const uint8_t digit = ReaderData::lowestBit(dirtyKeys_[word]);
+                dirtyKeys_[word] &= ~ReaderData::bit(digit);
+
+                sink(KEYS[word * ReaderData::READ_BITS + digit], now);
+            }
         }
+    }
 
-        for (uint16_t i = 0; i < NUM_OF_KEYS; i++) {
-            KEYS[i].invoke();
+    // 次にイベントが発生しうるまで眠る(割り込みで読み取る場合のみ) update()の後に呼ぶ
+    // Sleeps until a key changes or the next timer is due: a pending debounce, HOLD, LONG or SINGLE
+    // decision, a combo window, a macroDelay() callback or the next key typed by Typing. Call it after
+    // update(). Only readers that are told about edges (InterruptDirect) can sleep; with any other
+    // reader it returns at once.
+    void idle() {
+        const uint32_t now = micros();
+        const uint32_t idleTime = getIdleTime(now);
+        if (idleTime == 0) { return; }
+
+        const bool slept = IS_VIRTUAL ? keyReader_.wait(idleTime) : keyReader_.READER::wait(idleTime);
+        if (!slept) { return; }
+        idleStats_.wakeups++;
+        idleStats_.sleepTime += micros() - now;
+    }
+
+    // 入力が変わらない限りスキャンしなくてよい時間(us) 0の場合はすぐにスキャンする必要がある
+    // Time in us during which update() would do nothing unless the input changes; 0 if it has to run now.
+    // Keys whose macro subscribes to PRESSED/RELEASED need every scan and keep the pad awake while at that level.
+    uint32_t getIdleTime(const uint32_t now) const {
+        for (uint16_t word = 0; word < DIRTY_SIZE; word++) {
+            if (dirtyKeys_[word] != 0) { return 0; }
+
+            const ReaderData::Word input = KEY_STATE_DATA[word];
+            if ((input & LAYERS.getPressedSubscribers(word)) | (~input & LAYERS.getReleasedSubscribers(word))) { return 0; }
         }
+        if (!COMBOS.isIdle(now)) { return 0; }
 
-        MacroDelay::invoke();
+        uint32_t idleTime = MMZ_MAX_IDLE_TIME * 1000UL;
+
+        const uint32_t delayTime = MacroDelay::getTimeUntilNext();
+        if (delayTime < idleTime / 1000) { idleTime = delayTime * 1000; }
+
+        const uint32_t typingTime = Typing::getTimeUntilNext();
+        if (typingTime < idleTime) { idleTime = typingTime; }
+
+        for (uint16_t i = 0; (i < NUM_OF_KEYS) && (idleTime > 0); i++) {
+            const uint32_t keyTime = KEYS[i].template getIdleTime<typename ENGINE::TimingSource>(now, LAYERS.getTiming(i));
+            if (keyTime < idleTime) { idleTime = keyTime; }
+        }
+
+        return idleTime;
+    }
+
+    const IdleStats& getIdleStats() const { return idleStats_; }
+    void resetIdleStats() { idleStats_ = {}; }
+
+    // キー(コンボの仮想キーを含む)に現在割り当てられているマクロを実行する
+    // Runs the action or macro currently bound to the key, or the combo's macro for a combo's virtual key.
+    void invoke(const Key& key) {
+        const uint16_t index = key.getIndex();
+        if ((index < NUM_OF_KEYS) && !LAYERS.getAction(index).isMacro()) {
+            run(LAYERS.getAction(index), key);
+            return;
+        }
+
+        const Macro& macro = (index < NUM_OF_KEYS) ? LAYERS.getMacro(index) : COMBOS.getMacro(index - NUM_OF_KEYS);
+        if (macro) { macro(key); }
+    }
+
+    // Actionを実行する(マクロの表を使うAction::macro()を除く) Runs an action other than Action::macro().
+    void run(const Action action, const Key& key) {
+        const bool rising = key.hasOccurred(Key::Event::RISING_EDGE);
+        const bool falling = key.hasOccurred(Key::Event::FALLING_EDGE);
+        const uint8_t argument = action.getArgument();
+
+        switch (action.getType()) {
+            case Action::Type::KEY:
+                if (rising) { sendKey(action.getCode(), true); }
+                else if (falling) { sendKey(action.getCode(), false); }
+                break;
+            case Action::Type::MOD_TAP:
+                if (key.hasOccurred(Key::Event::TAP)) {
+                    sendKey(action.getCode(), true);
+                    sendKey(action.getCode(), false);
+                } else {
+                    if (key.hasOccurred(Key::Event::HOLD)) { sendKey(action.getHoldCode(), true); }
+                    if (falling) { sendKey(action.getHoldCode(), false); }
+                }
+                break;
+            case Action::Type::LAYER_TO:      if (rising) { LAYERS.set(argument); } break;
+            case Action::Type::LAYER_BACK:    if (falling) { LAYERS.set(argument); } break;
+            case Action::Type::LAYER_RESET:   if (rising) { LAYERS.reset(); } break;
+            case Action::Type::LAYER_TOGGLE:  if (rising) { LAYERS.toggle(argument); } break;
+            case Action::Type::LAYER_HOLD:
+                if (rising) { LAYERS.on(argument); }
+                else if (falling) { LAYERS.off(argument); }
+                break;
+            case Action::Type::PROFILE_TO:    if (rising) { PROFILES.set(argument); } break;
+            case Action::Type::PROFILE_BACK:  if (falling) { PROFILES.set(argument); } break;
+            case Action::Type::PROFILE_RESET: if (rising) { PROFILES.reset(); } break;
+            default: break;
+        }
+    }
+
+    // timeはイベントが発生した時刻(micros()) MMZ_STATSが有効な場合はマクロの実行時間などを記録する
+    // Same, with the time the event occurred (micros()); with MMZ_STATS the run time of the macro
+    // and the latency of its first HID report are recorded.
+    void invoke(const Key& key, const uint32_t time) {
+        const bool wasRecording = Recorder::ENABLED && LAYERS.isActive(recordLayer_);
+
+        if constexpr (Stats::ENABLED) {
+            Stats::beginMacro(time);
+            const uint32_t start = micros();
+            invoke(key);
+
+            uint32_t& slowest = slowestMacro_[key.getIndex()];
+            const uint32_t duration = micros() - start;
+            if (duration > slowest) { slowest = duration; }
+        } else {
+            invoke(key);
+        }
+
+        if constexpr (Recorder::ENABLED) {
+            if (wasRecording || LAYERS.isActive(recordLayer_)) { record(key, time, wasRecording); }
+        }
+    }
+
+    // layerが有効な間、マクロを実行したキーのイベントを記録する(NUM_OF_LAYERS以上で無効)
+    // Records the events that run a macro while the layer is active; each time it becomes active a new
+    // recording starts. The key that turns the layer on or off is not recorded. A layer of NUM_OF_LAYERS
+    // or more turns recording off (the default). Needs MMZ_RECORDER.
+    void setRecordLayer(const uint8_t layer) { recordLayer_ = layer; }
+
+    // 記録したイベントを同じ間隔で再生する(現在のキーの割り当てで実行される) 記録中や再生中はfalse
+    // Plays the recorded events back with their recorded timing through the bindings active at the
+    // time, as if the keys were pressed again. Returns false while recording or already replaying,
+    // and always without MMZ_RECORDER.
+    bool replay() {
+        if constexpr (Recorder::ENABLED) {
+            if (LAYERS.isActive(recordLayer_)) { return false; }
+            Recorder::stop(); //記録用レイヤーが他の方法で外された場合 In case the layer was turned off by other means
+
+            return Recorder::replay([this](const uint16_t index, const uint16_t events) { replay(index, events); });
+        }
+        return false;
+    }
+
+    // 再生を止め、再生で押されたままのキーを離す Stops the replay and releases the keys it holds down.
+    void cancelReplay() {
+        if constexpr (Recorder::ENABLED) { Recorder::cancelReplay(); }
+    }
+
+    // キー(コンボの仮想キーを含む)ごとのマクロの最長の実行時間(us) MMZ_STATSが有効な場合のみ
+    // Longest run of the key's macro in us (combo n is NUM_OF_KEYS + n); always 0 without MMZ_STATS.
+    uint32_t getSlowestMacro(const uint16_t index) const {
+        if constexpr (Stats::ENABLED) { return (index < NUM_OF_STATS_KEYS) ? slowestMacro_[index] : 0; }
+        return 0;
+    }
+
+    // 統計をバイナリでoutへ書き込む(Serialなど) Writes the statistics as a binary frame, e.g. to Serial.
+    void dumpStats(Print& out) const { Stats::dump(out, slowestMacro_, Stats::ENABLED ? NUM_OF_STATS_KEYS : 0); }
+
+    void resetStats() {
+        Stats::reset();
+        for (uint32_t& slowest : slowestMacro_) { slowest = 0; }
+    }
+
+    // イベントを発生させ、そのキーのマクロが実行されるようにする
+    // Emits an event on the key and schedules its macro for dispatch.
+    void emulate(const uint16_t index, const Key::Event type) {
+        if (index >= NUM_OF_KEYS) { return; }
+        KEYS[index].emulate(type);
+        engine_.touch(index);
+        markDirty(index);
     }
 
     LayerUtil<NUM_OF_KEYS, NUM_OF_LAYERS> getLayerUtil() { return LayerUtil<NUM_OF_KEYS, NUM_OF_LAYERS>(LAYERS); }
@@ -80,13 +344,69 @@ public:
     std::array<Key, NUM_OF_KEYS> KEYS;
     Layer<NUM_OF_KEYS, NUM_OF_LAYERS> LAYERS;
     Profile<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES> PROFILES;
+    ComboManager<NUM_OF_KEYS, typename ENGINE::TimingSource> COMBOS;
 
 private:
     //constexpr uint16_t NUM_OF_KEYS;
+    static constexpr uint16_t DIRTY_SIZE = ReaderData::calcKeyboardSize<NUM_OF_KEYS>();
+    static constexpr bool IS_VIRTUAL = std::is_same<READER, KeyReader<NUM_OF_KEYS>>::value;
+    static constexpr uint16_t NUM_OF_STATS_KEYS = NUM_OF_KEYS + MMZ_MAX_COMBOS;
+
+    // KEYとMOD_TAPのキー入力 Keyboard.hを使う場合のみ(pressTo()と同じ)
+    // Key presses of KEY and MOD_TAP; like pressTo(), only with USE_KEYBOARD_H.
+    static void sendKey(const uint8_t code, const bool pressed) {
+#ifdef USE_KEYBOARD_H
+        if (pressed) { hidPress(code); }
+        else { hidRelease(code); }
+        hidReported();
+#else
+        (void)code;
+        (void)pressed;
+#endif
+    }
+
+    // 記録用レイヤーの切り替えを検出し、キーのイベントを記録する
+    // Starts or stops the recording when the record layer changed and records the key's events.
+    void record(const Key& key, const uint32_t time, const bool wasRecording) {
+        const bool recording = LAYERS.isActive(recordLayer_);
+        if (recording != Recorder::isRecording()) {
+            if (!recording) {
+                Recorder::stop();
+                return;
+            }
+
+            //このキーがレイヤーを有効にした場合は、このキーを記録しない The key that turned the layer on is left out.
+            Recorder::start();
+            recordKey_ = wasRecording ? UINT16_MAX : key.getIndex();
+        }
+
+        if (recording && (key.getIndex() != recordKey_)) { Recorder::record(key.getIndex(), key.getOccurred(), time); }
+    }
+
+    // 記録したイベントを、そのイベントのみを持つキーの複製で実行する
+    // Runs recorded events on a copy of the key that has only those events. The real key is left
+    // alone, so the copy knows nothing of its clicks or timing: getCountOfClick() is 0 and
+    // getStateDuration() counts from the replayed event.
+    void replay(const uint16_t index, const uint16_t events) {
+        if (index >= NUM_OF_KEYS + MMZ_MAX_COMBOS) { return; }
+
+        Key key;
+        key.restore(index, events, 0, micros());
+        invoke(key);
+    }
+
+    inline void markDirty(const uint16_t index) {
+        dirtyKeys_[ReaderData::getIndex(index)] |= ReaderData::bit(ReaderData::getDigit(index));
+    }
 
-    KeyReader<NUM_OF_KEYS>& keyReader_;
-    const uint32_t (&KEY_STATE_DATA)[ReaderData::calcKeyboardSize<NUM_OF_KEYS>()];
-    //ComboManager<NUM_OF_KEYS> combos_;
+    READER& keyReader_;
+    const ReaderData::Word (&KEY_STATE_DATA)[DIRTY_SIZE];
+    ReaderData::Word dirtyKeys_[DIRTY_SIZE] = {}; //マクロを実行するキー Keys whose macro is pending dispatch
+    ENGINE engine_;
+    IdleStats idleStats_ = {};
+    uint8_t recordLayer_ = UINT8_MAX;  //記録用レイヤー Layer that records while active
+    uint16_t recordKey_ = UINT16_MAX;  //記録用レイヤーを有効にしたキー Key that turned the record layer on
+    uint32_t slowestMacro_[Stats::ENABLED ? NUM_OF_STATS_KEYS : 1] = {}; //キーごとのマクロの最長の実行時間 Longest macro run per key
 };
 
 #endif
@@ -0,0 +1,206 @@
+#ifndef MMZ_PIPELINE_H
+#define MMZ_PIPELINE_H
+
+#include <Arduino.h>
+
+#include <atomic>
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <pico/multicore.h>
+#else
+#include <thread>
+#endif
+
+#include "SpscQueue.h"
+#include "Delay.h"
+#include "HidBatch.h"
+#include "Typing.h"
+#include "Key.h"
+
+// 一度にためておけるイベントの数(2のべき乗) 1回のスキャンで発生しうる数より小さい場合はその数まで増やす
+// Number of key events that can wait for dispatch (a power of two). It is raised to hold at least
+// one scan's worth of events, see Pipeline.
+#ifndef MMZ_EVENT_QUEUE_SIZE
+#define MMZ_EVENT_QUEUE_SIZE 64
+#endif
+
+namespace PipelineData {
+    // capacityとminimumの両方以上の2のべき乗 The smallest power of two of at least capacity and minimum
+    constexpr uint16_t roundUp(const uint16_t capacity, const uint16_t minimum) {
+        uint16_t size = 1;
+        while ((size < capacity) || (size < minimum)) { size *= 2; }
+        return size;
+    }
+}
+
+// キーの読み取りと状態の更新(scan)と、マクロの実行(dispatch)を別のコアで行う
+// Splits MacroPad::update() across two cores: scan() reads the keys and runs the state machine,
+// and dispatch() runs the macros and MacroDelay callbacks. A slow macro then no longer delays
+// scanning and debouncing.
+//
+// Events other than PRESSED/RELEASED (edges, TAP, HOLD...) go through a single-producer/single-
+// consumer queue of small records (index, events, timing), never copies of the Key. scan() only
+// runs when the queue has room for everything one scan can emit, so a stalled dispatch() delays
+// the scan instead of dropping an edge. PRESSED/RELEASED alone, which occur on every scan, are
+// coalesced per key: scan() publishes the latest level and dispatch() runs the macro once for it.
+//
+// On the RP2040, start() runs scan() on core 1 (or call scan() from loop1() yourself);
+// elsewhere it runs on a std::thread, which is how the pipeline is tested on a PC.
+// Macros must use Pipeline::emulate() instead of MacroPad::emulate(), and must not touch MacroPad::KEYS.
+template<typename PAD, uint16_t CAPACITY = MMZ_EVENT_QUEUE_SIZE>
+class Pipeline {
+public:
+    static constexpr uint16_t REQUEST_SIZE = 16;
+    // 1回のscan()で発生しうるイベントの数 Most events one scan() can emit: every key, every combo and every request
+    static constexpr uint16_t MAX_EVENTS_PER_SCAN = PAD::getNumOfKeys() + MMZ_MAX_COMBOS + REQUEST_SIZE;
+    static constexpr uint16_t QUEUE_SIZE = PipelineData::roundUp(CAPACITY, MAX_EVENTS_PER_SCAN);
+
+    // 実行待ちのイベント A key event waiting for dispatch
+    struct Event {
+        uint32_t time;      //イベントが発生した時刻(micros()) When the event occurred
+        uint16_t index;
+        uint16_t events;    //Key::getOccurred()
+        uint16_t sinceEdge; //直前のエッジからの時間(ms) ms since the key's last edge, saturated
+        uint8_t clicks;     //Key::getCountOfClick()
+        uint8_t level;      //このイベントで公開した入力レベル The level record written with this event
+    };
+
+    Pipeline(PAD& pad) : pad_(pad), levels_{}, seen_{}, edgeTimes_{}, clicks_{}, maxLatency_(0), stalls_(0) {}
+
+    // キーを読み取り、イベントをキューに入れる(読み取り側のコア) Producer core
+    // キューに1回分の空きがない場合は読み取らずに戻る Returns without scanning while the queue lacks room for one scan.
+    void scan() {
+        if (static_cast<uint16_t>(QUEUE_SIZE - events_.size()) < MAX_EVENTS_PER_SCAN) {
+            stalls_.store(stalls_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+
+        const auto push = [this](const Key& key, const uint32_t now) { publish(key, now); };
+        pad_.scan(push);
+
+        //もう一方のコアから要求されたイベント Events requested by the other core
+        Request request;
+        while (requests_.pop(request)) { pad_.emulate(request.index, request.type); }
+        pad_.flush(push, micros());
+    }
+
+    // キューのイベントのマクロを実行する(実行側のコア) Consumer core
+    void dispatch() {
+        Event event;
+        while (events_.pop(event)) {
+            const uint32_t latency = micros() - event.time;
+            if (latency > maxLatency_) { maxLatency_ = latency; }
+
+            const uint32_t edgeTime = event.time - event.sinceEdge * 1000UL;
+            seen_[event.index] = event.level;
+            edgeTimes_[event.index] = edgeTime;
+            clicks_[event.index] = event.clicks;
+
+            Key key;
+            key.restore(event.index, event.events, event.clicks, edgeTime);
+            pad_.invoke(key, event.time);
+        }
+
+        //まとめたPRESSED/RELEASED Coalesced PRESSED/RELEASED, once per new level record
+        for (uint16_t i = 0; i < NUM_OF_INDICES; i++) {
+            const uint8_t level = levels_[i].load(std::memory_order_acquire);
+            if ((level == seen_[i]) || (level & QUEUED)) { continue; }
+            seen_[i] = level;
+
+            Key key;
+            key.restore(i, Key::mask((level & PRESSED) ? Key::Event::PRESSED : Key::Event::RELEASED), clicks_[i], edgeTimes_[i]);
+            pad_.invoke(key, micros());
+        }
+
+        MacroDelay::invoke();
+        Typing::update();
+
+        if constexpr (HidBatch::ENABLED) {
+            HidBatch::commit();
+            HidBatch::flush();
+        }
+    }
+
+    // 次のscan()でキーにイベントを発生させる(実行側のコアから呼ぶ)
+    // Emits an event on the key in the next scan(); called from the dispatching core.
+    bool emulate(const uint16_t index, const Key::Event type) { return requests_.push({ index, type }); }
+
+    // キューがあふれて失われたイベントの数(scan()が待つため常に0) Events lost because the queue was full; always 0, since scan() waits
+    uint32_t getOverflowCount() const { return events_.getOverflowCount(); }
+    uint32_t getRequestOverflowCount() const { return requests_.getOverflowCount(); }
+    // キューに空きがなく読み取らなかったscan()の回数 scan() calls skipped because dispatch() fell behind
+    uint32_t getStallCount() const { return stalls_.load(std::memory_order_relaxed); }
+
+    // イベントが発生してからマクロが実行されるまでの最大時間(us) Longest time from an event to its dispatch, in us
+    uint32_t getMaxLatency() const { return maxLatency_; }
+
+#if defined(ARDUINO_ARCH_RP2040)
+    // コア1でscan()を繰り返す Runs scan() forever on core 1.
+    void start() {
+        instance_ = this;
+        multicore_launch_core1([]() { while (true) { instance_->scan(); } });
+    }
+#else
+    // 別のスレッドでscan()を繰り返す Runs scan() on a separate thread until stop().
+    void start() {
+        running_ = true;
+        thread_ = std::thread([this]() { while (running_) { scan(); } });
+    }
+    void stop() {
+        running_ = false;
+        if (thread_.joinable()) { thread_.join(); }
+    }
+    ~Pipeline() { stop(); }
+#endif
+
+private:
+    struct Request {
+        uint16_t index;
+        Key::Event type;
+    };
+
+    static constexpr uint16_t NUM_OF_INDICES = PAD::getNumOfKeys() + MMZ_MAX_COMBOS;
+    static constexpr uint16_t LEVELS = Key::mask(Key::Event::PRESSED, Key::Event::RELEASED);
+    //入力レベルの記録: 上位6ビットは書き込むごとに増える番号 Level record: a 6-bit sequence number above these flags
+    static constexpr uint8_t PRESSED = 0x01; //押されている Pressed
+    static constexpr uint8_t QUEUED = 0x02;  //キューに入れたイベントと一緒に書いた Written with a queued event
+
+    // PRESSED/RELEASEDのみの場合は入力レベルを公開し、それ以外はキューに入れる
+    // Publishes the level of a key that only has PRESSED/RELEASED and queues any other event.
+    // The level record is written after the push, so dispatch() never sees it ahead of the event.
+    void publish(const Key& key, const uint32_t now) {
+        const uint16_t index = key.getIndex();
+        if (index >= NUM_OF_INDICES) { return; }
+
+        const uint16_t events = key.getOccurred();
+        const bool queued = (events & ~LEVELS) != 0;
+        const uint8_t level = static_cast<uint8_t>((levels_[index].load(std::memory_order_relaxed) + 4) & ~(PRESSED | QUEUED)) |
+                              (key.isPressed() ? PRESSED : 0) | (queued ? QUEUED : 0);
+
+        if (queued) {
+            const uint32_t sinceEdge = (now - key.getEdgeTime()) / 1000;
+            events_.push({ now, index, events, static_cast<uint16_t>((sinceEdge < UINT16_MAX) ? sinceEdge : UINT16_MAX),
+                           key.getCountOfClick(), level });
+        }
+        levels_[index].store(level, std::memory_order_release);
+    }
+
+    PAD& pad_;
+    SpscQueue<Event, QUEUE_SIZE> events_;
+    SpscQueue<Request, REQUEST_SIZE> requests_;
+    std::atomic<uint8_t> levels_[NUM_OF_INDICES]; //scan()が書く入力レベル Written by scan() only
+    uint8_t seen_[NUM_OF_INDICES];                //dispatch()が処理した記録 Last record dispatch() handled
+    uint32_t edgeTimes_[NUM_OF_INDICES];          //dispatch()側のエッジの時刻 Edge times seen by dispatch()
+    uint8_t clicks_[NUM_OF_INDICES];
+    uint32_t maxLatency_;
+    std::atomic<uint32_t> stalls_;
+
+#if defined(ARDUINO_ARCH_RP2040)
+    inline static Pipeline* instance_ = nullptr;
+#else
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+#endif
+};
+
+#endif
@@ -2,32 +2,93 @@
 #define MMZ_PROFILE_H
 
 #include <array>
+#include <memory>
 
 #include "Key.h"
 #include "Layer.h"
+#include "Action.h"
 
-template <uint8_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS, uint8_t NUM_OF_PROFILES>
+// すべてのプロファイルのキーマップを一度だけ保持し、切り替えはLayerが参照するキーマップを差し替えるだけで行う
+// Every profile's keymaps are stored once; switching profiles only repoints the layer at another keymap,
+// so no macro is copied and nothing is allocated on a profile or layer switch.
+// Only init() keeps a copy (allocated once); attach() of a global keymap, in particular a constexpr
+// keymap of actions that stays in flash, needs no RAM for the keymaps at all.
+template <uint16_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS, uint8_t NUM_OF_PROFILES>
 class Profile {
 public:
-    using ProfileCallback = std::function<void(LayeredKeymap<NUM_OF_KEYS, NUM_OF_LAYERS>&)>;
+    using ProfileCallback = std::function<void(const LayeredKeymap<NUM_OF_KEYS, NUM_OF_LAYERS>&)>;
 
     Profile(Layer<NUM_OF_KEYS, NUM_OF_LAYERS>& profile, ProfileCallback onProfileChange=nullptr)
-     : profile_(profile), onProfileChange_(onProfileChange), currentProfile_(0), preProfile_(0) {}
+     : table_(nullptr), actionTable_(nullptr), source_(nullptr), macros_(nullptr), numOfMacros_(0), profile_(profile), onProfileChange_(onProfileChange), currentProfile_(0), preProfile_(0) {}
 
     void init(ProfiledLayers<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES> profiles) {
-        profiles_ = profiles;
+        profiles_.reset(new ProfiledLayers<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES>(std::move(profiles)));
+        attach(*profiles_);
+    }
+
+    // 寿命の長い(グローバルなどの)キーマップをコピーせずに使用する
+    // Uses keymaps with static storage duration directly instead of copying them.
+    void attach(const ProfiledLayers<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES>& profiles) {
+        table_ = &profiles;
+        actionTable_ = nullptr;
+        source_ = nullptr;
+        set(0);
+    }
+
+    // Actionのキーマップ(constexprでフラッシュに置いたものなど)を使う Action::macro(i)はmacros[i]を呼び出す
+    // Uses keymaps of actions, e.g. a constexpr table in flash; Action::macro(i) calls macros[i].
+    // The macros must outlive the MacroPad as well. onProfileChange is not called for keymaps of actions.
+    void attach(const ActionProfiles<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES>& profiles, const Macro* macros=nullptr, const uint16_t numOfMacros=0) {
+        actionTable_ = &profiles;
+        table_ = nullptr;
+        source_ = nullptr;
+        macros_ = macros;
+        numOfMacros_ = numOfMacros;
+        set(0);
+    }
+
+    // 実行時に読み込むキーマップ(KeymapImage/KeymapFile)を使う set()のたびにそのプロファイルを読み込む
+    // Uses keymaps loaded at run time (KeymapImage, KeymapFile); set() loads the profile it selects
+    // and keeps the current one if loading fails. The source must outlive the MacroPad.
+    // プロファイルの数がNUM_OF_PROFILESと異なる(または無効な)場合は使わずにfalseを返す
+    // Returns false and keeps the current keymaps when the source is invalid or its number of
+    // profiles differs from NUM_OF_PROFILES.
+    bool attach(ActionSource<NUM_OF_KEYS, NUM_OF_LAYERS>& source, const Macro* macros=nullptr, const uint16_t numOfMacros=0) {
+        if (source.getNumOfProfiles() != NUM_OF_PROFILES) { return false; }
 
+        source_ = &source;
+        table_ = nullptr;
+        actionTable_ = nullptr;
+        macros_ = macros;
+        numOfMacros_ = numOfMacros;
         set(0);
+        return true;
     }
 
     void set(const uint8_t profile) {
-        if (profile >= NUM_OF_PROFILES) { return; }
+        if ((profile >= NUM_OF_PROFILES) || ((table_ == nullptr) && (actionTable_ == nullptr) && (source_ == nullptr))) { return; }
+
+        if (source_ != nullptr) {
+            const Action* actions = source_->load(profile);
+            if (actions == nullptr) { return; }
+
+            preProfile_ = currentProfile_;
+            currentProfile_ = profile;
+            profile_.setProfile(actions, macros_, numOfMacros_);
+            return;
+        }
+
         preProfile_ = currentProfile_;
         currentProfile_ = profile;
 
-        profile_.setProfile(profiles_[currentProfile_]);
+        if (actionTable_ != nullptr) {
+            profile_.setProfile((*actionTable_)[currentProfile_], macros_, numOfMacros_);
+            return;
+        }
+
+        profile_.setProfile((*table_)[currentProfile_]);
 
-        if (onProfileChange_) { onProfileChange_(profiles_[currentProfile_]); }
+        if (onProfileChange_) { onProfileChange_((*table_)[currentProfile_]); }
     }
 
     void reset() { set(preProfile_); }
@@ -35,7 +96,12 @@ public:
     uint8_t get() const { return currentProfile_; }
 
 private:
-    ProfiledLayers<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES> profiles_;
+    std::unique_ptr<ProfiledLayers<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES>> profiles_; //init()のコピー The copy made by init()
+    const ProfiledLayers<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES>* table_;
+    const ActionProfiles<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES>* actionTable_;
+    ActionSource<NUM_OF_KEYS, NUM_OF_LAYERS>* source_;
+    const Macro* macros_;
+    uint16_t numOfMacros_;
     Layer<NUM_OF_KEYS, NUM_OF_LAYERS> &profile_;
     ProfileCallback onProfileChange_;
     uint8_t currentProfile_, preProfile_;
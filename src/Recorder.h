@@ -0,0 +1,269 @@
+#ifndef MMZ_RECORDER_H
+#define MMZ_RECORDER_H
+
+#include <Arduino.h>
+
+#include "InplaceFunction.h"
+#include "Key.h"
+#include "Delay.h"
+
+// 1にするとマクロの記録と再生を使える 0(デフォルト)の場合はバッファと記録の処理ごと取り除かれる
+// 1 enables recording and replaying macros; 0 (the default) removes the buffer and the recording entirely.
+#ifndef MMZ_RECORDER
+#define MMZ_RECORDER 0
+#endif
+
+// 記録に使うバッファの大きさ(バイト) 一つのイベントは3バイト程度
+// Size in bytes of the recording buffer; an event usually takes 3 bytes.
+#ifndef MMZ_RECORDER_SIZE
+#define MMZ_RECORDER_SIZE 512
+#endif
+
+// 記録と再生の終わりに離すために覚えておく、同時に押されたキーの数
+// Number of keys held at once that are remembered, so they can be released when a recording or replay ends.
+#ifndef MMZ_RECORDER_MAX_HELD
+#define MMZ_RECORDER_MAX_HELD 16
+#endif
+
+// キーのイベントを記録し、同じ間隔で再生する(MacroPad::setRecordLayer()とreplay()から使う)
+// Records the events that ran a macro, with their timing, and plays them back later through the
+// key bindings, i.e. a dynamic macro. MacroPad::setRecordLayer() records while a layer is active and
+// MacroPad::replay() plays the recording back.
+// Each entry is the ms since the previous one and the key index with its input level, as
+// variable-length integers, followed by one byte of events, in a ring of MMZ_RECORDER_SIZE bytes;
+// when the ring is full the oldest entries are overwritten. Playback is one MacroDelay callback that reschedules itself for the next
+// due event, so it allocates nothing and times each event from the start of the replay without drift.
+class Recorder {
+public:
+    static constexpr bool ENABLED = (MMZ_RECORDER != 0);
+    static constexpr uint16_t CAPACITY = MMZ_RECORDER_SIZE;
+    static_assert((CAPACITY >= 16) && (CAPACITY < UINT16_MAX), "'MMZ_RECORDER_SIZE' must be between 16 and 65534.");
+
+    // 再生するイベントを受け取る関数 Receives each replayed event: player(index, events)
+    using Player = InplaceFunction<void(uint16_t, uint16_t), 2 * sizeof(void*)>;
+
+    // 記録を消して記録を始める(再生中の場合は止める) Clears the recording and starts a new one, stopping any replay.
+    static void start() {
+        cancelReplay();
+        clear();
+        recording_ = true;
+    }
+
+    // 記録を終える 押されたままのキーには離したイベントを追加する
+    // Ends the recording. Keys still down get a FALLING_EDGE, so a replay never leaves a key held.
+    static void stop() {
+        if (!recording_) { return; }
+        recording_ = false;
+
+        for (uint8_t i = 0; i < numOfHeld_; i++) { append(0, held_[i], RELEASE); }
+        numOfHeld_ = 0;
+    }
+
+    static bool isRecording() { return recording_; }
+
+    // イベントを記録する(MacroPad::invoke()が呼ぶ) timeはmicros() PRESSED/RELEASEDのみの場合は記録しない
+    // Records the events of a key (Key::getOccurred()); MacroPad::invoke() calls it. time is micros().
+    // PRESSED and RELEASED, which occur on every scan, are only kept as the input level of other events.
+    static inline void record(const uint16_t index, const uint16_t events, const uint32_t time) {
+        if (!recording_ || ((events & ~LEVELS) == 0)) { return; }
+
+        //msに切り捨てた端数を次に持ち越し、長い記録でもずれないようにする
+        //The sub-ms remainder is carried into the next delta, so long recordings do not drift.
+        //int32_tのusに収まらない間隔(約35分以上)はmillis()で測る
+        //A gap too long for an int32_t of us (about 35 minutes) is measured with millis() instead.
+        const uint32_t now = millis();
+        uint32_t delta = 0;
+        if (count_ == 0) {
+            remainder_ = 0;
+        } else if ((now - lastMillis_) < (INT32_MAX / 1000)) {
+            const int32_t difference = static_cast<int32_t>(time - lastTime_);
+            const uint32_t elapsed = ((difference > 0) ? difference : 0) + remainder_;
+            delta = elapsed / 1000;
+            remainder_ = elapsed % 1000;
+        } else {
+            delta = now - lastMillis_;
+            remainder_ = 0;
+        }
+        lastTime_ = time;
+        lastMillis_ = now;
+        append(delta, index, events);
+        track(index, events);
+    }
+
+    // 記録を再生する 記録中、再生中、記録が空の場合はfalse
+    // Plays the recording back, calling player for each event at its recorded time. Returns false while
+    // recording or replaying, or when there is nothing to replay.
+    static bool replay(Player player) {
+        if (recording_ || isReplaying() || (count_ == 0) || !player) { return false; }
+
+        Entry first;
+        decode(head_, first);
+
+        player_ = player;
+        numOfHeld_ = 0;
+        cursor_ = head_;
+        remaining_ = count_;
+        time_ = millis() - first.delta; //最初のイベントはすぐに再生する The first event plays at once.
+        handle_ = MacroDelay::delay(0, []() { step(); });
+        if (!handle_.isValid()) { remaining_ = 0; }
+        return handle_.isValid();
+    }
+
+    // 再生を止める 再生で押されたままのキーは離す Stops the replay; keys it left down are released at once.
+    static void cancelReplay() {
+        if (remaining_ == 0) { return; }
+        MacroDelay::cancel(handle_);
+        remaining_ = 0;
+
+        const uint8_t numOfHeld = numOfHeld_;
+        numOfHeld_ = 0;
+        for (uint8_t i = 0; i < numOfHeld; i++) { player_(held_[i], RELEASE); }
+    }
+
+    static bool isReplaying() { return remaining_ > 0; }
+
+    static void clear() {
+        cancelReplay();
+        head_ = 0;
+        size_ = 0;
+        count_ = 0;
+        remainder_ = 0;
+        numOfHeld_ = 0;
+    }
+
+    static uint16_t getNumOfEvents() { return count_; }
+    static uint16_t getSize() { return size_; }
+    // 満杯のため上書きされたイベントの数 Events overwritten because the buffer was full
+    static uint32_t getDroppedCount() { return dropped_; }
+
+private:
+    Recorder() {}
+
+    static constexpr uint16_t PRESSED = Key::mask(Key::Event::PRESSED);
+    static constexpr uint16_t LEVELS = Key::mask(Key::Event::PRESSED, Key::Event::RELEASED);
+    static constexpr uint16_t RELEASE = Key::mask(Key::Event::FALLING_EDGE, Key::Event::RELEASED);
+    static constexpr uint8_t MAX_ENTRY_SIZE = 5 + 3 + 1; //時間と、インデックスの可変長整数とイベント Delta and index varints, and the events
+    static_assert(LEVELS == 0x300, "The events other than PRESSED and RELEASED must fit in one byte.");
+
+    struct Entry {
+        uint32_t delta; //前のイベントからの時間(ms) Time since the previous event in ms
+        uint16_t index;
+        uint16_t events; //PRESSEDかRELEASEDを含む With PRESSED or RELEASED as the input level
+    };
+
+    // 期限の来たイベントを再生し、次のイベントの時刻に自身を予約する
+    // Plays every due event and reschedules itself for the next one.
+    static void step() {
+        const uint32_t now = millis();
+
+        while (remaining_ > 0) {
+            Entry entry;
+            const uint16_t next = decode(cursor_, entry);
+
+            const uint32_t due = time_ + entry.delta;
+            if (static_cast<int32_t>(now - due) < 0) {
+                handle_ = MacroDelay::delay(due - now, []() { step(); });
+                if (!handle_.isValid()) { cancelReplay(); } //MacroDelayに空きがない No free MacroDelay slot
+                return;
+            }
+
+            time_ = due;
+            cursor_ = next;
+            remaining_--;
+            track(entry.index, entry.events);
+            player_(entry.index, entry.events);
+        }
+    }
+
+    static void append(const uint32_t delta, const uint16_t index, const uint16_t events) {
+        uint8_t bytes[MAX_ENTRY_SIZE];
+        uint8_t length = writeVarint(bytes, 0, delta);
+        length = writeVarint(bytes, length, (static_cast<uint32_t>(index) << 1) | ((events & PRESSED) ? 1 : 0));
+        bytes[length++] = static_cast<uint8_t>(events);
+
+        //古いイベントを上書きする Overwrite the oldest events to make room.
+        while (size_ + length > CAPACITY) {
+            Entry oldest;
+            const uint16_t next = decode(head_, oldest);
+            size_ -= distance(head_, next);
+            head_ = next;
+            count_--;
+            dropped_++;
+        }
+
+        uint16_t position = (head_ + size_) % CAPACITY;
+        for (uint8_t i = 0; i < length; i++) {
+            buffer_[position] = bytes[i];
+            position = (position + 1) % CAPACITY;
+        }
+        size_ += length;
+        count_++;
+    }
+
+    // positionのイベントを読み、次のイベントの位置を返す Reads the entry at position and returns where the next one starts.
+    static uint16_t decode(uint16_t position, Entry& entry) {
+        uint32_t value;
+        position = readVarint(position, value);
+        entry.delta = value;
+        position = readVarint(position, value);
+        entry.index = value >> 1;
+        entry.events = buffer_[position] | ((value & 1) ? PRESSED : Key::mask(Key::Event::RELEASED));
+        return (position + 1) % CAPACITY;
+    }
+
+    // 押されているキーを記録する(MMZ_RECORDER_MAX_HELDを超えた分は記録しない)
+    // Keeps track of the keys that are down, up to MMZ_RECORDER_MAX_HELD of them.
+    static void track(const uint16_t index, const uint16_t events) {
+        for (uint8_t i = 0; i < numOfHeld_; i++) {
+            if (held_[i] != index) { continue; }
+            if (!(events & PRESSED)) { held_[i] = held_[--numOfHeld_]; }
+            return;
+        }
+        if ((events & PRESSED) && (numOfHeld_ < MMZ_RECORDER_MAX_HELD)) { held_[numOfHeld_++] = index; }
+    }
+
+    static uint8_t writeVarint(uint8_t* bytes, uint8_t length, uint32_t value) {
+        while (value >= 0x80) {
+            bytes[length++] = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        bytes[length++] = static_cast<uint8_t>(value);
+        return length;
+    }
+
+    static uint16_t readVarint(uint16_t position, uint32_t& value) {
+        value = 0;
+        for (uint8_t shift = 0; shift < 32; shift += 7) {
+            const uint8_t byte = buffer_[position];
+            position = (position + 1) % CAPACITY;
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) { break; }
+        }
+        return position;
+    }
+
+    static inline uint16_t distance(const uint16_t from, const uint16_t to) { return (to + CAPACITY - from) % CAPACITY; }
+
+    //無効な場合は参照されないため、リンクされない Never referenced, so never linked, when disabled
+    inline static uint8_t buffer_[ENABLED ? CAPACITY : 1] = {};
+    inline static uint16_t head_ = 0;  //最も古いイベントの位置 Position of the oldest entry
+    inline static uint16_t size_ = 0;  //使用中のバイト数 Bytes in use
+    inline static uint16_t count_ = 0; //イベントの数 Number of entries
+    inline static uint32_t dropped_ = 0;
+
+    inline static bool recording_ = false;
+    inline static uint32_t lastTime_ = 0;  //最後に記録したイベントの時刻(us) Time of the last recorded event in us
+    inline static uint32_t lastMillis_ = 0; //最後に記録したときのmillis() millis() when the last event was recorded
+    inline static uint32_t remainder_ = 0; //持ち越した端数(us) Sub-ms remainder carried over, in us
+
+    inline static uint16_t held_[MMZ_RECORDER_MAX_HELD] = {}; //記録中または再生中に押されているキー Keys down while recording or replaying
+    inline static uint8_t numOfHeld_ = 0;
+
+    inline static Player player_;
+    inline static DelayHandle handle_;
+    inline static uint16_t cursor_ = 0;    //次に再生するイベントの位置 Position of the next entry to play
+    inline static uint16_t remaining_ = 0; //再生していないイベントの数 Entries not played yet
+    inline static uint32_t time_ = 0;      //最後に再生したイベントの予定時刻(ms) Scheduled time of the last played entry in ms
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef MMZ_SPSC_QUEUE_H
+#define MMZ_SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+// 一つのコア(スレッド)が書き込み、もう一つのコアが読み出すロックフリーのリングバッファ
+// A lock-free ring buffer with exactly one producer and one consumer, e.g. one per core.
+// Only loads and stores are used (no read-modify-write), so it also works on the Cortex-M0+.
+// A push to a full queue fails and is counted in getOverflowCount().
+template<typename T, uint16_t CAPACITY>
+class SpscQueue {
+public:
+    static_assert((CAPACITY > 0) && ((CAPACITY & (CAPACITY - 1)) == 0) && (CAPACITY <= 0x8000),
+                  "The capacity must be a power of two up to 32768.");
+
+    //constexprにして静的なキューを定数初期化にする(使われない場合はリンクされない)
+    //constexpr, so a static queue is constant-initialized and dropped by the linker when unused.
+    constexpr SpscQueue() : buffer_{}, head_(0), tail_(0), overflows_(0) {}
+
+    // 書き込む側 Producer side
+    bool push(const T& item) {
+        const uint16_t head = head_.load(std::memory_order_relaxed);
+        if (static_cast<uint16_t>(head - tail_.load(std::memory_order_acquire)) >= CAPACITY) {
+            overflows_.store(overflows_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        buffer_[head % CAPACITY] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 読み出す側 Consumer side
+    bool pop(T& item) {
+        const uint16_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) { return false; }
+
+        item = buffer_[tail % CAPACITY];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint16_t size() const {
+        return static_cast<uint16_t>(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+    }
+
+    // 満杯で書き込めなかった回数 Number of pushes dropped because the queue was full
+    uint32_t getOverflowCount() const { return overflows_.load(std::memory_order_relaxed); }
+
+private:
+    T buffer_[CAPACITY];
+    std::atomic<uint16_t> head_; //次に書き込む位置 Written by the producer only
+    std::atomic<uint16_t> tail_; //次に読み出す位置 Written by the consumer only
+    std::atomic<uint32_t> overflows_;
+};
+
+#endif
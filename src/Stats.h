@@ -0,0 +1,175 @@
+#ifndef MMZ_STATS_H
+#define MMZ_STATS_H
+
+#include <Arduino.h>
+
+// 1にすると処理時間の統計を記録する 0(デフォルト)の場合は記録の処理ごと取り除かれる
+// 1 records timing statistics; 0 (the default) removes the recording and its cost entirely.
+#ifndef MMZ_STATS
+#define MMZ_STATS 0
+#endif
+
+// 処理時間の分布 2のべき乗ごとの区間で数える
+// A histogram with power-of-two buckets: bucket 0 counts zeros, bucket b counts values in
+// [2^(b-1), 2^b), and the last bucket also counts everything larger. 32 buckets cover any scan in
+// CPU cycles: at 133 MHz, 16 buckets would already saturate at 246 us.
+struct StatsHistogram {
+    static constexpr uint8_t BUCKETS = 32;
+
+    uint32_t counts[BUCKETS];
+
+    inline void record(const uint32_t value) {
+        const uint8_t bucket = (value == 0) ? 0 : (32 - __builtin_clz(value));
+        counts[(bucket < BUCKETS) ? bucket : (BUCKETS - 1)]++;
+    }
+};
+
+// スキャンの時間、macroDelay()の遅れ、イベントからHIDレポートまでの時間を記録する
+// Records how long scans take (in CPU cycles on the RP2040, in us elsewhere), how late macroDelay()
+// callbacks run (in ms), and how long it takes from a key event to the first HID report its macro
+// sends (in us). The slowest macro of each key is kept by MacroPad (see MacroPad::dumpStats()).
+// The scanning core records the scans and the dispatching core the rest, so each field has one writer.
+class Stats {
+public:
+    static constexpr bool ENABLED = (MMZ_STATS != 0);
+    static constexpr uint8_t VERSION = 2; //2: 32区間 32 buckets (1 had 16)
+
+    // 時間の計測に使う時計 The clock used for the scan times
+    static inline uint32_t getCycles() {
+#if defined(ARDUINO_ARCH_RP2040)
+        return rp2040.getCycleCount();
+#else
+        return micros();
+#endif
+    }
+
+    // 1マイクロ秒あたりのgetCycles()の増分 Increments of getCycles() per us
+    static uint16_t getCyclesPerMicro() {
+#if defined(ARDUINO_ARCH_RP2040)
+        return rp2040.f_cpu() / 1000000;
+#else
+        return 1;
+#endif
+    }
+
+    static inline void recordScan(const uint32_t cycles) {
+        if constexpr (ENABLED) { scan_.record(cycles); }
+    }
+
+    static inline void recordLateness(const uint32_t ms) {
+        if constexpr (ENABLED) { lateness_.record(ms); }
+    }
+
+    // マクロを実行する前に、そのイベントの時刻(micros())を設定する Called before a macro runs, with the time of its event.
+    static inline void beginMacro(const uint32_t eventTime) {
+        if constexpr (ENABLED) {
+            eventTime_ = eventTime;
+            reported_ = false;
+        }
+    }
+
+    // HIDレポートを送信した直後に呼ぶ(マクロ実行ごとに最初の一回のみ記録する)
+    // Call right after sending a HID report; only the first report of each macro run is recorded.
+    // pressTo() and mod() call it (through hidReported()); custom macros that use Keyboard directly can call it too.
+    static inline void recordReport() {
+        if constexpr (ENABLED) {
+            if (reported_) { return; }
+            report_.record(micros() - eventTime_);
+            reported_ = true;
+        }
+    }
+
+    // 送信を遅らせたレポート(HidBatch)を送信した直後に呼ぶ eventTimeは実行中のマクロのgetEventTime()
+    // Call right after sending a deferred report (HidBatch), with getEventTime() as it was when the
+    // report's first change was made. Every such report is recorded.
+    static inline void recordReport(const uint32_t eventTime) {
+        if constexpr (ENABLED) { report_.record(micros() - eventTime); }
+    }
+
+    // 実行中のマクロのイベントの時刻 Time of the event of the macro running now (see beginMacro())
+    static inline uint32_t getEventTime() { return ENABLED ? eventTime_ : 0; }
+
+    static const StatsHistogram& getScanHistogram() { return scan_; }
+    static const StatsHistogram& getLatenessHistogram() { return lateness_; }
+    static const StatsHistogram& getReportHistogram() { return report_; }
+
+    static void reset() {
+        scan_ = {};
+        lateness_ = {};
+        report_ = {};
+        eventTime_ = 0;
+        reported_ = true;
+    }
+
+    // 統計をバイナリでoutへ書き込む(形式はextras/stats_decoder.pyを参照)
+    // Writes the statistics as one binary frame, little-endian (decoded by extras/stats_decoder.py):
+    //     "MMZS", version (1), buckets (1), cycles per us (2),
+    //     scan, lateness and report histograms (buckets * 4 each),
+    //     number of keys with a slowest macro (2), then (key index (2), us (4)) for each,
+    //     Fletcher-16 checksum of everything before it (2).
+    // slowest[i] is the longest run of key i's macro in us; keys at 0 are skipped.
+    static void dump(Print& out, const uint32_t* slowest, const uint16_t numOfKeys) {
+        Writer writer(out);
+        writer.put("MMZS", 4);
+        writer.put8(VERSION);
+        writer.put8(StatsHistogram::BUCKETS);
+        writer.put16(getCyclesPerMicro());
+        writer.putHistogram(scan_);
+        writer.putHistogram(lateness_);
+        writer.putHistogram(report_);
+
+        uint16_t count = 0;
+        for (uint16_t i = 0; i < numOfKeys; i++) { count += (slowest[i] != 0); }
+        writer.put16(count);
+        for (uint16_t i = 0; i < numOfKeys; i++) {
+            if (slowest[i] == 0) { continue; }
+            writer.put16(i);
+            writer.put32(slowest[i]);
+        }
+
+        const uint16_t checksum = writer.getChecksum();
+        writer.put16(checksum);
+    }
+
+private:
+    Stats() {}
+
+    class Writer {
+    public:
+        Writer(Print& out) : out_(out), sum1_(0), sum2_(0) {}
+
+        void put(const char* bytes, const uint8_t length) {
+            for (uint8_t i = 0; i < length; i++) { put8(bytes[i]); }
+        }
+        void put8(const uint8_t value) {
+            out_.write(value);
+            sum1_ = (sum1_ + value) % 255;
+            sum2_ = (sum2_ + sum1_) % 255;
+        }
+        void put16(const uint16_t value) {
+            put8(value & 0xFF);
+            put8(value >> 8);
+        }
+        void put32(const uint32_t value) {
+            put16(value & 0xFFFF);
+            put16(value >> 16);
+        }
+        void putHistogram(const StatsHistogram& histogram) {
+            for (const uint32_t count : histogram.counts) { put32(count); }
+        }
+
+        uint16_t getChecksum() const { return (sum2_ << 8) | sum1_; }
+
+    private:
+        Print& out_;
+        uint16_t sum1_, sum2_;
+    };
+
+    inline static StatsHistogram scan_ = {};
+    inline static StatsHistogram lateness_ = {};
+    inline static StatsHistogram report_ = {};
+    inline static uint32_t eventTime_ = 0;
+    inline static bool reported_ = true;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef MMZ_TIMING_H
+#define MMZ_TIMING_H
+
+#include <stdint.h>
+#include <array>
+
+// 用意するタイミング設定の数(0番は既定の設定)
+// Number of timing profiles in the table; profile 0 is the default one.
+#ifndef MMZ_TIMING_PROFILES
+#define MMZ_TIMING_PROFILES 4
+#endif
+
+// キーのイベントを判定する時間(ms)
+// Thresholds in ms used by the key state machine.
+struct Timing {
+    uint16_t longThreshold;   //長押し Long press
+    uint16_t doubleThreshold; //ダブルクリック Double click
+    uint16_t holdThreshold;   //ホールド Hold
+    uint16_t debounceTime;    //デバウンス(DeferredDebounceでは最大255) Debounce; DeferredDebounce caps it at 255 ms
+};
+
+// 実行中に変更できるタイミング設定の表 キーはこの表のインデックスのみを保持する
+// Timing profiles that can be changed at run time. Keys and macros only store an index into this table.
+struct TimingTable {
+    static constexpr uint8_t SIZE = MMZ_TIMING_PROFILES;
+    static constexpr uint8_t INHERIT = UINT8_MAX; //キーの設定を使う Use the key's own profile
+    static_assert((SIZE > 0) && (SIZE < INHERIT), "'MMZ_TIMING_PROFILES' must be between 1 and 254.");
+
+    static constexpr Timing DEFAULT = { 500, 200, 200, 20 };
+
+    // Timingに収まる値にする Clamps a time in ms to what a Timing can hold.
+    static constexpr uint16_t clamp(const uint32_t ms) { return (ms > UINT16_MAX) ? UINT16_MAX : static_cast<uint16_t>(ms); }
+
+    static inline const Timing& get(const uint8_t profile) { return profiles_[(profile < SIZE) ? profile : 0]; }
+
+    static void set(const uint8_t profile, const Timing& timing) {
+        if (profile >= SIZE) { return; }
+        profiles_[profile] = timing;
+    }
+
+    // すべての設定のうち最も長いデバウンス時間 The longest debounce time of every profile
+    static uint16_t getMaxDebounce() {
+        uint16_t longest = 0;
+        for (const Timing& timing : profiles_) {
+            if (timing.debounceTime > longest) { longest = timing.debounceTime; }
+        }
+        return longest;
+    }
+
+private:
+    static constexpr std::array<Timing, SIZE> defaults() {
+        std::array<Timing, SIZE> profiles = {};
+        for (uint8_t i = 0; i < SIZE; i++) { profiles[i] = DEFAULT; }
+        return profiles;
+    }
+
+    inline static std::array<Timing, SIZE> profiles_ = defaults();
+};
+
+// コンパイル時に決まるタイミング すべてのキーで同じ値を使い、判定の処理に定数として埋め込まれる
+// Compile-time thresholds shared by every key. Pass it to an engine, e.g. SerialEngine<N, FixedTiming<500, 200, 200, 5>>,
+// and the values are folded into the state machine as constants; per-key and per-macro profiles are ignored.
+template<uint16_t LONG, uint16_t DOUBLE, uint16_t HOLD, uint16_t DEBOUNCE>
+struct FixedTiming {
+    static constexpr Timing get(const uint8_t) { return { LONG, DOUBLE, HOLD, DEBOUNCE }; }
+    static constexpr uint16_t getMaxDebounce() { return DEBOUNCE; }
+};
+
+#endif
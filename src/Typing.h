@@ -0,0 +1,295 @@
+#ifndef MMZ_TYPING_H
+#define MMZ_TYPING_H
+
+#include <Arduino.h>
+
+#include "HidBatch.h"
+
+// 同時に待機できる文字列の数(1~254) Number of texts and key sequences that can wait at once (1-254).
+#ifndef MMZ_TYPING_QUEUE_SIZE
+#define MMZ_TYPING_QUEUE_SIZE 8
+#endif
+
+// 一秒間に入力する文字数の初期値 Default typing rate in characters per second.
+#ifndef MMZ_TYPING_RATE
+#define MMZ_TYPING_RATE 100
+#endif
+
+// 一回のupdate()で行う押下と解放の最大数 Most presses and releases done by one update().
+#ifndef MMZ_TYPING_BURST
+#define MMZ_TYPING_BURST 4
+#endif
+
+// キーリピートが始まるまでの時間(ms) Time in ms before a repeated key starts repeating.
+#ifndef MMZ_TYPING_REPEAT_DELAY
+#define MMZ_TYPING_REPEAT_DELAY 500
+#endif
+
+// 待機中の文字列を指す Identifies a queued text, e.g. to cancel it.
+struct TypingHandle {
+    static constexpr uint8_t INVALID = UINT8_MAX;
+
+    uint8_t slot = INVALID;
+    uint16_t generation = 0;
+
+    bool isValid() const { return slot != INVALID; }
+};
+
+// 文字列やキーの列を少しずつ入力する
+// Types texts and keycode sequences a few keys per MacroPad::update() at a fixed rate, instead of
+// blocking the scan for the whole string like Keyboard.print(). The data is not copied: string
+// literals and other constant arrays stay in flash and must outlive the typing.
+// Each character is a press and, half a period later, its release. The queued items are typed one
+// after another; a repeating key (repeat()) goes before them while it is due.
+class Typing {
+public:
+    static constexpr uint8_t CAPACITY = MMZ_TYPING_QUEUE_SIZE;
+    static_assert((CAPACITY > 0) && (CAPACITY < TypingHandle::INVALID), "'MMZ_TYPING_QUEUE_SIZE' must be between 1 and 254.");
+
+    using Output = void (*)(uint8_t code);
+
+    // キーの押下と解放の送信先(Keyboard_h_Util.hのtypeText()などは自動で設定する)
+    // Where the presses and releases go, e.g. hidPress and hidRelease; typeText() sets them.
+    static void setOutput(const Output press, const Output release) {
+        press_ = press;
+        release_ = release;
+    }
+
+    // NUL終端の文字列(US配列のASCII)を入力する 入力できない文字は飛ばす
+    // Queues a NUL-terminated ASCII text (US layout); characters without a key are skipped.
+    // Returns an invalid handle when the queue is full.
+    static TypingHandle type(const char* text) { return enqueue(reinterpret_cast<const uint8_t*>(text), UINT32_MAX, true); }
+    static TypingHandle type(const char* text, const uint32_t length) {
+        return enqueue(reinterpret_cast<const uint8_t*>(text), length, true);
+    }
+
+    // Keyboard.press()と同じキーコード(KEY_*を含む)を一つずつ入力する
+    // Queues keycodes as passed to Keyboard.press(), KEY_* codes included, tapped one by one.
+    static TypingHandle typeKeys(const uint8_t* codes, const uint32_t count) { return enqueue(codes, count, false); }
+
+    // キーを一回入力し、MMZ_TYPING_REPEAT_DELAY後から入力の速さで繰り返す(cancelRepeat()まで)
+    // Taps the key once, then again at the typing rate after MMZ_TYPING_REPEAT_DELAY, until
+    // cancelRepeat(). One key repeats at a time; a new repeat() replaces the previous one.
+    static void repeat(const uint8_t code) {
+        cancelRepeat();
+        wake();
+        repeatCode_ = code;
+        repeatFirst_ = true;
+    }
+
+    // codeのリピートを止める(0の場合はどのキーでも止める) Stops the repeat of code, or of any key with 0.
+    static bool cancelRepeat(const uint8_t code=0) {
+        if ((repeatCode_ == 0) || ((code != 0) && (code != repeatCode_))) { return false; }
+
+        if (heldSlot_ == REPEAT) { releaseHeld(); }
+        repeatCode_ = 0;
+        return true;
+    }
+
+    // 待機中または入力中の文字列を取り消す(押されているキーは離す)
+    // Cancels a queued or partly typed item; a key it holds down is released at once.
+    static bool cancel(TypingHandle& handle) {
+        if (!isPending(handle)) { return false; }
+
+        const uint8_t handleSlot = handle.slot;
+        Job& job = jobs_[handleSlot];
+        handle = TypingHandle();
+
+        job.length = job.position; //先頭に来たときに取り除かれる Removed when it reaches the head.
+        if (heldSlot_ == handleSlot) { releaseHeld(); }
+        return true;
+    }
+
+    // すべての入力とリピートを取り消す Cancels every item and the repeat.
+    static void cancelAll() {
+        releaseHeld();
+        while (count_ > 0) { pop(); }
+        repeatCode_ = 0;
+    }
+
+    // キーを離さずにすべての入力を捨て、起動時の状態に戻す(PC上のテストなど) 送信先は残す
+    // Drops everything without releasing any key and returns to the start-up state, e.g. between tests
+    // in one process. The outputs are kept and handles given out before stay invalid.
+    static void reset() {
+        for (Job& job : jobs_) {
+            job.queued = false;
+            job.generation++;
+        }
+        head_ = 0;
+        count_ = 0;
+        interval_ = 1000000UL / MMZ_TYPING_RATE;
+        nextTime_ = 0;
+        heldCode_ = 0;
+        heldSlot_ = IDLE;
+        repeatCode_ = 0;
+        repeatFirst_ = false;
+        repeatTime_ = 0;
+    }
+
+    static bool isPending(const TypingHandle& handle) {
+        if (handle.slot >= CAPACITY) { return false; }
+        const Job& job = jobs_[handle.slot];
+        return (job.generation == handle.generation) && job.queued && (job.position < job.length);
+    }
+
+    // 一秒間に入力する文字数 Characters per second
+    static void setRate(const uint16_t charsPerSecond) { interval_ = 1000000UL / ((charsPerSecond > 0) ? charsPerSecond : 1); }
+    static uint16_t getRate() { return 1000000UL / interval_; }
+
+    static uint8_t getNumOfPending() { return count_; }
+
+    // 次に押下か解放を行うまでの時間(us) 何もなければUINT32_MAX
+    // Time in us until the next press or release is due, 0 if it is overdue, UINT32_MAX if there is nothing to type.
+    static uint32_t getTimeUntilNext() {
+        if ((heldSlot_ == IDLE) && (count_ == 0) && (repeatCode_ == 0)) { return UINT32_MAX; }
+
+        const uint32_t now = micros();
+        uint32_t next = nextTime_;
+        //リピートの待機中のみ Only the repeat, still waiting for its delay
+        if ((heldSlot_ == IDLE) && (count_ == 0) && !repeatFirst_ && !isDue(repeatTime_, next)) { next = repeatTime_; }
+
+        const int32_t remaining = static_cast<int32_t>(next - now);
+        return (remaining > 0) ? remaining : 0;
+    }
+
+    // 期限の来た押下と解放を最大MMZ_TYPING_BURST回行う MacroPad::update()が呼ぶ
+    // Does the due presses and releases, at most MMZ_TYPING_BURST; MacroPad::update() calls it.
+    static void update() {
+        if ((press_ == nullptr) || (release_ == nullptr)) { return; }
+
+        const uint32_t now = micros();
+        for (uint8_t actions = 0; (actions < MMZ_TYPING_BURST) && isDue(nextTime_, now); actions++) {
+            if (heldSlot_ != IDLE) {
+                releaseHeld();
+                nextTime_ += interval_ - interval_ / 2;
+                continue;
+            }
+
+            uint8_t code;
+            const uint8_t slot = next(now, code);
+            if (slot == IDLE) { return; }
+
+            //大きく遅れた場合や待機の後は、まとめて入力せずに現在から再開する
+            //After a long stall or an idle period, restart from now instead of typing the backlog in a burst.
+            if ((now - nextTime_) > interval_) { nextTime_ = now; }
+
+            press_(code);
+            heldCode_ = code;
+            heldSlot_ = slot;
+            nextTime_ += interval_ / 2;
+        }
+    }
+
+private:
+    Typing() {}
+
+    static constexpr uint8_t IDLE = UINT8_MAX;
+    static constexpr uint8_t REPEAT = UINT8_MAX - 1;
+
+    struct Job {
+        const uint8_t* data;
+        uint32_t length;   //NUL終端の場合はUINT32_MAX UINT32_MAX for NUL-terminated texts
+        uint32_t position;
+        uint16_t generation;
+        bool text;         //ASCIIの文字列(falseの場合はキーコード) ASCII text, or keycodes when false
+        bool queued;
+    };
+
+    static TypingHandle enqueue(const uint8_t* data, const uint32_t length, const bool text) {
+        if ((data == nullptr) || (count_ >= CAPACITY)) { return TypingHandle(); }
+        wake();
+
+        const uint8_t index = (head_ + count_) % CAPACITY;
+        Job& job = jobs_[index];
+        job.data = data;
+        job.length = length;
+        job.position = 0;
+        job.text = text;
+        job.queued = true;
+        count_++;
+
+        TypingHandle handle;
+        handle.slot = index;
+        handle.generation = job.generation;
+        return handle;
+    }
+
+    //何もしていなかった場合は現在から始める Starts from now after an idle period of any length.
+    static void wake() {
+        if ((heldSlot_ == IDLE) && (count_ == 0) && (repeatCode_ == 0)) { nextTime_ = micros(); }
+    }
+
+    static void pop() {
+        Job& job = jobs_[head_];
+        job.queued = false;
+        job.generation++;
+        head_ = (head_ + 1) % CAPACITY;
+        count_--;
+    }
+
+    // 次に押すキーとその入力元(IDLEの場合はなし) Picks the next key to press and returns its source slot.
+    static uint8_t next(const uint32_t now, uint8_t& code) {
+        if (repeatCode_ != 0) {
+            if (repeatFirst_) {
+                repeatFirst_ = false;
+                repeatTime_ = now + MMZ_TYPING_REPEAT_DELAY * 1000UL;
+                code = repeatCode_;
+                return REPEAT;
+            }
+            if (isDue(repeatTime_, now)) {
+                code = repeatCode_;
+                return REPEAT;
+            }
+        }
+
+        while (count_ > 0) {
+            Job& job = jobs_[head_];
+            if (job.position >= job.length) {
+                pop();
+                continue;
+            }
+
+            code = job.data[job.position++];
+            if (!job.text) { return head_; }
+
+            if (code == 0) {
+                job.length = job.position;
+            } else if ((code < 0x80) && (HidData::ASCII[code] != 0)) {
+                return head_;
+            }
+        }
+        return IDLE;
+    }
+
+    static void releaseHeld() {
+        if (heldSlot_ == IDLE) { return; }
+        release_(heldCode_);
+        heldSlot_ = IDLE;
+
+        //最後の文字を離したら取り除く Drop an item once its last key is up.
+        if ((count_ > 0) && (jobs_[head_].position >= jobs_[head_].length)) { pop(); }
+    }
+
+    static inline bool isDue(const uint32_t time, const uint32_t now) {
+        return static_cast<int32_t>(now - time) >= 0;
+    }
+
+    inline static Job jobs_[CAPACITY] = {};
+    inline static uint8_t head_ = 0;
+    inline static uint8_t count_ = 0;
+
+    inline static Output press_ = nullptr;
+    inline static Output release_ = nullptr;
+
+    inline static uint32_t interval_ = 1000000UL / MMZ_TYPING_RATE; //一文字の周期(us) Period of one character in us
+    inline static uint32_t nextTime_ = 0;
+
+    inline static uint8_t heldCode_ = 0;
+    inline static uint8_t heldSlot_ = IDLE; //押しているキーの入力元 Source of the key held down
+
+    inline static uint8_t repeatCode_ = 0;
+    inline static bool repeatFirst_ = false;
+    inline static uint32_t repeatTime_ = 0;
+};
+
+#endif
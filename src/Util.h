@@ -9,64 +9,81 @@
 #include "Profile.h"
 #include "Key.h"
 
-template<uint8_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS>
+template<uint16_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS>
 class LayerUtil {
 public:
     LayerUtil(Layer<NUM_OF_KEYS, NUM_OF_LAYERS>& layers) : layers_(layers) {}
 
     inline Macro to(uint8_t layer) {
-        return [this, layer](Key key) {
+        return Macro([this, layer](const Key& key) {
             if (key.hasOccurred(Key::Event::RISING_EDGE)) {
                 layers_.set(layer);
             }
-        };
+        }, Key::mask(Key::Event::RISING_EDGE));
     }
     inline Macro back(uint8_t layer) {
-        return [this, layer](Key key) {
+        return Macro([this, layer](const Key& key) {
             if (key.hasOccurred(Key::Event::FALLING_EDGE)) {
                 layers_.set(layer);
             }
-        };
+        }, Key::mask(Key::Event::FALLING_EDGE));
     }
     inline Macro reset() {
-        return [this](Key key) {
+        return Macro([this](const Key& key) {
             if (key.hasOccurred(Key::Event::RISING_EDGE)) {
                 layers_.reset();
             }
-        };
+        }, Key::mask(Key::Event::RISING_EDGE));
+    }
+    // 押している間だけレイヤーを重ねる Stacks the layer while the key is held.
+    inline Macro hold(uint8_t layer) {
+        return Macro([this, layer](const Key& key) {
+            if (key.hasOccurred(Key::Event::RISING_EDGE)) {
+                layers_.on(layer);
+            } else if (key.hasOccurred(Key::Event::FALLING_EDGE)) {
+                layers_.off(layer);
+            }
+        }, Key::mask(Key::Event::RISING_EDGE, Key::Event::FALLING_EDGE));
+    }
+    inline Macro toggle(uint8_t layer) {
+        return Macro([this, layer](const Key& key) {
+            if (key.hasOccurred(Key::Event::RISING_EDGE)) {
+                layers_.toggle(layer);
+            }
+        }, Key::mask(Key::Event::RISING_EDGE));
     }
 
 private:
     Layer<NUM_OF_KEYS, NUM_OF_LAYERS>& layers_;
 };
 
-template<uint8_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS, uint8_t NUM_OF_PROFILES>
+template<uint16_t NUM_OF_KEYS, uint8_t NUM_OF_LAYERS, uint8_t NUM_OF_PROFILES>
 class ProfileUtil {
 public:
     ProfileUtil(Profile<NUM_OF_KEYS, NUM_OF_LAYERS, NUM_OF_PROFILES>& profiles) : profiles_(profiles) {}
 
     inline Macro to(uint8_t profile) {
-        return [this, profile](Key key) {
+        return Macro([this, profile](const Key& key) {
             if (key.hasOccurred(Key::Event::RISING_EDGE)) {
                 profiles_.set(profile);
             }
-        };
+        }, Key::mask(Key::Event::RISING_EDGE));
     }
 
     inline Macro back(uint8_t profile) {
-        return [this, profile](Key key) {
+        return Macro([this, profile](const Key& key) {
             if (key.hasOccurred(Key::Event::FALLING_EDGE)) {
                 profiles_.set(profile);
             }
-        };
+        }, Key::mask(Key::Event::FALLING_EDGE));
     }
 
     inline Macro reset() {
-        return [this](Key key) {
+        return Macro([this](const Key& key) {
             if (key.hasOccurred(Key::Event::RISING_EDGE)) {
                 profiles_.reset();
             }
-        };
+        }, Key::mask(Key::Event::RISING_EDGE));
     }
 
 private: